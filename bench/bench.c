@@ -0,0 +1,537 @@
+/**
+ * @file bench.c
+ * @author Linux-Tech-Tips (Martin)
+ * @brief Benchmark harness, timing the matrix kernels, activations, inference, training and file handling of the project,
+ * reporting ns/op, GFLOP/s, GB/s and allocations/op as a table and as JSON to be compared across commits
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../src/matrix.h"
+#include "../src/kernel.h"
+#include "../src/activation.h"
+#include "../src/network.h"
+#include "../src/set.h"
+#include "../src/util.h"
+
+#ifndef BENCH_REPS
+#define BENCH_REPS 5
+#endif /* BENCH_REPS */
+#ifndef BENCH_WARMUP
+#define BENCH_WARMUP 1
+#endif /* BENCH_WARMUP */
+#ifndef BENCH_MIN_TIME
+#define BENCH_MIN_TIME 0.05
+#endif /* BENCH_MIN_TIME */
+#ifndef BENCH_SEED
+#define BENCH_SEED 1
+#endif /* BENCH_SEED */
+
+/** Samples of the training set and of the batched inference */
+#ifndef BENCH_SET_SIZE
+#define BENCH_SET_SIZE 4096
+#endif /* BENCH_SET_SIZE */
+/** Points in the parsed points file */
+#ifndef BENCH_POINTS
+#define BENCH_POINTS 100000
+#endif /* BENCH_POINTS */
+/** Values per activation call */
+#define BENCH_ACT_SIZE 4096
+
+
+/* === Allocation counting (the harness is linked with -Wl,--wrap for every allocator the project calls) === */
+
+/** Number of allocations made by the project code since the start */
+static size_t bench_allocs = 0;
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+int __real_posix_memalign(void ** ptr, size_t align, size_t size);
+
+void * __wrap_malloc(size_t size) {
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void * __wrap_realloc(void * ptr, size_t size) {
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void ** ptr, size_t align, size_t size) {
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_posix_memalign(ptr, align, size);
+}
+
+
+/* === Benchmarks === */
+
+/** Benchmarked operation types */
+typedef enum {
+    BENCH_MATMUL = 0,
+    BENCH_ACTIVATION = 1,
+    BENCH_INFERENCE = 2,
+    BENCH_INFERENCE_WS = 3,
+    BENCH_INFERENCE_BATCH = 4,
+    BENCH_TRAIN = 5,
+    BENCH_SAVE = 6,
+    BENCH_LOAD = 7,
+    BENCH_POINTS_PARSE = 8,
+    BENCH_RNG_UNIFORM = 9,
+    BENCH_RNG_NORMAL = 10
+} bench_kind_t;
+
+/** A single benchmark, its parameters and the state prepared for it */
+typedef struct {
+    /** The name reported, unique, used for filtering */
+    char const * name;
+    bench_kind_t kind;
+    /** Matrix product shape (M x K times K x N, named MxKxN), or the network layer widths (0-terminated, input size first) */
+    size_t shape [5];
+    /** Activation function of the activation benchmarks (f, or dfa if 'derivative' is set) */
+    activation_type_t activation;
+    int derivative;
+    /** Optimizer of the training benchmarks */
+    optim_type_t optimizer;
+
+    /** Floating point operations and bytes moved per operation, 0 if not meaningful */
+    double flops, bytes;
+
+    /* Prepared state, the data drawn from a generator of its own */
+    rng_t rng;
+    matrix_t a, b, c;
+    network_t net;
+    network_workspace_t ws;
+    network_tracker_t tracker;
+    optim_t optim;
+    set_t set;
+    char file [64];
+} bench_t;
+
+static bench_t bench_list [] = {
+    { .name = "matmul/64x64x1", .kind = BENCH_MATMUL, .shape = {64, 64, 1} },
+    { .name = "matmul/16x16x16", .kind = BENCH_MATMUL, .shape = {16, 16, 16} },
+    { .name = "matmul/64x64x64", .kind = BENCH_MATMUL, .shape = {64, 64, 64} },
+    { .name = "matmul/256x256x256", .kind = BENCH_MATMUL, .shape = {256, 256, 256} },
+    { .name = "matmul/512x512x512", .kind = BENCH_MATMUL, .shape = {512, 512, 512} },
+    { .name = "matmul/128x2x4096", .kind = BENCH_MATMUL, .shape = {128, 2, 4096} },
+    { .name = "activation/relu", .kind = BENCH_ACTIVATION, .activation = ACTIVATION_RELU },
+    { .name = "activation/relu_dfa", .kind = BENCH_ACTIVATION, .activation = ACTIVATION_RELU, .derivative = 1 },
+    { .name = "activation/logistic", .kind = BENCH_ACTIVATION, .activation = ACTIVATION_LOGISTIC },
+    { .name = "activation/logistic_dfa", .kind = BENCH_ACTIVATION, .activation = ACTIVATION_LOGISTIC, .derivative = 1 },
+    { .name = "activation/logistic_fast", .kind = BENCH_ACTIVATION, .activation = ACTIVATION_LOGISTIC_FAST },
+    { .name = "inference/2-5-1", .kind = BENCH_INFERENCE, .shape = {2, 5, 1} },
+    { .name = "inference/2-128-128-1", .kind = BENCH_INFERENCE, .shape = {2, 128, 128, 1} },
+    { .name = "inference_ws/2-5-1", .kind = BENCH_INFERENCE_WS, .shape = {2, 5, 1} },
+    { .name = "inference_ws/2-128-128-1", .kind = BENCH_INFERENCE_WS, .shape = {2, 128, 128, 1} },
+    { .name = "inference_batch/2-5-1", .kind = BENCH_INFERENCE_BATCH, .shape = {2, 5, 1} },
+    { .name = "inference_batch/2-128-128-1", .kind = BENCH_INFERENCE_BATCH, .shape = {2, 128, 128, 1} },
+    { .name = "train_epoch/2-5-1", .kind = BENCH_TRAIN, .shape = {2, 5, 1} },
+    { .name = "train_epoch/2-128-128-1", .kind = BENCH_TRAIN, .shape = {2, 128, 128, 1} },
+    { .name = "train_epoch/2-128-128-1/momentum", .kind = BENCH_TRAIN, .shape = {2, 128, 128, 1}, .optimizer = OPTIM_MOMENTUM },
+    { .name = "train_epoch/2-128-128-1/adam", .kind = BENCH_TRAIN, .shape = {2, 128, 128, 1}, .optimizer = OPTIM_ADAM },
+    { .name = "network_save/2-512-512-1", .kind = BENCH_SAVE, .shape = {2, 512, 512, 1} },
+    { .name = "network_load/2-512-512-1", .kind = BENCH_LOAD, .shape = {2, 512, 512, 1} },
+    { .name = "points_parse/2-1", .kind = BENCH_POINTS_PARSE, .shape = {2, 1} },
+    { .name = "rng_fill/uniform", .kind = BENCH_RNG_UNIFORM },
+    { .name = "rng_fill/normal", .kind = BENCH_RNG_NORMAL }
+};
+
+/** Fills a matrix with random values in [-1, 1) */
+static void bench_random(bench_t * bench, matrix_t * m) {
+    rng_fillUniform(&bench->rng, m->data, m->dataLen, -1, 1);
+}
+
+/** Returns the number of layers of a network shape */
+static size_t bench_depth(bench_t const * bench) {
+    size_t depth = 0;
+    while(depth + 1 < 5 && bench->shape[depth + 1])
+	++depth;
+    return depth;
+}
+
+/** Returns the number of weights and biases of the network */
+static double bench_params(network_t const * net) {
+    double params = 0;
+    for(size_t i = 0; i < net->depth; ++i)
+	params += net->weights[i].rows * (net->weights[i].cols + 1);
+    return params;
+}
+
+/** Initializes a randomly weighted logistic network of the benchmark shape */
+static int bench_initNet(bench_t * bench) {
+    size_t depth = bench_depth(bench);
+    activation_t activations [4];
+    for(size_t i = 0; i < depth; ++i)
+	activations[i] = activation_logistic;
+    if(network_init(&bench->net, bench->shape[0], depth, bench->shape + 1, activations) != NETWORK_OK)
+	return 0;
+    network_initWeights(&bench->net, NETWORK_INIT_UNIFORM, -0.05f, 0.05f, BENCH_SEED);
+    return 1;
+}
+
+/** Initializes a random set of BENCH_SET_SIZE samples for the network */
+static int bench_initSet(bench_t * bench) {
+    if(set_init(&bench->set, BENCH_SET_SIZE, bench->net.inSize, bench->net.outSize) != SET_OK)
+	return 0;
+    rng_fillUniform(&bench->rng, bench->set.in, BENCH_SET_SIZE * bench->net.inSize, -1, 1);
+    rng_fillUniform(&bench->rng, bench->set.out, BENCH_SET_SIZE * bench->net.outSize, 0, 1);
+    return 1;
+}
+
+/** Prepares the state of a benchmark and its per-operation counts, returns 0 on failure */
+static int bench_setup(bench_t * bench) {
+    size_t m = bench->shape[0], k = bench->shape[1], n = bench->shape[2];
+    /* Every benchmark measures the same data, whichever others run before it */
+    rng_init(&bench->rng, BENCH_SEED, 0);
+    switch(bench->kind) {
+	case BENCH_MATMUL:
+	    if(matrix_init(&bench->a, m, k) != MATRIX_OK || matrix_init(&bench->b, k, n) != MATRIX_OK || matrix_init(&bench->c, m, n) != MATRIX_OK)
+		return 0;
+	    bench_random(bench, &bench->a);
+	    bench_random(bench, &bench->b);
+	    bench->flops = 2.0 * m * n * k;
+	    bench->bytes = (double)(m * k + k * n + m * n) * sizeof(MATRIX_TYPE);
+	    return 1;
+
+	case BENCH_ACTIVATION:
+	    if(matrix_init(&bench->a, BENCH_ACT_SIZE, 1) != MATRIX_OK)
+		return 0;
+	    bench_random(bench, &bench->a);
+	    bench->bytes = 2.0 * BENCH_ACT_SIZE * sizeof(MATRIX_TYPE);
+	    return 1;
+
+	case BENCH_RNG_UNIFORM:
+	case BENCH_RNG_NORMAL:
+	    if(matrix_init(&bench->a, BENCH_ACT_SIZE, 1) != MATRIX_OK)
+		return 0;
+	    bench->bytes = (double)(BENCH_ACT_SIZE) * sizeof(MATRIX_TYPE);
+	    return 1;
+
+	case BENCH_INFERENCE:
+	case BENCH_INFERENCE_WS:
+	case BENCH_INFERENCE_BATCH: {
+	    size_t batch = (bench->kind == BENCH_INFERENCE_BATCH ? BENCH_SET_SIZE : 1);
+	    if(!bench_initNet(bench))
+		return 0;
+	    if(matrix_init(&bench->a, bench->net.inSize, batch) != MATRIX_OK || matrix_init(&bench->c, bench->net.outSize, batch) != MATRIX_OK)
+		return 0;
+	    bench_random(bench, &bench->a);
+	    if(bench->kind != BENCH_INFERENCE && network_workspace_initBatch(&bench->ws, &bench->net, batch) != NETWORK_OK)
+		return 0;
+	    bench->flops = 2.0 * bench_params(&bench->net) * batch;
+	    bench->bytes = bench_params(&bench->net) * sizeof(MATRIX_TYPE);
+	    return 1;
+	}
+
+	case BENCH_TRAIN: {
+	    if(!bench_initNet(bench) || !bench_initSet(bench))
+		return 0;
+	    size_t depth = bench_depth(bench);
+	    if(network_tracker_init(&bench->tracker, depth, bench->shape + 1) != NETWORK_OK || network_workspace_init(&bench->ws, &bench->net) != NETWORK_OK)
+		return 0;
+	    if(matrix_init(&bench->c, bench->net.outSize, 1) != MATRIX_OK)
+		return 0;
+	    optim_options_t options = { .type = bench->optimizer, .momentum = OPTIM_DEFAULT_MOMENTUM, .beta1 = OPTIM_DEFAULT_BETA1, .beta2 = OPTIM_DEFAULT_BETA2, .epsilon = OPTIM_DEFAULT_EPSILON };
+	    if(optim_init(&bench->optim, &bench->net, &options, 0.01f) != OPTIM_OK)
+		return 0;
+	    /* Forward pass, backward pass and weight update, about 2 + 4 floating point operations per parameter and sample */
+	    bench->flops = 6.0 * bench_params(&bench->net) * BENCH_SET_SIZE;
+	    bench->bytes = (double)(BENCH_SET_SIZE * (bench->net.inSize + bench->net.outSize)) * sizeof(MATRIX_TYPE);
+	    return 1;
+	}
+
+	case BENCH_SAVE:
+	case BENCH_LOAD: {
+	    strcpy(bench->file, "/tmp/bench_XXXXXX");
+	    int fd = mkstemp(bench->file);
+	    if(fd < 0 || !bench_initNet(bench))
+		return 0;
+	    close(fd);
+	    if(util_saveNetwork(&bench->net, bench->file) != UTIL_OK)
+		return 0;
+	    struct stat st;
+	    if(stat(bench->file, &st) != 0)
+		return 0;
+	    bench->bytes = st.st_size;
+	    if(bench->kind == BENCH_LOAD)
+		network_destroy(&bench->net);
+	    return 1;
+	}
+
+	case BENCH_POINTS_PARSE: {
+	    strcpy(bench->file, "/tmp/bench_XXXXXX");
+	    int fd = mkstemp(bench->file);
+	    FILE * f = (fd >= 0 ? fdopen(fd, "w") : NULL);
+	    if(!f)
+		return 0;
+	    for(size_t i = 0; i < BENCH_POINTS; ++i) {
+		for(size_t j = 0; j < m + k; ++j)
+		    fprintf(f, (j ? ",%f" : "%f"), rng_uniform(&bench->rng) * 20 - 10);
+		fputc('\n', f);
+	    }
+	    fclose(f);
+	    struct stat st;
+	    if(stat(bench->file, &st) != 0)
+		return 0;
+	    bench->bytes = st.st_size;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/** Runs a single operation of a benchmark */
+static void bench_run(bench_t * bench) {
+    switch(bench->kind) {
+	case BENCH_MATMUL:
+	    matrix_matmul(&bench->a, &bench->b, &bench->c);
+	    break;
+
+	case BENCH_ACTIVATION: {
+	    activation_t act = activation_get(bench->activation);
+	    (bench->derivative ? act.dfa : act.f)(&bench->a);
+	    break;
+	}
+
+	case BENCH_RNG_UNIFORM:
+	    rng_fillUniform(&bench->rng, bench->a.data, bench->a.dataLen, -1, 1);
+	    break;
+
+	case BENCH_RNG_NORMAL:
+	    rng_fillNormal(&bench->rng, bench->a.data, bench->a.dataLen, 0, 1);
+	    break;
+
+	case BENCH_INFERENCE:
+	    network_inference(&bench->net, &bench->a, &bench->c);
+	    break;
+
+	case BENCH_INFERENCE_WS:
+	    network_inference_ws(&bench->net, &bench->ws, &bench->a, &bench->c, NULL);
+	    break;
+
+	case BENCH_INFERENCE_BATCH:
+	    network_inference_batch(&bench->net, &bench->ws, &bench->a, &bench->c, NULL);
+	    break;
+
+	case BENCH_TRAIN:
+	    set_train_i(&bench->set, &bench->net, &bench->tracker, &bench->ws, &bench->c, &bench->optim);
+	    break;
+
+	case BENCH_SAVE:
+	    util_saveNetwork(&bench->net, bench->file);
+	    break;
+
+	case BENCH_LOAD: {
+	    network_t net = {0};
+	    if(util_loadNetwork(&net, bench->file) == UTIL_OK)
+		network_destroy(&net);
+	    break;
+	}
+
+	case BENCH_POINTS_PARSE: {
+	    set_t set = {0};
+	    if(util_loadPoints(&set, bench->file, bench->shape[0], bench->shape[1]) == UTIL_OK)
+		set_destroy(&set);
+	    break;
+	}
+    }
+}
+
+/** Frees the state of a benchmark */
+static void bench_teardown(bench_t * bench) {
+    matrix_destroy(&bench->a);
+    matrix_destroy(&bench->b);
+    matrix_destroy(&bench->c);
+    if(bench->ws.data)
+	network_workspace_destroy(&bench->ws);
+    if(bench->tracker.data)
+	network_tracker_destroy(&bench->tracker);
+    optim_destroy(&bench->optim);
+    if(bench->set.in)
+	set_destroy(&bench->set);
+    if(bench->net.weights)
+	network_destroy(&bench->net);
+    if(bench->file[0])
+	unlink(bench->file);
+}
+
+
+/* === Measurement === */
+
+/** Measurement options */
+typedef struct {
+    /** Timed repetitions per benchmark */
+    size_t reps;
+    /** Untimed repetitions before them */
+    size_t warmup;
+    /** Shortest duration of a repetition in seconds, the operations per repetition being calibrated to reach it */
+    double minTime;
+    /** Only benchmarks whose name contains this are run, NULL for all */
+    char const * filter;
+} bench_options_t;
+
+/** Results of a benchmark */
+typedef struct {
+    /** Operations per repetition */
+    size_t ops;
+    /** Nanoseconds per operation: fastest, median and slowest repetition */
+    double min, median, max;
+    /** Allocations per operation over the timed repetitions */
+    double allocs;
+} bench_result_t;
+
+static double bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/** Runs 'ops' operations, returning the seconds taken */
+static double bench_time(bench_t * bench, size_t ops) {
+    double start = bench_now();
+    for(size_t i = 0; i < ops; ++i)
+	bench_run(bench);
+    return bench_now() - start;
+}
+
+static int bench_compare(void const * a, void const * b) {
+    double x = *(double const *)(a), y = *(double const *)(b);
+    return (x > y) - (x < y);
+}
+
+/** Measures a prepared benchmark */
+static void bench_measure(bench_t * bench, bench_options_t const * options, bench_result_t * result) {
+    /* Calibrating the operations per repetition (which warms up as well) */
+    size_t ops = 1;
+    while(bench_time(bench, ops) < options->minTime)
+	ops *= 2;
+    for(size_t i = 0; i < options->warmup; ++i)
+	bench_time(bench, ops);
+
+    double times [options->reps];
+    size_t allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+    for(size_t i = 0; i < options->reps; ++i)
+	times[i] = bench_time(bench, ops) * 1e9 / ops;
+    allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED) - allocs;
+
+    qsort(times, options->reps, sizeof(double), bench_compare);
+    result->ops = ops;
+    result->min = times[0];
+    result->max = times[options->reps - 1];
+    result->median = (options->reps % 2 ? times[options->reps / 2] : (times[options->reps / 2 - 1] + times[options->reps / 2]) / 2);
+    result->allocs = (double)(allocs) / (ops * options->reps);
+}
+
+/** Prints a throughput table column (amount per nanosecond being giga amount per second), '-' when it isn't meaningful */
+static void bench_printRate(double amount, double ns) {
+    if(amount > 0 && ns > 0)
+	fprintf(stderr, " %10.3f", amount / ns);
+    else
+	fprintf(stderr, " %10s", "-");
+}
+
+/** Writes a throughput JSON field, null when it isn't meaningful */
+static void bench_jsonRate(FILE * json, char const * key, double amount, double ns) {
+    if(amount > 0 && ns > 0)
+	fprintf(json, ", \"%s\": %.4f", key, amount / ns);
+    else
+	fprintf(json, ", \"%s\": null", key);
+}
+
+static void bench_printHelp(char * programName) {
+    printf("Usage: '%s [options]'\n", programName);
+    printf("  Times every benchmark, printing a table to stderr and the results as JSON to stdout\n");
+    printf("  --reps <n>       ... timed repetitions per benchmark (default %d)\n", BENCH_REPS);
+    printf("  --warmup <n>     ... untimed repetitions before them (default %d)\n", BENCH_WARMUP);
+    printf("  --min-time <s>   ... shortest repetition in seconds, operations per repetition being calibrated to it (default %g)\n", BENCH_MIN_TIME);
+    printf("  --filter <text>  ... only runs benchmarks whose name contains the text\n");
+    printf("  --json <file>    ... writes the JSON into the file instead of stdout\n");
+    printf("  --list           ... lists the benchmarks\n");
+}
+
+int main(int argc, char ** argv) {
+
+    kernel_init();
+
+    bench_options_t options = { .reps = BENCH_REPS, .warmup = BENCH_WARMUP, .minTime = BENCH_MIN_TIME, .filter = NULL };
+    char const * jsonFile = NULL;
+    size_t count = sizeof(bench_list) / sizeof(bench_t);
+    for(int i = 1; i < argc; ++i) {
+	if(strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+	    bench_printHelp(argv[0]);
+	    return 0;
+	} else if(strcmp(argv[i], "--list") == 0) {
+	    for(size_t j = 0; j < count; ++j)
+		printf("%s\n", bench_list[j].name);
+	    return 0;
+	} else if(i + 1 < argc && strcmp(argv[i], "--reps") == 0) {
+	    sscanf(argv[++i], "%lu", &options.reps);
+	} else if(i + 1 < argc && strcmp(argv[i], "--warmup") == 0) {
+	    sscanf(argv[++i], "%lu", &options.warmup);
+	} else if(i + 1 < argc && strcmp(argv[i], "--min-time") == 0) {
+	    sscanf(argv[++i], "%lf", &options.minTime);
+	} else if(i + 1 < argc && strcmp(argv[i], "--filter") == 0) {
+	    options.filter = argv[++i];
+	} else if(i + 1 < argc && strcmp(argv[i], "--json") == 0) {
+	    jsonFile = argv[++i];
+	} else {
+	    printf("Error: unknown option '%s'\nTry '%s --help'\n", argv[i], argv[0]);
+	    return 1;
+	}
+    }
+    if(options.reps < 1)
+	options.reps = 1;
+
+    FILE * json = (jsonFile ? fopen(jsonFile, "w") : stdout);
+    if(!json) {
+	printf("Error: could not open '%s' for writing\n", jsonFile);
+	return 1;
+    }
+    fprintf(json, "{\n  \"kernel\": \"%s\", \"matrix_type_size\": %lu, \"reps\": %lu, \"warmup\": %lu, \"min_time\": %g,\n  \"results\": [",
+	    kernel.name, sizeof(MATRIX_TYPE), options.reps, options.warmup, options.minTime);
+    fprintf(stderr, "%-30s %12s %12s %12s %10s %10s %10s\n", "benchmark", "ns/op", "min", "max", "GFLOP/s", "GB/s", "allocs/op");
+
+    int first = 1, failed = 0;
+    for(size_t i = 0; i < count; ++i) {
+	bench_t * bench = bench_list + i;
+	if(options.filter && !strstr(bench->name, options.filter))
+	    continue;
+	if(!bench_setup(bench)) {
+	    fprintf(stderr, "Error: benchmark '%s' could not be prepared\n", bench->name);
+	    bench_teardown(bench);
+	    failed = 1;
+	    continue;
+	}
+	bench_result_t result;
+	bench_measure(bench, &options, &result);
+	bench_teardown(bench);
+
+	fprintf(stderr, "%-30s %12.1f %12.1f %12.1f", bench->name, result.median, result.min, result.max);
+	bench_printRate(bench->flops, result.median);
+	bench_printRate(bench->bytes, result.median);
+	fprintf(stderr, " %10.2f\n", result.allocs);
+
+	fprintf(json, "%s\n    {\"name\": \"%s\", \"ops_per_rep\": %lu, \"ns_per_op\": %.1f, \"ns_per_op_min\": %.1f, \"ns_per_op_max\": %.1f",
+		(first ? "" : ","), bench->name, result.ops, result.median, result.min, result.max);
+	bench_jsonRate(json, "gflops", bench->flops, result.median);
+	bench_jsonRate(json, "gbps", bench->bytes, result.median);
+	fprintf(json, ", \"allocs_per_op\": %.2f}", result.allocs);
+	first = 0;
+    }
+    fprintf(json, "\n  ]\n}\n");
+    if(json != stdout)
+	fclose(json);
+    return failed;
+}
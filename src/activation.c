@@ -1,50 +1,70 @@
 #include "activation.h"
+#include "kernel.h"
 
 void activation_relu_f(matrix_t * m) {
-    for(size_t idx = 0; idx < m->dataLen; ++idx) {
-	MATRIX_TYPE res = m->data[idx];
-	m->data[idx] = (res > 0 ? res : RELU_LEAK * res);
-    }
+    kernel.relu(m->dataLen, m->data);
 }
 
 void activation_relu_df(matrix_t * m) {
-    for(size_t idx = 0; idx < m->dataLen; ++idx) {
-	MATRIX_TYPE res = m->data[idx];
-	m->data[idx] = (res > 0 ? 1 : RELU_LEAK);
-    }
+    kernel.reluGrad(m->dataLen, m->data);
+}
+
+void activation_relu_dfa(matrix_t * m) {
+    kernel.reluGrad(m->dataLen, m->data);
 }
 
 activation_t activation_relu = {
     .f = activation_relu_f,
     .df = activation_relu_df,
+    .dfa = activation_relu_dfa,
     .type = ACTIVATION_RELU
 };
 
 void activation_logistic_f(matrix_t * m) {
-    for(size_t idx = 0; idx < m->dataLen; ++idx) {
-	m->data[idx] = 1.0f / (1 + exp(-1 * m->data[idx]));
-    }
+    kernel.logistic(m->dataLen, m->data);
 }
 
 void activation_logistic_df(matrix_t * m) {
-    for(size_t idx = 0; idx < m->dataLen; ++idx) {
-	MATRIX_TYPE res = m->data[idx];
-	m->data[idx] = 1.0f / (exp(res) * (1 + exp(-1 * res) * (1 + exp(-1 * res))));
-    }
+    /* f'(x) = f(x) * (1 - f(x)), so a single exponential per element */
+    kernel.logistic(m->dataLen, m->data);
+    kernel.logisticGrad(m->dataLen, m->data);
+}
+
+void activation_logistic_dfa(matrix_t * m) {
+    kernel.logisticGrad(m->dataLen, m->data);
 }
 
 activation_t activation_logistic = {
     .f = activation_logistic_f,
     .df = activation_logistic_df,
+    .dfa = activation_logistic_dfa,
     .type = ACTIVATION_LOGISTIC
 };
 
+void activation_logisticFast_f(matrix_t * m) {
+    kernel.logisticFast(m->dataLen, m->data);
+}
+
+void activation_logisticFast_df(matrix_t * m) {
+    kernel.logisticFast(m->dataLen, m->data);
+    kernel.logisticGrad(m->dataLen, m->data);
+}
+
+activation_t activation_logisticFast = {
+    .f = activation_logisticFast_f,
+    .df = activation_logisticFast_df,
+    .dfa = activation_logistic_dfa,
+    .type = ACTIVATION_LOGISTIC_FAST
+};
+
 activation_t activation_get(activation_type_t type) {
     switch(type) {
 	case ACTIVATION_RELU:
 	    return activation_relu;
 	case ACTIVATION_LOGISTIC:
 	    return activation_logistic;
+	case ACTIVATION_LOGISTIC_FAST:
+	    return activation_logisticFast;
 
 	default:
 	    return (activation_t){0};
@@ -18,12 +18,15 @@ typedef void (*activation_func_t) (matrix_t *);
 
 typedef enum {
     ACTIVATION_RELU = 0,
-    ACTIVATION_LOGISTIC = 1
+    ACTIVATION_LOGISTIC = 1,
+    ACTIVATION_LOGISTIC_FAST = 2
 } activation_type_t;
 
 typedef struct {
     activation_func_t f;
     activation_func_t df;
+    /** First derivative computed from the already activated values f(x) instead of x */
+    activation_func_t dfa;
     activation_type_t type;
 } activation_t;
 
@@ -34,6 +37,9 @@ void activation_relu_f(matrix_t * m);
 /** First derivative of the activation_relu function */
 void activation_relu_df(matrix_t * m);
 
+/** First derivative of the activation_relu function, from activated values */
+void activation_relu_dfa(matrix_t * m);
+
 /** Template structure for the relu activation function */
 extern activation_t activation_relu;
 
@@ -43,9 +49,21 @@ void activation_logistic_f(matrix_t * m);
 /** First derivative of the activation_logistic function */
 void activation_logistic_df(matrix_t * m);
 
+/** First derivative of the activation_logistic function, from activated values (f * (1 - f)) */
+void activation_logistic_dfa(matrix_t * m);
+
 /** Template structure for the logistic activation function */
 extern activation_t activation_logistic;
 
+/** Logistic elementwise activation function using a fast exp approximation (absolute error below 2e-5 against activation_logistic_f) */
+void activation_logisticFast_f(matrix_t * m);
+
+/** First derivative of the activation_logisticFast function */
+void activation_logisticFast_df(matrix_t * m);
+
+/** Template structure for the fast logistic activation function (shares activation_logistic_dfa) */
+extern activation_t activation_logisticFast;
+
 /** Convenience function, returns corresponding activation_t structure of the given type */
 activation_t activation_get(activation_type_t type);
 
@@ -0,0 +1,252 @@
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Returns the number of weights and biases of the network */
+static size_t _checkpoint_params(network_t const * net) {
+    size_t total = 0;
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx)
+	total += net->weights[layerIdx].dataLen + net->biases[layerIdx].dataLen;
+    return total;
+}
+
+/** Returns the size of a checkpoint file */
+static size_t _checkpoint_fileSize(size_t depth, size_t params, size_t states, size_t best) {
+    return sizeof(checkpoint_header_t) + depth * sizeof(uint64_t) + (params + states + best) * sizeof(MATRIX_TYPE);
+}
+
+/** Writes the snapshot to the temporary file and moves it over the checkpoint, so that a checkpoint file is always complete */
+static int _checkpoint_write(checkpoint_t * checkpoint) {
+    FILE * fp = fopen(checkpoint->tmpname, "wb");
+    if(!fp)
+	return 0;
+    int ok = (fwrite(checkpoint->buffer, 1, checkpoint->length, fp) == checkpoint->length && fflush(fp) == 0 && fsync(fileno(fp)) == 0);
+    if(fclose(fp) != 0 || !ok)
+	return 0;
+    return (rename(checkpoint->tmpname, checkpoint->filename) == 0);
+}
+
+/** Writer thread, writes every snapshot handed to it until stopped */
+static void * _checkpoint_writer(void * arg) {
+    checkpoint_t * checkpoint = (checkpoint_t *)(arg);
+    pthread_mutex_lock(&checkpoint->lock);
+    for(;;) {
+	while(!checkpoint->pending && !checkpoint->stop)
+	    pthread_cond_wait(&checkpoint->cond, &checkpoint->lock);
+	if(!checkpoint->pending)
+	    break;
+	/* The buffer is the thread's until the snapshot is written */
+	pthread_mutex_unlock(&checkpoint->lock);
+	int ok = _checkpoint_write(checkpoint);
+	if(!ok)
+	    fprintf(stderr, "Error: Checkpoint could not be written to '%s'\n", checkpoint->filename);
+	pthread_mutex_lock(&checkpoint->lock);
+	if(ok)
+	    ++checkpoint->written;
+	else
+	    ++checkpoint->failed;
+	checkpoint->pending = 0;
+	pthread_cond_broadcast(&checkpoint->cond);
+    }
+    pthread_mutex_unlock(&checkpoint->lock);
+    return NULL;
+}
+
+checkpoint_err_t checkpoint_open(checkpoint_t * checkpoint, char const * filename, network_t const * net, optim_t const * optim, int best) {
+    /* Checking parameters */
+    if(!checkpoint || !filename || !net || !optim)
+	return CHECKPOINT_ERR_PARAM;
+
+    size_t params = _checkpoint_params(net);
+    *checkpoint = (checkpoint_t){ .depth = net->depth, .params = params, .states = optim->stateLen, .best = (best ? params : 0) };
+    checkpoint->bufferLen = _checkpoint_fileSize(checkpoint->depth, checkpoint->params, checkpoint->states, checkpoint->best);
+    checkpoint->filename = strdup(filename);
+    checkpoint->tmpname = (char *)(malloc(strlen(filename) + sizeof(CHECKPOINT_TMP_SUFFIX)));
+    checkpoint->buffer = (unsigned char *)(malloc(checkpoint->bufferLen));
+    if(!checkpoint->filename || !checkpoint->tmpname || !checkpoint->buffer) {
+	free(checkpoint->filename);
+	free(checkpoint->tmpname);
+	free(checkpoint->buffer);
+	return CHECKPOINT_ERR_ALLOC;
+    }
+    strcpy(checkpoint->tmpname, filename);
+    strcat(checkpoint->tmpname, CHECKPOINT_TMP_SUFFIX);
+
+    pthread_mutex_init(&checkpoint->lock, NULL);
+    pthread_cond_init(&checkpoint->cond, NULL);
+    if(pthread_create(&checkpoint->thread, NULL, _checkpoint_writer, checkpoint) != 0) {
+	pthread_cond_destroy(&checkpoint->cond);
+	pthread_mutex_destroy(&checkpoint->lock);
+	free(checkpoint->filename);
+	free(checkpoint->tmpname);
+	free(checkpoint->buffer);
+	return CHECKPOINT_ERR_THREAD;
+    }
+    return CHECKPOINT_OK;
+}
+
+checkpoint_err_t checkpoint_close(checkpoint_t * checkpoint) {
+    if(!checkpoint || !checkpoint->buffer)
+	return CHECKPOINT_ERR_PARAM;
+
+    /* The writer finishes the pending snapshot before it stops */
+    pthread_mutex_lock(&checkpoint->lock);
+    checkpoint->stop = 1;
+    pthread_cond_broadcast(&checkpoint->cond);
+    pthread_mutex_unlock(&checkpoint->lock);
+    pthread_join(checkpoint->thread, NULL);
+
+    checkpoint_err_t res = (checkpoint->failed > 0 ? CHECKPOINT_ERR_FILE : CHECKPOINT_OK);
+    pthread_cond_destroy(&checkpoint->cond);
+    pthread_mutex_destroy(&checkpoint->lock);
+    free(checkpoint->filename);
+    free(checkpoint->tmpname);
+    free(checkpoint->buffer);
+    checkpoint->filename = checkpoint->tmpname = NULL;
+    checkpoint->buffer = NULL;
+    return res;
+}
+
+checkpoint_err_t checkpoint_wait(checkpoint_t * checkpoint) {
+    if(!checkpoint || !checkpoint->buffer)
+	return CHECKPOINT_ERR_PARAM;
+    pthread_mutex_lock(&checkpoint->lock);
+    while(checkpoint->pending)
+	pthread_cond_wait(&checkpoint->cond, &checkpoint->lock);
+    pthread_mutex_unlock(&checkpoint->lock);
+    return CHECKPOINT_OK;
+}
+
+checkpoint_err_t checkpoint_snapshot(checkpoint_t * checkpoint, network_t const * net, optim_t const * optim, MATRIX_TYPE const * best,
+				     checkpoint_progress_t const * progress) {
+    /* Checking parameters */
+    if(!checkpoint || !checkpoint->buffer || !net || !optim || !progress || net->depth != checkpoint->depth || optim->stateLen != checkpoint->states)
+	return CHECKPOINT_ERR_PARAM;
+
+    /* Never waiting for the writer, the trainer just tries again later */
+    pthread_mutex_lock(&checkpoint->lock);
+    int busy = checkpoint->pending;
+    pthread_mutex_unlock(&checkpoint->lock);
+    if(busy)
+	return CHECKPOINT_BUSY;
+
+    /* Copying everything into the buffer, which the writer only touches once the snapshot is handed over */
+    checkpoint_header_t header = { .magic = CHECKPOINT_MAGIC, .version = CHECKPOINT_VERSION, .endian = CHECKPOINT_ENDIAN,
+				   .valueSize = sizeof(MATRIX_TYPE), .depth = (uint32_t)(net->depth), .inSize = net->inSize,
+				   .optimizer = optim->options.type, .rate = optim->rate, .steps = optim->steps,
+				   .params = checkpoint->params, .states = checkpoint->states, .best = (best ? checkpoint->best : 0),
+				   .progress = *progress };
+    /* Without best weights the file just ends early */
+    header.fileSize = checkpoint->length = _checkpoint_fileSize(checkpoint->depth, checkpoint->params, checkpoint->states, header.best);
+    unsigned char * dst = checkpoint->buffer;
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+	uint64_t width = net->weights[layerIdx].rows;
+	memcpy(dst, &width, sizeof(width));
+	dst += sizeof(width);
+    }
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+	matrix_t const * params [2] = { net->weights + layerIdx, net->biases + layerIdx };
+	for(size_t p = 0; p < 2; ++p) {
+	    memcpy(dst, params[p]->data, params[p]->dataLen * sizeof(MATRIX_TYPE));
+	    dst += params[p]->dataLen * sizeof(MATRIX_TYPE);
+	}
+    }
+    if(checkpoint->states > 0) {
+	memcpy(dst, optim->state, checkpoint->states * sizeof(MATRIX_TYPE));
+	dst += checkpoint->states * sizeof(MATRIX_TYPE);
+    }
+    if(header.best > 0)
+	memcpy(dst, best, header.best * sizeof(MATRIX_TYPE));
+
+    pthread_mutex_lock(&checkpoint->lock);
+    checkpoint->pending = 1;
+    pthread_cond_broadcast(&checkpoint->cond);
+    pthread_mutex_unlock(&checkpoint->lock);
+    return CHECKPOINT_OK;
+}
+
+/** Reads a checkpoint header from an open file and checks it against the file size */
+static checkpoint_err_t _checkpoint_readHeader(FILE * fp, checkpoint_header_t * header) {
+    if(fread(header, sizeof(checkpoint_header_t), 1, fp) != 1)
+	return CHECKPOINT_ERR_FORMAT;
+    if(fseeko(fp, 0, SEEK_END) != 0)
+	return CHECKPOINT_ERR_FILE;
+    uint64_t fileLen = (uint64_t)(ftello(fp));
+    if(memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || header->version != CHECKPOINT_VERSION
+       || header->endian != CHECKPOINT_ENDIAN || header->valueSize != sizeof(MATRIX_TYPE) || header->depth == 0
+       || header->fileSize != fileLen || header->params > fileLen || header->states > fileLen || header->best > fileLen
+       || header->fileSize != _checkpoint_fileSize(header->depth, header->params, header->states, header->best))
+	return CHECKPOINT_ERR_FORMAT;
+    return (fseeko(fp, sizeof(checkpoint_header_t), SEEK_SET) == 0 ? CHECKPOINT_OK : CHECKPOINT_ERR_FILE);
+}
+
+checkpoint_err_t checkpoint_readHeader(char const * filename, checkpoint_header_t * header) {
+    if(!filename || !header)
+	return CHECKPOINT_ERR_PARAM;
+    FILE * fp = fopen(filename, "rb");
+    if(!fp)
+	return CHECKPOINT_ERR_FILE;
+    checkpoint_err_t res = _checkpoint_readHeader(fp, header);
+    fclose(fp);
+    return res;
+}
+
+checkpoint_err_t checkpoint_load(char const * filename, network_t * net, optim_t * optim, MATRIX_TYPE * best, checkpoint_progress_t * progress) {
+    /* Checking parameters */
+    if(!filename || !net || !optim || !progress)
+	return CHECKPOINT_ERR_PARAM;
+    FILE * fp = fopen(filename, "rb");
+    if(!fp)
+	return CHECKPOINT_ERR_FILE;
+
+    /* The checkpoint must be of this network's shape and this optimizer */
+    checkpoint_header_t header;
+    checkpoint_err_t res = _checkpoint_readHeader(fp, &header);
+    size_t params = _checkpoint_params(net);
+    if(res == CHECKPOINT_OK && (header.depth != net->depth || header.inSize != net->inSize || header.params != params
+				|| header.optimizer != (uint32_t)(optim->options.type) || header.states != optim->stateLen))
+	res = CHECKPOINT_ERR_FORMAT;
+    for(size_t layerIdx = 0; layerIdx < net->depth && res == CHECKPOINT_OK; ++layerIdx) {
+	uint64_t width = 0;
+	if(fread(&width, sizeof(width), 1, fp) != 1 || width != net->weights[layerIdx].rows)
+	    res = CHECKPOINT_ERR_FORMAT;
+    }
+
+    /* The weights and biases, the optimizer state and the best weights */
+    for(size_t layerIdx = 0; layerIdx < net->depth && res == CHECKPOINT_OK; ++layerIdx) {
+	matrix_t * layerParams [2] = { net->weights + layerIdx, net->biases + layerIdx };
+	for(size_t p = 0; p < 2 && res == CHECKPOINT_OK; ++p) {
+	    if(fread(layerParams[p]->data, sizeof(MATRIX_TYPE), layerParams[p]->dataLen, fp) != layerParams[p]->dataLen)
+		res = CHECKPOINT_ERR_FILE;
+	}
+	if(res == CHECKPOINT_OK)
+	    network_syncWeights(net, layerIdx, 0, net->weights[layerIdx].dataLen);
+    }
+    if(res == CHECKPOINT_OK && header.states > 0 && fread(optim->state, sizeof(MATRIX_TYPE), header.states, fp) != header.states)
+	res = CHECKPOINT_ERR_FILE;
+    if(res == CHECKPOINT_OK && best) {
+	if(header.best == params) {
+	    if(fread(best, sizeof(MATRIX_TYPE), params, fp) != params)
+		res = CHECKPOINT_ERR_FILE;
+	} else {
+	    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+		memcpy(best, net->weights[layerIdx].data, net->weights[layerIdx].dataLen * sizeof(MATRIX_TYPE));
+		best += net->weights[layerIdx].dataLen;
+		memcpy(best, net->biases[layerIdx].data, net->biases[layerIdx].dataLen * sizeof(MATRIX_TYPE));
+		best += net->biases[layerIdx].dataLen;
+	    }
+	}
+    }
+    fclose(fp);
+
+    if(res == CHECKPOINT_OK) {
+	optim->rate = header.rate;
+	optim->steps = header.steps;
+	*progress = header.progress;
+    }
+    return res;
+}
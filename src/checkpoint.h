@@ -0,0 +1,131 @@
+/**
+ * @file checkpoint.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing training checkpoints: snapshots of the weights, the optimizer state and the training progress,
+ * written to disk by a background thread, and resuming training from them
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "matrix.h"
+#include "network.h"
+#include "optim.h"
+
+/** Checkpoint file magic bytes */
+#define CHECKPOINT_MAGIC "FUNCCKP"
+/** Checkpoint file format version, bumped on any layout change */
+#define CHECKPOINT_VERSION 1
+/** Value of the endianness field as written, checkpoints only being read back on hosts of the same byte order and MATRIX_TYPE */
+#define CHECKPOINT_ENDIAN 0x01020304u
+/** Suffix of the file a checkpoint is written to before it replaces the previous one */
+#define CHECKPOINT_TMP_SUFFIX ".tmp"
+
+/** Training progress stored in a checkpoint, checkpoints being taken between iterations */
+typedef struct {
+    /** The number of iterations done, the data cursor of a resumed run being the start of the next pass */
+    uint64_t iterations;
+    /** Seed of the run, the weight initialization and the shuffling of every pass drawing from their own streams of it */
+    uint64_t seed;
+    /** Early stopping state, the number of evaluations, evaluations since the best loss last improved and the iteration of the best one */
+    uint64_t evaluations, sinceBest, bestIteration;
+    /** The last and the best evaluated loss */
+    double loss, bestLoss;
+} checkpoint_progress_t;
+
+/** Checkpoint file header, followed by the 'depth' layer widths (uint64_t), the weights and then the biases of every layer, the optimizer state
+ * and the kept best weights and biases, all values in MATRIX_TYPE and every field in the byte order of the writing host */
+typedef struct {
+    /** CHECKPOINT_MAGIC, zero-padded */
+    char magic [8];
+    /** CHECKPOINT_VERSION */
+    uint32_t version;
+    /** CHECKPOINT_ENDIAN */
+    uint32_t endian;
+    /** sizeof(MATRIX_TYPE) */
+    uint32_t valueSize;
+    /** The number of layers */
+    uint32_t depth;
+    /** The network input size */
+    uint64_t inSize;
+    /** The optimizer type (optim_type_t), its learning rate and its number of update steps */
+    uint32_t optimizer;
+    float rate;
+    uint64_t steps;
+    /** The numbers of weights and biases, of optimizer state values and of kept best weights and biases (0 if none) */
+    uint64_t params, states, best;
+    /** The training progress */
+    checkpoint_progress_t progress;
+    /** The total file size, to detect truncated files */
+    uint64_t fileSize;
+} checkpoint_header_t;
+
+/** Checkpoint writer, snapshots are copied into its buffer by the trainer and written out by its thread */
+typedef struct {
+    /** The checkpoint file, and the file written before replacing it */
+    char * filename;
+    char * tmpname;
+    /** The snapshot, a whole checkpoint file, and the length of the current one (shorter without best weights) */
+    unsigned char * buffer;
+    size_t bufferLen, length;
+    /** The number of layers, parameters, optimizer state values and best parameters of a snapshot */
+    size_t depth, params, states, best;
+
+    /** The writer thread */
+    pthread_t thread;
+    /** Lock protecting the state below */
+    pthread_mutex_t lock;
+    /** Signalled when a snapshot is taken or the writer stops, and when a snapshot is written */
+    pthread_cond_t cond;
+    /** Set while a snapshot waits to be written or is being written, the buffer then belonging to the thread */
+    int pending;
+    /** Set when the writer is being closed */
+    int stop;
+    /** The numbers of snapshots written and of those that failed */
+    size_t written, failed;
+} checkpoint_t;
+
+/** Checkpoint error types */
+typedef enum {
+    /** Success state */
+    CHECKPOINT_OK = 0,
+    /** Error with function parameters */
+    CHECKPOINT_ERR_PARAM = 1,
+    /** Error opening, reading or writing a file */
+    CHECKPOINT_ERR_FILE = 2,
+    /** Error with the contents of a file, or a checkpoint of another network, optimizer, byte order or value type */
+    CHECKPOINT_ERR_FORMAT = 3,
+    /** Error allocating memory */
+    CHECKPOINT_ERR_ALLOC = 4,
+    /** Error starting the writer thread */
+    CHECKPOINT_ERR_THREAD = 5,
+    /** The previous snapshot is still being written, nothing was taken */
+    CHECKPOINT_BUSY = 6
+} checkpoint_err_t;
+
+/** Opens a checkpoint writer for the given network and optimizer, keeping best weights in its snapshots if 'best' is set,
+ * and starts its thread, the writer must stay at the same address until closed */
+checkpoint_err_t checkpoint_open(checkpoint_t * checkpoint, char const * filename, network_t const * net, optim_t const * optim, int best);
+
+/** Waits for the snapshot being written, if any, and closes the writer, CHECKPOINT_ERR_FILE if any snapshot could not be written */
+checkpoint_err_t checkpoint_close(checkpoint_t * checkpoint);
+
+/** Waits until the snapshot being written, if any, is written */
+checkpoint_err_t checkpoint_wait(checkpoint_t * checkpoint);
+
+/** Takes a snapshot of the weights, the optimizer state, the best weights (NULL if not kept) and the progress, copying them into the buffer
+ * and handing it to the writer thread without waiting for any I/O, CHECKPOINT_BUSY if the previous snapshot is still being written */
+checkpoint_err_t checkpoint_snapshot(checkpoint_t * checkpoint, network_t const * net, optim_t const * optim, MATRIX_TYPE const * best,
+				     checkpoint_progress_t const * progress);
+
+/** Reads and checks the header of a checkpoint file */
+checkpoint_err_t checkpoint_readHeader(char const * filename, checkpoint_header_t * header);
+
+/** Restores the weights (re-rounding the reduced precision copies), the optimizer state, the best weights (if 'best' isn't NULL,
+ * the restored weights if the checkpoint kept none) and the progress from a checkpoint of the same network and optimizer type */
+checkpoint_err_t checkpoint_load(char const * filename, network_t * net, optim_t * optim, MATRIX_TYPE * best, checkpoint_progress_t * progress);
+
+#endif /* CHECKPOINT_H */
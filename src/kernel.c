@@ -0,0 +1,373 @@
+#include "kernel.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "activation.h"
+
+#if KERNEL_SIMD
+#include <cpuid.h>
+#endif /* KERNEL_SIMD */
+
+static void _kernel_scalar_gemm(size_t kc, MATRIX_TYPE const * restrict a, MATRIX_TYPE const * restrict b,
+				MATRIX_TYPE * restrict c, size_t ldc, size_t mr, size_t nr, MATRIX_TYPE alpha) {
+    MATRIX_TYPE acc [MATRIX_GEMM_MR][MATRIX_GEMM_NR] = {{0}};
+    for(size_t p = 0; p < kc; ++p) {
+	for(size_t i = 0; i < MATRIX_GEMM_MR; ++i) {
+	    MATRIX_TYPE av = a[i];
+	    for(size_t j = 0; j < MATRIX_GEMM_NR; ++j)
+		acc[i][j] += av * b[j];
+	}
+	a += MATRIX_GEMM_MR;
+	b += MATRIX_GEMM_NR;
+    }
+    for(size_t i = 0; i < mr; ++i) {
+	for(size_t j = 0; j < nr; ++j)
+	    c[i * ldc + j] += alpha * acc[i][j];
+    }
+}
+
+static MATRIX_TYPE _kernel_scalar_dot(size_t n, MATRIX_TYPE const * restrict x, MATRIX_TYPE const * restrict y) {
+    /* Independent partial sums, so that the compiler can still vectorize the baseline build */
+    MATRIX_TYPE part [8] = {0};
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	for(size_t l = 0; l < 8; ++l)
+	    part[l] += x[i + l] * y[i + l];
+    }
+    MATRIX_TYPE dot = ((part[0] + part[4]) + (part[1] + part[5])) + ((part[2] + part[6]) + (part[3] + part[7]));
+    for(; i < n; ++i)
+	dot += x[i] * y[i];
+    return dot;
+}
+
+static void _kernel_scalar_axpy(size_t n, MATRIX_TYPE a, MATRIX_TYPE const * restrict x, MATRIX_TYPE * restrict y) {
+    for(size_t i = 0; i < n; ++i)
+	y[i] += a * x[i];
+}
+
+static void _kernel_scalar_add(size_t n, MATRIX_TYPE const * restrict x, MATRIX_TYPE * restrict y) {
+    for(size_t i = 0; i < n; ++i)
+	y[i] += x[i];
+}
+
+static void _kernel_scalar_scale(size_t n, MATRIX_TYPE a, MATRIX_TYPE * x) {
+    for(size_t i = 0; i < n; ++i)
+	x[i] *= a;
+}
+
+static void _kernel_scalar_mul(size_t n, MATRIX_TYPE const * restrict x, MATRIX_TYPE * restrict y) {
+    for(size_t i = 0; i < n; ++i)
+	y[i] *= x[i];
+}
+
+static void _kernel_scalar_momentum(size_t n, MATRIX_TYPE const * restrict c, MATRIX_TYPE * restrict v, MATRIX_TYPE * restrict p, kernel_optim_t const * k) {
+    /* Both variants as p += a * g + b * v, branch free */
+    MATRIX_TYPE a = (k->nesterov ? k->rate : 0), b = (k->nesterov ? k->rate * k->momentum : k->rate);
+    for(size_t i = 0; i < n; ++i) {
+	MATRIX_TYPE g = k->scale * c[i] - k->decay * p[i];
+	v[i] = k->momentum * v[i] + g;
+	p[i] += a * g + b * v[i];
+    }
+}
+
+static void _kernel_scalar_adam(size_t n, MATRIX_TYPE const * restrict c, MATRIX_TYPE * restrict m, MATRIX_TYPE * restrict v, MATRIX_TYPE * restrict p, kernel_optim_t const * k) {
+    MATRIX_TYPE step = k->rate * k->correction1;
+    for(size_t i = 0; i < n; ++i) {
+	MATRIX_TYPE g = k->scale * c[i] - k->decay * p[i];
+	m[i] = k->beta1 * m[i] + (1 - k->beta1) * g;
+	v[i] = k->beta2 * v[i] + (1 - k->beta2) * g * g;
+	p[i] = k->shrink * p[i] + step * m[i] / (sqrt(k->correction2 * v[i]) + k->epsilon);
+    }
+}
+
+static void _kernel_scalar_relu(size_t n, MATRIX_TYPE * x) {
+    for(size_t i = 0; i < n; ++i)
+	x[i] = (x[i] > 0 ? x[i] : RELU_LEAK * x[i]);
+}
+
+static void _kernel_scalar_logistic(size_t n, MATRIX_TYPE * x) {
+    for(size_t i = 0; i < n; ++i)
+	x[i] = 1.0f / (1 + exp(-1 * x[i]));
+}
+
+/** exp(x) through the KERNEL_EXP2 polynomial, with 2^n applied through the exponent bits */
+static inline float _kernel_scalar_expFast(float x) {
+    float t = x * 1.44269504088896341f;
+    t = (t < -126 ? -126 : (t > 126 ? 126 : t));
+    float n = floorf(t);
+    float f = t - n;
+    float p = KERNEL_EXP2_C0 + f * (KERNEL_EXP2_C1 + f * (KERNEL_EXP2_C2 + f * KERNEL_EXP2_C3));
+    int32_t bits = ((int32_t)n + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+static void _kernel_scalar_logisticFast(size_t n, MATRIX_TYPE * x) {
+    for(size_t i = 0; i < n; ++i)
+	x[i] = 1.0f / (1.0f + _kernel_scalar_expFast(-x[i]));
+}
+
+static void _kernel_scalar_logisticGrad(size_t n, MATRIX_TYPE * y) {
+    for(size_t i = 0; i < n; ++i)
+	y[i] = y[i] * (1 - y[i]);
+}
+
+static void _kernel_scalar_reluGrad(size_t n, MATRIX_TYPE * y) {
+    for(size_t i = 0; i < n; ++i)
+	y[i] = (y[i] > 0 ? 1 : RELU_LEAK);
+}
+
+static int32_t _kernel_scalar_dotI8(size_t n, int8_t const * restrict x, int8_t const * restrict y) {
+    int32_t dot = 0;
+    for(size_t i = 0; i < n; ++i)
+	dot += (int32_t)(x[i]) * y[i];
+    return dot;
+}
+
+static int64_t _kernel_scalar_dotI16(size_t n, int16_t const * restrict x, int16_t const * restrict y) {
+    int64_t dot = 0;
+    for(size_t i = 0; i < n; ++i)
+	dot += (int32_t)(x[i]) * y[i];
+    return dot;
+}
+
+float kernel_f16ToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if(exponent == 0x1f) {
+	/* Infinity or NaN */
+	bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if(exponent > 0) {
+	bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else {
+	/* Zero or subnormal, mantissa * 2^-24 is exact in a float */
+	float val = mantissa * (1.0f / 16777216.0f);
+	return (sign ? -val : val);
+    }
+    float val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+uint16_t kernel_floatToF16(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs = bits & 0x7fffffff;
+    /* Infinity and NaN (kept quiet), then everything rounding to at least 65520 overflows */
+    if(abs >= 0x7f800000)
+	return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+    if(abs >= 0x477ff000)
+	return sign | 0x7c00;
+    /* Below the smallest normal, adding 0.5 lines the float mantissa up with the subnormal steps and rounds it */
+    if(abs < 0x38800000) {
+	float val, magic = 0.5f;
+	uint32_t magicBits;
+	memcpy(&val, &abs, sizeof(val));
+	val += magic;
+	memcpy(&bits, &val, sizeof(bits));
+	memcpy(&magicBits, &magic, sizeof(magicBits));
+	return sign | (uint16_t)(bits - magicBits);
+    }
+    /* Rebiasing the exponent and rounding the 13 dropped mantissa bits to nearest even */
+    abs += ((uint32_t)(15 - 127) << 23) + 0xfff + ((abs >> 13) & 1);
+    return sign | (uint16_t)(abs >> 13);
+}
+
+float kernel_bf16ToFloat(uint16_t h) {
+    uint32_t bits = (uint32_t)(h) << 16;
+    float val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+uint16_t kernel_floatToBF16(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    /* NaN stays quiet NaN instead of rounding into infinity */
+    if((bits & 0x7fffffff) > 0x7f800000)
+	return (uint16_t)(bits >> 16) | 0x40;
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+static MATRIX_TYPE _kernel_scalar_dotF16(size_t n, uint16_t const * restrict x, MATRIX_TYPE const * restrict y) {
+    MATRIX_TYPE dot = 0;
+    for(size_t i = 0; i < n; ++i)
+	dot += kernel_f16ToFloat(x[i]) * y[i];
+    return dot;
+}
+
+static MATRIX_TYPE _kernel_scalar_dotBF16(size_t n, uint16_t const * restrict x, MATRIX_TYPE const * restrict y) {
+    MATRIX_TYPE dot = 0;
+    for(size_t i = 0; i < n; ++i)
+	dot += kernel_bf16ToFloat(x[i]) * y[i];
+    return dot;
+}
+
+static void _kernel_scalar_widenF16(size_t n, uint16_t const * restrict x, MATRIX_TYPE * restrict y) {
+    for(size_t i = 0; i < n; ++i)
+	y[i] = kernel_f16ToFloat(x[i]);
+}
+
+static void _kernel_scalar_widenBF16(size_t n, uint16_t const * restrict x, MATRIX_TYPE * restrict y) {
+    for(size_t i = 0; i < n; ++i)
+	y[i] = kernel_bf16ToFloat(x[i]);
+}
+
+static void _kernel_scalar_philox(size_t blocks, uint64_t key, uint64_t counter, uint64_t stream, uint32_t * restrict out) {
+    for(size_t b = 0; b < blocks; ++b) {
+	uint64_t c = counter + b;
+	uint32_t x0 = (uint32_t)(c), x1 = (uint32_t)(c >> 32), x2 = (uint32_t)(stream), x3 = (uint32_t)(stream >> 32);
+	uint32_t k0 = (uint32_t)(key), k1 = (uint32_t)(key >> 32);
+	for(int r = 0; r < KERNEL_PHILOX_ROUNDS; ++r) {
+	    uint64_t p0 = (uint64_t)(KERNEL_PHILOX_M0) * x0, p1 = (uint64_t)(KERNEL_PHILOX_M1) * x2;
+	    uint32_t y0 = (uint32_t)(p1 >> 32) ^ x1 ^ k0, y2 = (uint32_t)(p0 >> 32) ^ x3 ^ k1;
+	    x1 = (uint32_t)(p1);
+	    x3 = (uint32_t)(p0);
+	    x0 = y0;
+	    x2 = y2;
+	    k0 += KERNEL_PHILOX_W0;
+	    k1 += KERNEL_PHILOX_W1;
+	}
+	out[4 * b] = x0;
+	out[4 * b + 1] = x1;
+	out[4 * b + 2] = x2;
+	out[4 * b + 3] = x3;
+    }
+}
+
+kernel_t const kernel_scalar = {
+    .isa = KERNEL_ISA_SCALAR,
+    .name = "scalar",
+    .gemm = _kernel_scalar_gemm,
+    .dot = _kernel_scalar_dot,
+    .axpy = _kernel_scalar_axpy,
+    .add = _kernel_scalar_add,
+    .scale = _kernel_scalar_scale,
+    .mul = _kernel_scalar_mul,
+    .momentum = _kernel_scalar_momentum,
+    .adam = _kernel_scalar_adam,
+    .relu = _kernel_scalar_relu,
+    .logistic = _kernel_scalar_logistic,
+    .logisticFast = _kernel_scalar_logisticFast,
+    .logisticGrad = _kernel_scalar_logisticGrad,
+    .reluGrad = _kernel_scalar_reluGrad,
+    .dotI8 = _kernel_scalar_dotI8,
+    .dotI16 = _kernel_scalar_dotI16,
+    .dotF16 = _kernel_scalar_dotF16,
+    .dotBF16 = _kernel_scalar_dotBF16,
+    .widenF16 = _kernel_scalar_widenF16,
+    .widenBF16 = _kernel_scalar_widenBF16,
+    .philox = _kernel_scalar_philox
+};
+
+kernel_t kernel = {
+    .isa = KERNEL_ISA_SCALAR,
+    .name = "scalar",
+    .gemm = _kernel_scalar_gemm,
+    .dot = _kernel_scalar_dot,
+    .axpy = _kernel_scalar_axpy,
+    .add = _kernel_scalar_add,
+    .scale = _kernel_scalar_scale,
+    .mul = _kernel_scalar_mul,
+    .momentum = _kernel_scalar_momentum,
+    .adam = _kernel_scalar_adam,
+    .relu = _kernel_scalar_relu,
+    .logistic = _kernel_scalar_logistic,
+    .logisticFast = _kernel_scalar_logisticFast,
+    .logisticGrad = _kernel_scalar_logisticGrad,
+    .reluGrad = _kernel_scalar_reluGrad,
+    .dotI8 = _kernel_scalar_dotI8,
+    .dotI16 = _kernel_scalar_dotI16,
+    .dotF16 = _kernel_scalar_dotF16,
+    .dotBF16 = _kernel_scalar_dotBF16,
+    .widenF16 = _kernel_scalar_widenF16,
+    .widenBF16 = _kernel_scalar_widenBF16,
+    .philox = _kernel_scalar_philox
+};
+
+#if KERNEL_SIMD
+/** Reads the extended control register 0, which holds the register states enabled by the operating system */
+static unsigned int _kernel_xgetbv(void) {
+    unsigned int eax = 0, edx = 0;
+    __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+}
+#endif /* KERNEL_SIMD */
+
+kernel_isa_t kernel_detect(void) {
+    kernel_isa_t isa = KERNEL_ISA_SCALAR;
+#if KERNEL_SIMD
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	return isa;
+    if(edx & bit_SSE2)
+	isa = KERNEL_ISA_SSE2;
+
+    /* AVX state has to be enabled by the OS (OSXSAVE + XCR0 bits 1, 2) before the cpuid feature bits mean anything,
+     * the AVX2 level also relies on FMA and on F16C for the fp16 conversions */
+    if(!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX) || !(ecx & bit_FMA) || !(ecx & bit_F16C))
+	return isa;
+    unsigned int xcr0 = _kernel_xgetbv();
+    if((xcr0 & 0x6) != 0x6)
+	return isa;
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+	return isa;
+    if(ebx & bit_AVX2)
+	isa = KERNEL_ISA_AVX2;
+
+    /* AVX-512 additionally needs the opmask and upper ZMM states (XCR0 bits 5, 6, 7) */
+    if((ebx & bit_AVX512F) && (xcr0 & 0xe0) == 0xe0)
+	isa = KERNEL_ISA_AVX512;
+#endif /* KERNEL_SIMD */
+    return isa;
+}
+
+kernel_isa_t kernel_select(kernel_isa_t isa) {
+    kernel_isa_t supported = kernel_detect();
+    if(isa > supported)
+	isa = supported;
+
+    switch(isa) {
+#if KERNEL_SIMD
+	case KERNEL_ISA_AVX512:
+	    kernel = kernel_avx512;
+	    break;
+	case KERNEL_ISA_AVX2:
+	    kernel = kernel_avx2;
+	    break;
+	case KERNEL_ISA_SSE2:
+	    kernel = kernel_sse2;
+	    break;
+#endif /* KERNEL_SIMD */
+	default:
+	    kernel = kernel_scalar;
+	    break;
+    }
+    return kernel.isa;
+}
+
+kernel_isa_t kernel_init(void) {
+    kernel_isa_t isa = KERNEL_ISA_AVX512;
+    char const * override = getenv(KERNEL_ENV_OVERRIDE);
+    if(override) {
+	if(strcmp(override, "scalar") == 0)
+	    isa = KERNEL_ISA_SCALAR;
+	else if(strcmp(override, "sse2") == 0)
+	    isa = KERNEL_ISA_SSE2;
+	else if(strcmp(override, "avx2") == 0)
+	    isa = KERNEL_ISA_AVX2;
+	else if(strcmp(override, "avx512") == 0)
+	    isa = KERNEL_ISA_AVX512;
+	else
+	    fprintf(stderr, "Warning: unknown %s value '%s' (scalar, sse2, avx2 or avx512), using the best supported kernels\n",
+		    KERNEL_ENV_OVERRIDE, override);
+    }
+    return kernel_select(isa);
+}
@@ -0,0 +1,164 @@
+/**
+ * @file kernel.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing the runtime-dispatched compute kernels (scalar, SSE2, AVX2+FMA, AVX-512) used by matrix and activation functions
+ */
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+/** Environment variable which, if set, overrides the detected instruction set (values: scalar, sse2, avx2, avx512) */
+#ifndef KERNEL_ENV_OVERRIDE
+#define KERNEL_ENV_OVERRIDE "FUNC_KERNEL"
+#endif /* KERNEL_ENV_OVERRIDE */
+
+/* The SIMD kernels are single precision x86 code, any other build only gets the scalar kernels */
+#if defined(MATRIX_TYPE_FLOAT) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_SIMD 1
+#else
+#define KERNEL_SIMD 0
+#endif /* KERNEL_SIMD */
+
+#if KERNEL_SIMD && (MATRIX_GEMM_MR != 6 || MATRIX_GEMM_NR != 16)
+#error "The SIMD GEMM micro-kernels are written for a 6 x 16 register tile"
+#endif /* MATRIX_GEMM_MR, MATRIX_GEMM_NR */
+
+/* Degree 3 minimax polynomial for 2^f on [0, 1) used by the fast exp (relative error below 7.5e-5) */
+#define KERNEL_EXP2_C0 0.99992531f
+#define KERNEL_EXP2_C1 0.69583303f
+#define KERNEL_EXP2_C2 0.22606759f
+#define KERNEL_EXP2_C3 0.07802466f
+
+/** Instruction set levels, ordered so that each level implies support for the ones below it */
+typedef enum {
+    KERNEL_ISA_SCALAR = 0,
+    KERNEL_ISA_SSE2 = 1,
+    KERNEL_ISA_AVX2 = 2,
+    KERNEL_ISA_AVX512 = 3
+} kernel_isa_t;
+
+/** Hyperparameters of one fused optimizer update (see kernel_t.momentum and kernel_t.adam), every kernel first forming the step
+ * g = scale * c - decay * p from the corrections c (the negative gradient) and the parameters p */
+typedef struct {
+    /** Factor of the corrections (1 / batch size, or the error derivative of a node for a per-sample row) */
+    MATRIX_TYPE scale;
+    /** The learning rate */
+    MATRIX_TYPE rate;
+    /** L2 penalty factor of the parameters */
+    MATRIX_TYPE decay;
+    /** Velocity decay factor of momentum, Nesterov momentum looking ahead along the updated velocity if set */
+    MATRIX_TYPE momentum;
+    int nesterov;
+    /** Adam decay rates of the first and second moments, and their bias corrections 1 / (1 - beta^t) */
+    MATRIX_TYPE beta1, beta2, correction1, correction2;
+    /** Adam denominator offset */
+    MATRIX_TYPE epsilon;
+    /** Factor the parameters shrink by before an Adam step, 1 - rate * weight decay for AdamW's decoupled weight decay */
+    MATRIX_TYPE shrink;
+} kernel_optim_t;
+
+/** Philox4x32-10 multipliers, key increments (Weyl sequence) and number of rounds */
+#define KERNEL_PHILOX_M0 0xD2511F53u
+#define KERNEL_PHILOX_M1 0xCD9E8D57u
+#define KERNEL_PHILOX_W0 0x9E3779B9u
+#define KERNEL_PHILOX_W1 0xBB67AE85u
+#define KERNEL_PHILOX_ROUNDS 10
+
+/** Table of kernels implemented for one instruction set */
+typedef struct {
+    /** The instruction set the kernels in this table use */
+    kernel_isa_t isa;
+    /** Human readable name of the instruction set */
+    char const * name;
+
+    /** GEMM micro-kernel, adds alpha times the product of a packed MATRIX_GEMM_MR x kc panel of A
+     * and a packed kc x MATRIX_GEMM_NR panel of B to the top left mr x nr corner of a tile of C */
+    void (*gemm)(size_t kc, MATRIX_TYPE const * a, MATRIX_TYPE const * b, MATRIX_TYPE * c, size_t ldc, size_t mr, size_t nr, MATRIX_TYPE alpha);
+    /** Dot product of two vectors */
+    MATRIX_TYPE (*dot)(size_t n, MATRIX_TYPE const * x, MATRIX_TYPE const * y);
+    /** y += a * x */
+    void (*axpy)(size_t n, MATRIX_TYPE a, MATRIX_TYPE const * x, MATRIX_TYPE * y);
+    /** y += x */
+    void (*add)(size_t n, MATRIX_TYPE const * x, MATRIX_TYPE * y);
+    /** x *= a */
+    void (*scale)(size_t n, MATRIX_TYPE a, MATRIX_TYPE * x);
+    /** y *= x (elementwise) */
+    void (*mul)(size_t n, MATRIX_TYPE const * x, MATRIX_TYPE * y);
+    /** Fused momentum update in one pass, v = momentum * v + g, then p += rate * v, or p += rate * (g + momentum * v) with nesterov */
+    void (*momentum)(size_t n, MATRIX_TYPE const * c, MATRIX_TYPE * v, MATRIX_TYPE * p, kernel_optim_t const * k);
+    /** Fused Adam update in one pass, m = beta1 * m + (1 - beta1) * g, v = beta2 * v + (1 - beta2) * g^2,
+     * then p = shrink * p + rate * correction1 * m / (sqrt(correction2 * v) + epsilon) */
+    void (*adam)(size_t n, MATRIX_TYPE const * c, MATRIX_TYPE * m, MATRIX_TYPE * v, MATRIX_TYPE * p, kernel_optim_t const * k);
+    /** In-place leaky ReLU */
+    void (*relu)(size_t n, MATRIX_TYPE * x);
+    /** In-place logistic function */
+    void (*logistic)(size_t n, MATRIX_TYPE * x);
+    /** In-place logistic function through the fast exp, absolute error below 2e-5 */
+    void (*logisticFast)(size_t n, MATRIX_TYPE * x);
+    /** In-place logistic derivative from already activated values, y = y * (1 - y) */
+    void (*logisticGrad)(size_t n, MATRIX_TYPE * y);
+    /** In-place leaky ReLU derivative, valid for both pre- and post-activation values since the activation keeps the sign */
+    void (*reluGrad)(size_t n, MATRIX_TYPE * y);
+
+    /** Dot product of two int8 vectors, exact as long as n stays below 2^17 (values within [-127, 127]) */
+    int32_t (*dotI8)(size_t n, int8_t const * x, int8_t const * y);
+    /** Dot product of two int16 vectors, exact for values within [-32767, 32767] */
+    int64_t (*dotI16)(size_t n, int16_t const * x, int16_t const * y);
+
+    /** Dot product of an fp16 vector and a vector, accumulated at full precision */
+    MATRIX_TYPE (*dotF16)(size_t n, uint16_t const * x, MATRIX_TYPE const * y);
+    /** Dot product of a bf16 vector and a vector, accumulated at full precision */
+    MATRIX_TYPE (*dotBF16)(size_t n, uint16_t const * x, MATRIX_TYPE const * y);
+    /** y = x, widening an fp16 vector */
+    void (*widenF16)(size_t n, uint16_t const * x, MATRIX_TYPE * y);
+    /** y = x, widening a bf16 vector */
+    void (*widenBF16)(size_t n, uint16_t const * x, MATRIX_TYPE * y);
+
+    /** Philox4x32-10 keyed by 'key', 4 words per block into 'out' for the blocks whose counters are (counter + i, stream) for i in [0, blocks),
+     * the same words on every instruction set */
+    void (*philox)(size_t blocks, uint64_t key, uint64_t counter, uint64_t stream, uint32_t * out);
+
+} kernel_t;
+
+/** The currently active kernel table, scalar until kernel_init or kernel_select is called */
+extern kernel_t kernel;
+
+/** Portable kernels, always available */
+extern kernel_t const kernel_scalar;
+
+#if KERNEL_SIMD
+/** SSE2 kernels */
+extern kernel_t const kernel_sse2;
+/** AVX2 + FMA kernels */
+extern kernel_t const kernel_avx2;
+/** AVX-512F kernels */
+extern kernel_t const kernel_avx512;
+#endif /* KERNEL_SIMD */
+
+/** Converts an IEEE 754 half precision (fp16) value to float */
+float kernel_f16ToFloat(uint16_t h);
+
+/** Converts a float to half precision (fp16), rounding to nearest even, out of range values becoming infinite */
+uint16_t kernel_floatToF16(float f);
+
+/** Converts a bfloat16 value (the upper half of a float) to float */
+float kernel_bf16ToFloat(uint16_t h);
+
+/** Converts a float to bfloat16, rounding to nearest even */
+uint16_t kernel_floatToBF16(float f);
+
+/** Returns the best instruction set supported by both the CPU (checked through cpuid) and the operating system */
+kernel_isa_t kernel_detect(void);
+
+/** Activates the kernels of the given instruction set, or of the best supported one below it, returns the selected instruction set */
+kernel_isa_t kernel_select(kernel_isa_t isa);
+
+/** Selects the best supported kernels, unless limited through the KERNEL_ENV_OVERRIDE environment variable (scalar, sse2, avx2 or avx512,
+ * an unknown value being warned about and ignored), returns the selected instruction set */
+kernel_isa_t kernel_init(void);
+
+#endif /* KERNEL_H */
@@ -0,0 +1,368 @@
+#include "kernel.h"
+
+#if KERNEL_SIMD
+#pragma GCC target("avx2,fma,f16c")
+#include <immintrin.h>
+
+#include "activation.h"
+
+/** Horizontal sum of the 8 lanes of a vector */
+static inline float _kernel_avx2_hsum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+    return _mm_cvtss_f32(s);
+}
+
+/** Vector exp(x) (Cephes expf range reduction and polynomial, within 2 ulp of expf over the clamped input range) */
+static inline __m256 _kernel_avx2_exp(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(88.0f));
+    /* x = n * ln2 + r, with |r| <= ln2 / 2 */
+    __m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+    __m256 p = _mm256_set1_ps(1.9875691500E-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507E-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073E-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894E-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459E-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201E-1f));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    /* Scaling by 2^n through the exponent bits */
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+/** Fast vector exp(x) through the KERNEL_EXP2 polynomial */
+static inline __m256 _kernel_avx2_expFast(__m256 x) {
+    __m256 t = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f));
+    t = _mm256_min_ps(_mm256_max_ps(t, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(126.0f));
+    __m256 n = _mm256_floor_ps(t);
+    __m256 f = _mm256_sub_ps(t, n);
+    __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(KERNEL_EXP2_C3), f, _mm256_set1_ps(KERNEL_EXP2_C2));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(KERNEL_EXP2_C1));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(KERNEL_EXP2_C0));
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+static void _kernel_avx2_gemm(size_t kc, float const * a, float const * b, float * c, size_t ldc, size_t mr, size_t nr, float alpha) {
+    /* 6 x 16 register tile, 12 accumulators + 2 B vectors + 1 broadcast A value */
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps(), c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps(), c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for(size_t p = 0; p < kc; ++p) {
+	__m256 b0 = _mm256_loadu_ps(b), b1 = _mm256_loadu_ps(b + 8), av;
+	av = _mm256_broadcast_ss(a);
+	c00 = _mm256_fmadd_ps(av, b0, c00);
+	c01 = _mm256_fmadd_ps(av, b1, c01);
+	av = _mm256_broadcast_ss(a + 1);
+	c10 = _mm256_fmadd_ps(av, b0, c10);
+	c11 = _mm256_fmadd_ps(av, b1, c11);
+	av = _mm256_broadcast_ss(a + 2);
+	c20 = _mm256_fmadd_ps(av, b0, c20);
+	c21 = _mm256_fmadd_ps(av, b1, c21);
+	av = _mm256_broadcast_ss(a + 3);
+	c30 = _mm256_fmadd_ps(av, b0, c30);
+	c31 = _mm256_fmadd_ps(av, b1, c31);
+	av = _mm256_broadcast_ss(a + 4);
+	c40 = _mm256_fmadd_ps(av, b0, c40);
+	c41 = _mm256_fmadd_ps(av, b1, c41);
+	av = _mm256_broadcast_ss(a + 5);
+	c50 = _mm256_fmadd_ps(av, b0, c50);
+	c51 = _mm256_fmadd_ps(av, b1, c51);
+	a += MATRIX_GEMM_MR;
+	b += MATRIX_GEMM_NR;
+    }
+    __m256 acc [MATRIX_GEMM_MR][2] = { {c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51} };
+    __m256 va = _mm256_set1_ps(alpha);
+    if(nr == MATRIX_GEMM_NR) {
+	for(size_t i = 0; i < mr; ++i) {
+	    float * row = c + i * ldc;
+	    _mm256_storeu_ps(row, _mm256_fmadd_ps(va, acc[i][0], _mm256_loadu_ps(row)));
+	    _mm256_storeu_ps(row + 8, _mm256_fmadd_ps(va, acc[i][1], _mm256_loadu_ps(row + 8)));
+	}
+    } else {
+	/* Edge tile, spilling the accumulators and adding only the valid part */
+	float tile [MATRIX_GEMM_MR][MATRIX_GEMM_NR];
+	for(size_t i = 0; i < mr; ++i) {
+	    _mm256_storeu_ps(tile[i], acc[i][0]);
+	    _mm256_storeu_ps(tile[i] + 8, acc[i][1]);
+	    for(size_t j = 0; j < nr; ++j)
+		c[i * ldc + j] += alpha * tile[i][j];
+	}
+    }
+}
+
+static float _kernel_avx2_dot(size_t n, float const * x, float const * y) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+	s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+	s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), s1);
+	s2 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 16), _mm256_loadu_ps(y + i + 16), s2);
+	s3 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 24), _mm256_loadu_ps(y + i + 24), s3);
+    }
+    for(; i + 8 <= n; i += 8)
+	s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+    float dot = _kernel_avx2_hsum(_mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+    for(; i < n; ++i)
+	dot += x[i] * y[i];
+    return dot;
+}
+
+static void _kernel_avx2_axpy(size_t n, float a, float const * x, float * y) {
+    __m256 va = _mm256_set1_ps(a);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    for(; i < n; ++i)
+	y[i] += a * x[i];
+}
+
+static void _kernel_avx2_add(size_t n, float const * x, float * y) {
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    for(; i < n; ++i)
+	y[i] += x[i];
+}
+
+static void _kernel_avx2_scale(size_t n, float a, float * x) {
+    __m256 va = _mm256_set1_ps(a);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(x + i, _mm256_mul_ps(va, _mm256_loadu_ps(x + i)));
+    for(; i < n; ++i)
+	x[i] *= a;
+}
+
+static void _kernel_avx2_mul(size_t n, float const * x, float * y) {
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    for(; i < n; ++i)
+	y[i] *= x[i];
+}
+
+static void _kernel_avx2_momentum(size_t n, float const * c, float * v, float * p, kernel_optim_t const * k) {
+    float a = (k->nesterov ? k->rate : 0), b = (k->nesterov ? k->rate * k->momentum : k->rate);
+    __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b), scale = _mm256_set1_ps(k->scale), decay = _mm256_set1_ps(k->decay), mu = _mm256_set1_ps(k->momentum);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m256 pi = _mm256_loadu_ps(p + i);
+	__m256 g = _mm256_fnmadd_ps(decay, pi, _mm256_mul_ps(scale, _mm256_loadu_ps(c + i)));
+	__m256 vi = _mm256_fmadd_ps(mu, _mm256_loadu_ps(v + i), g);
+	_mm256_storeu_ps(v + i, vi);
+	_mm256_storeu_ps(p + i, _mm256_fmadd_ps(vb, vi, _mm256_fmadd_ps(va, g, pi)));
+    }
+    kernel_scalar.momentum(n - i, c + i, v + i, p + i, k);
+}
+
+static void _kernel_avx2_adam(size_t n, float const * c, float * m, float * v, float * p, kernel_optim_t const * k) {
+    __m256 scale = _mm256_set1_ps(k->scale), decay = _mm256_set1_ps(k->decay), b1 = _mm256_set1_ps(k->beta1), b2 = _mm256_set1_ps(k->beta2);
+    __m256 nb1 = _mm256_set1_ps(1 - k->beta1), nb2 = _mm256_set1_ps(1 - k->beta2), c2 = _mm256_set1_ps(k->correction2), eps = _mm256_set1_ps(k->epsilon);
+    __m256 shrink = _mm256_set1_ps(k->shrink), step = _mm256_set1_ps(k->rate * k->correction1);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m256 pi = _mm256_loadu_ps(p + i);
+	__m256 g = _mm256_fnmadd_ps(decay, pi, _mm256_mul_ps(scale, _mm256_loadu_ps(c + i)));
+	__m256 mi = _mm256_fmadd_ps(b1, _mm256_loadu_ps(m + i), _mm256_mul_ps(nb1, g));
+	__m256 vi = _mm256_fmadd_ps(b2, _mm256_loadu_ps(v + i), _mm256_mul_ps(nb2, _mm256_mul_ps(g, g)));
+	_mm256_storeu_ps(m + i, mi);
+	_mm256_storeu_ps(v + i, vi);
+	__m256 denom = _mm256_add_ps(_mm256_sqrt_ps(_mm256_mul_ps(c2, vi)), eps);
+	_mm256_storeu_ps(p + i, _mm256_fmadd_ps(shrink, pi, _mm256_div_ps(_mm256_mul_ps(step, mi), denom)));
+    }
+    kernel_scalar.adam(n - i, c + i, m + i, v + i, p + i, k);
+}
+
+static void _kernel_avx2_relu(size_t n, float * x) {
+    /* With 0 < RELU_LEAK < 1, max(x, leak * x) picks x for positive and leak * x for negative inputs */
+    __m256 leak = _mm256_set1_ps(RELU_LEAK);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m256 v = _mm256_loadu_ps(x + i);
+	_mm256_storeu_ps(x + i, _mm256_max_ps(v, _mm256_mul_ps(leak, v)));
+    }
+    kernel_scalar.relu(n - i, x + i);
+}
+
+static void _kernel_avx2_logistic(size_t n, float * x) {
+    __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m256 e = _kernel_avx2_exp(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i)));
+	_mm256_storeu_ps(x + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+    }
+    kernel_scalar.logistic(n - i, x + i);
+}
+
+static void _kernel_avx2_logisticFast(size_t n, float * x) {
+    __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m256 d = _mm256_add_ps(one, _kernel_avx2_expFast(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i))));
+	/* Reciprocal estimate refined by one Newton step instead of a full division */
+	__m256 r = _mm256_rcp_ps(d);
+	_mm256_storeu_ps(x + i, _mm256_mul_ps(r, _mm256_fnmadd_ps(d, r, two)));
+    }
+    kernel_scalar.logisticFast(n - i, x + i);
+}
+
+static void _kernel_avx2_logisticGrad(size_t n, float * y) {
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m256 v = _mm256_loadu_ps(y + i);
+	_mm256_storeu_ps(y + i, _mm256_fnmadd_ps(v, v, v));
+    }
+    kernel_scalar.logisticGrad(n - i, y + i);
+}
+
+static void _kernel_avx2_reluGrad(size_t n, float * y) {
+    __m256 one = _mm256_set1_ps(1.0f), leak = _mm256_set1_ps(RELU_LEAK);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m256 positive = _mm256_cmp_ps(_mm256_loadu_ps(y + i), _mm256_setzero_ps(), _CMP_GT_OQ);
+	_mm256_storeu_ps(y + i, _mm256_blendv_ps(leak, one, positive));
+    }
+    kernel_scalar.reluGrad(n - i, y + i);
+}
+
+static int32_t _kernel_avx2_dotI8(size_t n, int8_t const * x, int8_t const * y) {
+    __m256i s = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	__m256i vx = _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(x + i)));
+	__m256i vy = _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(y + i)));
+	s = _mm256_add_epi32(s, _mm256_madd_epi16(vx, vy));
+    }
+    __m128i h = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0x4e));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0xb1));
+    return _mm_cvtsi128_si32(h) + kernel_scalar.dotI8(n - i, x + i, y + i);
+}
+
+static int64_t _kernel_avx2_dotI16(size_t n, int16_t const * x, int16_t const * y) {
+    __m256i s = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	/* Pairwise 32-bit sums, sign-extended to 64 bits before accumulating */
+	__m256i p = _mm256_madd_epi16(_mm256_loadu_si256((__m256i const *)(x + i)), _mm256_loadu_si256((__m256i const *)(y + i)));
+	s = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(p)));
+	s = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(p, 1)));
+    }
+    __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    h = _mm_add_epi64(h, _mm_unpackhi_epi64(h, h));
+    return _mm_cvtsi128_si64(h) + kernel_scalar.dotI16(n - i, x + i, y + i);
+}
+
+/** Widens 8 bf16 values, each becoming the upper half of a float lane */
+static inline __m256 _kernel_avx2_loadBF16(uint16_t const * x) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i const *)(x))), 16));
+}
+
+static float _kernel_avx2_dotF16(size_t n, uint16_t const * x, float const * y) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	s0 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128((__m128i const *)(x + i))), _mm256_loadu_ps(y + i), s0);
+	s1 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128((__m128i const *)(x + i + 8))), _mm256_loadu_ps(y + i + 8), s1);
+    }
+    return _kernel_avx2_hsum(_mm256_add_ps(s0, s1)) + kernel_scalar.dotF16(n - i, x + i, y + i);
+}
+
+static float _kernel_avx2_dotBF16(size_t n, uint16_t const * x, float const * y) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	s0 = _mm256_fmadd_ps(_kernel_avx2_loadBF16(x + i), _mm256_loadu_ps(y + i), s0);
+	s1 = _mm256_fmadd_ps(_kernel_avx2_loadBF16(x + i + 8), _mm256_loadu_ps(y + i + 8), s1);
+    }
+    return _kernel_avx2_hsum(_mm256_add_ps(s0, s1)) + kernel_scalar.dotBF16(n - i, x + i, y + i);
+}
+
+static void _kernel_avx2_widenF16(size_t n, uint16_t const * x, float * y) {
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(y + i, _mm256_cvtph_ps(_mm_loadu_si128((__m128i const *)(x + i))));
+    kernel_scalar.widenF16(n - i, x + i, y + i);
+}
+
+static void _kernel_avx2_widenBF16(size_t n, uint16_t const * x, float * y) {
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(y + i, _kernel_avx2_loadBF16(x + i));
+    kernel_scalar.widenBF16(n - i, x + i, y + i);
+}
+
+/** Low and high halves of the 32 x 32 bit products of the lanes of x with m */
+static inline void _kernel_avx2_mulhilo(__m256i x, __m256i m, __m256i * lo, __m256i * hi) {
+    __m256i even = _mm256_mul_epu32(x, m), odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m);
+    *lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    *hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+/* Eight blocks at a time, one per lane, transposed back into block order on the way out */
+static void _kernel_avx2_philox(size_t blocks, uint64_t key, uint64_t counter, uint64_t stream, uint32_t * out) {
+    __m256i const m0 = _mm256_set1_epi32((int)(KERNEL_PHILOX_M0)), m1 = _mm256_set1_epi32((int)(KERNEL_PHILOX_M1));
+    size_t b = 0;
+    for(; b + 8 <= blocks; b += 8) {
+	uint32_t lo [8], hi [8];
+	for(int l = 0; l < 8; ++l) {
+	    lo[l] = (uint32_t)(counter + b + l);
+	    hi[l] = (uint32_t)((counter + b + l) >> 32);
+	}
+	__m256i x0 = _mm256_loadu_si256((__m256i const *)(lo)), x1 = _mm256_loadu_si256((__m256i const *)(hi));
+	__m256i x2 = _mm256_set1_epi32((int)(uint32_t)(stream)), x3 = _mm256_set1_epi32((int)(uint32_t)(stream >> 32));
+	uint32_t k0 = (uint32_t)(key), k1 = (uint32_t)(key >> 32);
+	for(int r = 0; r < KERNEL_PHILOX_ROUNDS; ++r) {
+	    __m256i lo0, hi0, lo1, hi1;
+	    _kernel_avx2_mulhilo(x0, m0, &lo0, &hi0);
+	    _kernel_avx2_mulhilo(x2, m1, &lo1, &hi1);
+	    x0 = _mm256_xor_si256(_mm256_xor_si256(hi1, x1), _mm256_set1_epi32((int)(k0)));
+	    x2 = _mm256_xor_si256(_mm256_xor_si256(hi0, x3), _mm256_set1_epi32((int)(k1)));
+	    x1 = lo1;
+	    x3 = lo0;
+	    k0 += KERNEL_PHILOX_W0;
+	    k1 += KERNEL_PHILOX_W1;
+	}
+	/* Within each 128 bit half u0..u3 end up holding blocks 0..3 (low half) and 4..7 (high half) */
+	__m256i t0 = _mm256_unpacklo_epi32(x0, x1), t1 = _mm256_unpackhi_epi32(x0, x1);
+	__m256i t2 = _mm256_unpacklo_epi32(x2, x3), t3 = _mm256_unpackhi_epi32(x2, x3);
+	__m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+	__m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+	_mm256_storeu_si256((__m256i *)(out + 4 * b), _mm256_permute2x128_si256(u0, u1, 0x20));
+	_mm256_storeu_si256((__m256i *)(out + 4 * b + 8), _mm256_permute2x128_si256(u2, u3, 0x20));
+	_mm256_storeu_si256((__m256i *)(out + 4 * b + 16), _mm256_permute2x128_si256(u0, u1, 0x31));
+	_mm256_storeu_si256((__m256i *)(out + 4 * b + 24), _mm256_permute2x128_si256(u2, u3, 0x31));
+    }
+    kernel_scalar.philox(blocks - b, key, counter + b, stream, out + 4 * b);
+}
+
+kernel_t const kernel_avx2 = {
+    .isa = KERNEL_ISA_AVX2,
+    .name = "avx2",
+    .gemm = _kernel_avx2_gemm,
+    .dot = _kernel_avx2_dot,
+    .axpy = _kernel_avx2_axpy,
+    .add = _kernel_avx2_add,
+    .scale = _kernel_avx2_scale,
+    .mul = _kernel_avx2_mul,
+    .momentum = _kernel_avx2_momentum,
+    .adam = _kernel_avx2_adam,
+    .relu = _kernel_avx2_relu,
+    .logistic = _kernel_avx2_logistic,
+    .logisticFast = _kernel_avx2_logisticFast,
+    .logisticGrad = _kernel_avx2_logisticGrad,
+    .reluGrad = _kernel_avx2_reluGrad,
+    .dotI8 = _kernel_avx2_dotI8,
+    .dotI16 = _kernel_avx2_dotI16,
+    .dotF16 = _kernel_avx2_dotF16,
+    .dotBF16 = _kernel_avx2_dotBF16,
+    .widenF16 = _kernel_avx2_widenF16,
+    .widenBF16 = _kernel_avx2_widenBF16,
+    .philox = _kernel_avx2_philox
+};
+
+#endif /* KERNEL_SIMD */
@@ -0,0 +1,352 @@
+#include "kernel.h"
+
+#if KERNEL_SIMD
+#pragma GCC target("avx512f")
+#include <immintrin.h>
+
+#include "activation.h"
+
+/** Vector exp(x), same approximation as the AVX2 version, with the 2^n scaling done by vscalefps */
+static inline __m512 _kernel_avx512_exp(__m512 x) {
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-87.0f)), _mm512_set1_ps(88.0f));
+    __m512 n = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(1.44269504088896341f), _mm512_set1_ps(0.5f)),
+				    _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(0.693359375f), x);
+    r = _mm512_fnmadd_ps(n, _mm512_set1_ps(-2.12194440e-4f), r);
+    __m512 p = _mm512_set1_ps(1.9875691500E-4f);
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.3981999507E-3f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(8.3334519073E-3f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(4.1665795894E-2f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.6666665459E-1f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(5.0000001201E-1f));
+    p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+    return _mm512_scalef_ps(p, n);
+}
+
+/** Fast vector exp(x) through the KERNEL_EXP2 polynomial */
+static inline __m512 _kernel_avx512_expFast(__m512 x) {
+    __m512 t = _mm512_mul_ps(x, _mm512_set1_ps(1.44269504088896341f));
+    t = _mm512_min_ps(_mm512_max_ps(t, _mm512_set1_ps(-126.0f)), _mm512_set1_ps(126.0f));
+    __m512 n = _mm512_roundscale_ps(t, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512 f = _mm512_sub_ps(t, n);
+    __m512 p = _mm512_fmadd_ps(_mm512_set1_ps(KERNEL_EXP2_C3), f, _mm512_set1_ps(KERNEL_EXP2_C2));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(KERNEL_EXP2_C1));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(KERNEL_EXP2_C0));
+    return _mm512_scalef_ps(p, n);
+}
+
+/** Mask selecting the first n (< 16) lanes */
+static inline __mmask16 _kernel_avx512_tail(size_t n) {
+    return (__mmask16)((1u << n) - 1);
+}
+
+static void _kernel_avx512_gemm(size_t kc, float const * a, float const * b, float * c, size_t ldc, size_t mr, size_t nr, float alpha) {
+    /* 6 x 16 register tile, one 16 lane accumulator per row */
+    __m512 c0 = _mm512_setzero_ps(), c1 = _mm512_setzero_ps(), c2 = _mm512_setzero_ps();
+    __m512 c3 = _mm512_setzero_ps(), c4 = _mm512_setzero_ps(), c5 = _mm512_setzero_ps();
+    for(size_t p = 0; p < kc; ++p) {
+	__m512 b0 = _mm512_loadu_ps(b);
+	c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0);
+	c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1);
+	c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2);
+	c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3);
+	c4 = _mm512_fmadd_ps(_mm512_set1_ps(a[4]), b0, c4);
+	c5 = _mm512_fmadd_ps(_mm512_set1_ps(a[5]), b0, c5);
+	a += MATRIX_GEMM_MR;
+	b += MATRIX_GEMM_NR;
+    }
+    __m512 acc [MATRIX_GEMM_MR] = { c0, c1, c2, c3, c4, c5 };
+    __m512 va = _mm512_set1_ps(alpha);
+    __mmask16 mask = (nr == MATRIX_GEMM_NR ? (__mmask16)0xffff : _kernel_avx512_tail(nr));
+    for(size_t i = 0; i < mr; ++i) {
+	float * row = c + i * ldc;
+	_mm512_mask_storeu_ps(row, mask, _mm512_fmadd_ps(va, acc[i], _mm512_maskz_loadu_ps(mask, row)));
+    }
+}
+
+static float _kernel_avx512_dot(size_t n, float const * x, float const * y) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps(), s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64) {
+	s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s0);
+	s1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16), s1);
+	s2 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 32), _mm512_loadu_ps(y + i + 32), s2);
+	s3 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 48), _mm512_loadu_ps(y + i + 48), s3);
+    }
+    for(; i + 16 <= n; i += 16)
+	s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s0);
+    if(i < n) {
+	__mmask16 mask = _kernel_avx512_tail(n - i);
+	s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i), s1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+}
+
+static void _kernel_avx512_axpy(size_t n, float a, float const * x, float * y) {
+    __m512 va = _mm512_set1_ps(a);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+	_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    if(i < n) {
+	__mmask16 mask = _kernel_avx512_tail(n - i);
+	_mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)));
+    }
+}
+
+static void _kernel_avx512_add(size_t n, float const * x, float * y) {
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+	_mm512_storeu_ps(y + i, _mm512_add_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    if(i < n) {
+	__mmask16 mask = _kernel_avx512_tail(n - i);
+	_mm512_mask_storeu_ps(y + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)));
+    }
+}
+
+static void _kernel_avx512_scale(size_t n, float a, float * x) {
+    __m512 va = _mm512_set1_ps(a);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+	_mm512_storeu_ps(x + i, _mm512_mul_ps(va, _mm512_loadu_ps(x + i)));
+    if(i < n) {
+	__mmask16 mask = _kernel_avx512_tail(n - i);
+	_mm512_mask_storeu_ps(x + i, mask, _mm512_mul_ps(va, _mm512_maskz_loadu_ps(mask, x + i)));
+    }
+}
+
+static void _kernel_avx512_mul(size_t n, float const * x, float * y) {
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+	_mm512_storeu_ps(y + i, _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    if(i < n) {
+	__mmask16 mask = _kernel_avx512_tail(n - i);
+	_mm512_mask_storeu_ps(y + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)));
+    }
+}
+
+static void _kernel_avx512_momentum(size_t n, float const * c, float * v, float * p, kernel_optim_t const * k) {
+    float a = (k->nesterov ? k->rate : 0), b = (k->nesterov ? k->rate * k->momentum : k->rate);
+    __m512 va = _mm512_set1_ps(a), vb = _mm512_set1_ps(b), scale = _mm512_set1_ps(k->scale), decay = _mm512_set1_ps(k->decay), mu = _mm512_set1_ps(k->momentum);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	__m512 pi = _mm512_loadu_ps(p + i);
+	__m512 g = _mm512_fnmadd_ps(decay, pi, _mm512_mul_ps(scale, _mm512_loadu_ps(c + i)));
+	__m512 vi = _mm512_fmadd_ps(mu, _mm512_loadu_ps(v + i), g);
+	_mm512_storeu_ps(v + i, vi);
+	_mm512_storeu_ps(p + i, _mm512_fmadd_ps(vb, vi, _mm512_fmadd_ps(va, g, pi)));
+    }
+    kernel_scalar.momentum(n - i, c + i, v + i, p + i, k);
+}
+
+static void _kernel_avx512_adam(size_t n, float const * c, float * m, float * v, float * p, kernel_optim_t const * k) {
+    __m512 scale = _mm512_set1_ps(k->scale), decay = _mm512_set1_ps(k->decay), b1 = _mm512_set1_ps(k->beta1), b2 = _mm512_set1_ps(k->beta2);
+    __m512 nb1 = _mm512_set1_ps(1 - k->beta1), nb2 = _mm512_set1_ps(1 - k->beta2), c2 = _mm512_set1_ps(k->correction2), eps = _mm512_set1_ps(k->epsilon);
+    __m512 shrink = _mm512_set1_ps(k->shrink), step = _mm512_set1_ps(k->rate * k->correction1);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	__m512 pi = _mm512_loadu_ps(p + i);
+	__m512 g = _mm512_fnmadd_ps(decay, pi, _mm512_mul_ps(scale, _mm512_loadu_ps(c + i)));
+	__m512 mi = _mm512_fmadd_ps(b1, _mm512_loadu_ps(m + i), _mm512_mul_ps(nb1, g));
+	__m512 vi = _mm512_fmadd_ps(b2, _mm512_loadu_ps(v + i), _mm512_mul_ps(nb2, _mm512_mul_ps(g, g)));
+	_mm512_storeu_ps(m + i, mi);
+	_mm512_storeu_ps(v + i, vi);
+	__m512 denom = _mm512_add_ps(_mm512_sqrt_ps(_mm512_mul_ps(c2, vi)), eps);
+	_mm512_storeu_ps(p + i, _mm512_fmadd_ps(shrink, pi, _mm512_div_ps(_mm512_mul_ps(step, mi), denom)));
+    }
+    kernel_scalar.adam(n - i, c + i, m + i, v + i, p + i, k);
+}
+
+static void _kernel_avx512_relu(size_t n, float * x) {
+    __m512 leak = _mm512_set1_ps(RELU_LEAK);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	__m512 v = _mm512_loadu_ps(x + i);
+	_mm512_storeu_ps(x + i, _mm512_max_ps(v, _mm512_mul_ps(leak, v)));
+    }
+    if(i < n) {
+	__mmask16 mask = _kernel_avx512_tail(n - i);
+	__m512 v = _mm512_maskz_loadu_ps(mask, x + i);
+	_mm512_mask_storeu_ps(x + i, mask, _mm512_max_ps(v, _mm512_mul_ps(leak, v)));
+    }
+}
+
+static void _kernel_avx512_logistic(size_t n, float * x) {
+    __m512 one = _mm512_set1_ps(1.0f);
+    for(size_t i = 0; i < n; i += 16) {
+	__mmask16 mask = (n - i >= 16 ? (__mmask16)0xffff : _kernel_avx512_tail(n - i));
+	__m512 e = _kernel_avx512_exp(_mm512_sub_ps(_mm512_setzero_ps(), _mm512_maskz_loadu_ps(mask, x + i)));
+	_mm512_mask_storeu_ps(x + i, mask, _mm512_div_ps(one, _mm512_add_ps(one, e)));
+    }
+}
+
+static void _kernel_avx512_logisticFast(size_t n, float * x) {
+    __m512 one = _mm512_set1_ps(1.0f), two = _mm512_set1_ps(2.0f);
+    for(size_t i = 0; i < n; i += 16) {
+	__mmask16 mask = (n - i >= 16 ? (__mmask16)0xffff : _kernel_avx512_tail(n - i));
+	__m512 d = _mm512_add_ps(one, _kernel_avx512_expFast(_mm512_sub_ps(_mm512_setzero_ps(), _mm512_maskz_loadu_ps(mask, x + i))));
+	__m512 r = _mm512_rcp14_ps(d);
+	_mm512_mask_storeu_ps(x + i, mask, _mm512_mul_ps(r, _mm512_fnmadd_ps(d, r, two)));
+    }
+}
+
+static void _kernel_avx512_logisticGrad(size_t n, float * y) {
+    for(size_t i = 0; i < n; i += 16) {
+	__mmask16 mask = (n - i >= 16 ? (__mmask16)0xffff : _kernel_avx512_tail(n - i));
+	__m512 v = _mm512_maskz_loadu_ps(mask, y + i);
+	_mm512_mask_storeu_ps(y + i, mask, _mm512_fnmadd_ps(v, v, v));
+    }
+}
+
+static void _kernel_avx512_reluGrad(size_t n, float * y) {
+    __m512 one = _mm512_set1_ps(1.0f), leak = _mm512_set1_ps(RELU_LEAK);
+    for(size_t i = 0; i < n; i += 16) {
+	__mmask16 mask = (n - i >= 16 ? (__mmask16)0xffff : _kernel_avx512_tail(n - i));
+	__mmask16 positive = _mm512_cmp_ps_mask(_mm512_maskz_loadu_ps(mask, y + i), _mm512_setzero_ps(), _CMP_GT_OQ);
+	_mm512_mask_storeu_ps(y + i, mask, _mm512_mask_blend_ps(positive, leak, one));
+    }
+}
+
+/* AVX-512F has no 16-bit multiply-add on 512-bit registers (that needs AVX-512BW), the integer dot products use AVX2 */
+static int32_t _kernel_avx512_dotI8(size_t n, int8_t const * x, int8_t const * y) {
+    __m256i s = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	__m256i vx = _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(x + i)));
+	__m256i vy = _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i const *)(y + i)));
+	s = _mm256_add_epi32(s, _mm256_madd_epi16(vx, vy));
+    }
+    __m128i h = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0x4e));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0xb1));
+    return _mm_cvtsi128_si32(h) + kernel_scalar.dotI8(n - i, x + i, y + i);
+}
+
+static int64_t _kernel_avx512_dotI16(size_t n, int16_t const * x, int16_t const * y) {
+    __m256i s = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	/* Pairwise 32-bit sums, sign-extended to 64 bits before accumulating */
+	__m256i p = _mm256_madd_epi16(_mm256_loadu_si256((__m256i const *)(x + i)), _mm256_loadu_si256((__m256i const *)(y + i)));
+	s = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(p)));
+	s = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(p, 1)));
+    }
+    __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    h = _mm_add_epi64(h, _mm_unpackhi_epi64(h, h));
+    return _mm_cvtsi128_si64(h) + kernel_scalar.dotI16(n - i, x + i, y + i);
+}
+
+/** Widens 16 bf16 values, each becoming the upper half of a float lane */
+static inline __m512 _kernel_avx512_loadBF16(uint16_t const * x) {
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256((__m256i const *)(x))), 16));
+}
+
+/* Masked 16-bit loads need AVX-512BW, so the half precision tails are scalar */
+static float _kernel_avx512_dotF16(size_t n, uint16_t const * x, float const * y) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+	s0 = _mm512_fmadd_ps(_mm512_cvtph_ps(_mm256_loadu_si256((__m256i const *)(x + i))), _mm512_loadu_ps(y + i), s0);
+	s1 = _mm512_fmadd_ps(_mm512_cvtph_ps(_mm256_loadu_si256((__m256i const *)(x + i + 16))), _mm512_loadu_ps(y + i + 16), s1);
+    }
+    for(; i + 16 <= n; i += 16)
+	s0 = _mm512_fmadd_ps(_mm512_cvtph_ps(_mm256_loadu_si256((__m256i const *)(x + i))), _mm512_loadu_ps(y + i), s0);
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1)) + kernel_scalar.dotF16(n - i, x + i, y + i);
+}
+
+static float _kernel_avx512_dotBF16(size_t n, uint16_t const * x, float const * y) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+	s0 = _mm512_fmadd_ps(_kernel_avx512_loadBF16(x + i), _mm512_loadu_ps(y + i), s0);
+	s1 = _mm512_fmadd_ps(_kernel_avx512_loadBF16(x + i + 16), _mm512_loadu_ps(y + i + 16), s1);
+    }
+    for(; i + 16 <= n; i += 16)
+	s0 = _mm512_fmadd_ps(_kernel_avx512_loadBF16(x + i), _mm512_loadu_ps(y + i), s0);
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1)) + kernel_scalar.dotBF16(n - i, x + i, y + i);
+}
+
+static void _kernel_avx512_widenF16(size_t n, uint16_t const * x, float * y) {
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+	_mm512_storeu_ps(y + i, _mm512_cvtph_ps(_mm256_loadu_si256((__m256i const *)(x + i))));
+    kernel_scalar.widenF16(n - i, x + i, y + i);
+}
+
+static void _kernel_avx512_widenBF16(size_t n, uint16_t const * x, float * y) {
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+	_mm512_storeu_ps(y + i, _kernel_avx512_loadBF16(x + i));
+    kernel_scalar.widenBF16(n - i, x + i, y + i);
+}
+
+/** Low and high halves of the 32 x 32 bit products of the lanes of x with m */
+static inline void _kernel_avx512_mulhilo(__m512i x, __m512i m, __m512i * lo, __m512i * hi) {
+    __m512i even = _mm512_mul_epu32(x, m), odd = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), m);
+    *lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+    *hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+}
+
+/* Sixteen blocks at a time, one per lane, transposed back into block order on the way out */
+static void _kernel_avx512_philox(size_t blocks, uint64_t key, uint64_t counter, uint64_t stream, uint32_t * out) {
+    __m512i const m0 = _mm512_set1_epi32((int)(KERNEL_PHILOX_M0)), m1 = _mm512_set1_epi32((int)(KERNEL_PHILOX_M1));
+    size_t b = 0;
+    for(; b + 16 <= blocks; b += 16) {
+	uint32_t lo [16], hi [16];
+	for(int l = 0; l < 16; ++l) {
+	    lo[l] = (uint32_t)(counter + b + l);
+	    hi[l] = (uint32_t)((counter + b + l) >> 32);
+	}
+	__m512i x0 = _mm512_loadu_si512(lo), x1 = _mm512_loadu_si512(hi);
+	__m512i x2 = _mm512_set1_epi32((int)(uint32_t)(stream)), x3 = _mm512_set1_epi32((int)(uint32_t)(stream >> 32));
+	uint32_t k0 = (uint32_t)(key), k1 = (uint32_t)(key >> 32);
+	for(int r = 0; r < KERNEL_PHILOX_ROUNDS; ++r) {
+	    __m512i lo0, hi0, lo1, hi1;
+	    _kernel_avx512_mulhilo(x0, m0, &lo0, &hi0);
+	    _kernel_avx512_mulhilo(x2, m1, &lo1, &hi1);
+	    x0 = _mm512_xor_si512(_mm512_xor_si512(hi1, x1), _mm512_set1_epi32((int)(k0)));
+	    x2 = _mm512_xor_si512(_mm512_xor_si512(hi0, x3), _mm512_set1_epi32((int)(k1)));
+	    x1 = lo1;
+	    x3 = lo0;
+	    k0 += KERNEL_PHILOX_W0;
+	    k1 += KERNEL_PHILOX_W1;
+	}
+	/* The 128 bit lane j of u0..u3 holds the blocks 4j..4j+3, one each */
+	__m512i t0 = _mm512_unpacklo_epi32(x0, x1), t1 = _mm512_unpackhi_epi32(x0, x1);
+	__m512i t2 = _mm512_unpacklo_epi32(x2, x3), t3 = _mm512_unpackhi_epi32(x2, x3);
+	__m512i u [4] = { _mm512_unpacklo_epi64(t0, t2), _mm512_unpackhi_epi64(t0, t2), _mm512_unpacklo_epi64(t1, t3), _mm512_unpackhi_epi64(t1, t3) };
+	for(int i = 0; i < 4; ++i) {
+	    _mm_storeu_si128((__m128i *)(out + 4 * (b + i)), _mm512_extracti32x4_epi32(u[i], 0));
+	    _mm_storeu_si128((__m128i *)(out + 4 * (b + 4 + i)), _mm512_extracti32x4_epi32(u[i], 1));
+	    _mm_storeu_si128((__m128i *)(out + 4 * (b + 8 + i)), _mm512_extracti32x4_epi32(u[i], 2));
+	    _mm_storeu_si128((__m128i *)(out + 4 * (b + 12 + i)), _mm512_extracti32x4_epi32(u[i], 3));
+	}
+    }
+    kernel_scalar.philox(blocks - b, key, counter + b, stream, out + 4 * b);
+}
+
+kernel_t const kernel_avx512 = {
+    .isa = KERNEL_ISA_AVX512,
+    .name = "avx512",
+    .gemm = _kernel_avx512_gemm,
+    .dot = _kernel_avx512_dot,
+    .axpy = _kernel_avx512_axpy,
+    .add = _kernel_avx512_add,
+    .scale = _kernel_avx512_scale,
+    .mul = _kernel_avx512_mul,
+    .momentum = _kernel_avx512_momentum,
+    .adam = _kernel_avx512_adam,
+    .relu = _kernel_avx512_relu,
+    .logistic = _kernel_avx512_logistic,
+    .logisticFast = _kernel_avx512_logisticFast,
+    .logisticGrad = _kernel_avx512_logisticGrad,
+    .reluGrad = _kernel_avx512_reluGrad,
+    .dotI8 = _kernel_avx512_dotI8,
+    .dotI16 = _kernel_avx512_dotI16,
+    .dotF16 = _kernel_avx512_dotF16,
+    .dotBF16 = _kernel_avx512_dotBF16,
+    .widenF16 = _kernel_avx512_widenF16,
+    .widenBF16 = _kernel_avx512_widenBF16,
+    .philox = _kernel_avx512_philox
+};
+
+#endif /* KERNEL_SIMD */
@@ -0,0 +1,368 @@
+#include "kernel.h"
+
+#if KERNEL_SIMD
+#pragma GCC target("sse2")
+#include <emmintrin.h>
+
+#include "activation.h"
+
+/** Horizontal sum of the 4 lanes of a vector */
+static inline float _kernel_sse2_hsum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+    return _mm_cvtss_f32(v);
+}
+
+/** Vector exp(x), same approximation as the AVX2 version, with floor done through truncation */
+static inline __m128 _kernel_sse2_exp(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.0f)), _mm_set1_ps(88.0f));
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+    __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, fx), _mm_set1_ps(1.0f)));
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+    __m128 p = _mm_set1_ps(1.9875691500E-4f);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.3981999507E-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(8.3334519073E-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(4.1665795894E-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.6666665459E-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(5.0000001201E-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, _mm_mul_ps(r, r)), _mm_add_ps(r, _mm_set1_ps(1.0f)));
+    __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(e));
+}
+
+/** Fast vector exp(x) through the KERNEL_EXP2 polynomial */
+static inline __m128 _kernel_sse2_expFast(__m128 x) {
+    __m128 t = _mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f));
+    t = _mm_min_ps(_mm_max_ps(t, _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+    __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, t), _mm_set1_ps(1.0f)));
+    __m128 f = _mm_sub_ps(t, n);
+    __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(KERNEL_EXP2_C3), f), _mm_set1_ps(KERNEL_EXP2_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(KERNEL_EXP2_C1));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(KERNEL_EXP2_C0));
+    __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(e));
+}
+
+static void _kernel_sse2_gemm(size_t kc, float const * a, float const * b, float * c, size_t ldc, size_t mr, size_t nr, float alpha) {
+    /* 16 registers can't hold a 6 x 16 tile, so it is computed as two 6 x 8 halves over the same A panel */
+    float tile [MATRIX_GEMM_MR][MATRIX_GEMM_NR];
+    for(size_t half = 0; half < 2; ++half) {
+	float const * ap = a, * bp = b + half * 8;
+	__m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+	__m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+	__m128 c40 = _mm_setzero_ps(), c41 = _mm_setzero_ps(), c50 = _mm_setzero_ps(), c51 = _mm_setzero_ps();
+	for(size_t p = 0; p < kc; ++p) {
+	    __m128 b0 = _mm_loadu_ps(bp), b1 = _mm_loadu_ps(bp + 4), av;
+	    av = _mm_set1_ps(ap[0]);
+	    c00 = _mm_add_ps(c00, _mm_mul_ps(av, b0));
+	    c01 = _mm_add_ps(c01, _mm_mul_ps(av, b1));
+	    av = _mm_set1_ps(ap[1]);
+	    c10 = _mm_add_ps(c10, _mm_mul_ps(av, b0));
+	    c11 = _mm_add_ps(c11, _mm_mul_ps(av, b1));
+	    av = _mm_set1_ps(ap[2]);
+	    c20 = _mm_add_ps(c20, _mm_mul_ps(av, b0));
+	    c21 = _mm_add_ps(c21, _mm_mul_ps(av, b1));
+	    av = _mm_set1_ps(ap[3]);
+	    c30 = _mm_add_ps(c30, _mm_mul_ps(av, b0));
+	    c31 = _mm_add_ps(c31, _mm_mul_ps(av, b1));
+	    av = _mm_set1_ps(ap[4]);
+	    c40 = _mm_add_ps(c40, _mm_mul_ps(av, b0));
+	    c41 = _mm_add_ps(c41, _mm_mul_ps(av, b1));
+	    av = _mm_set1_ps(ap[5]);
+	    c50 = _mm_add_ps(c50, _mm_mul_ps(av, b0));
+	    c51 = _mm_add_ps(c51, _mm_mul_ps(av, b1));
+	    ap += MATRIX_GEMM_MR;
+	    bp += MATRIX_GEMM_NR;
+	}
+	float * t = &tile[0][half * 8];
+	_mm_storeu_ps(t, c00);
+	_mm_storeu_ps(t + 4, c01);
+	_mm_storeu_ps(t + MATRIX_GEMM_NR, c10);
+	_mm_storeu_ps(t + MATRIX_GEMM_NR + 4, c11);
+	_mm_storeu_ps(t + 2 * MATRIX_GEMM_NR, c20);
+	_mm_storeu_ps(t + 2 * MATRIX_GEMM_NR + 4, c21);
+	_mm_storeu_ps(t + 3 * MATRIX_GEMM_NR, c30);
+	_mm_storeu_ps(t + 3 * MATRIX_GEMM_NR + 4, c31);
+	_mm_storeu_ps(t + 4 * MATRIX_GEMM_NR, c40);
+	_mm_storeu_ps(t + 4 * MATRIX_GEMM_NR + 4, c41);
+	_mm_storeu_ps(t + 5 * MATRIX_GEMM_NR, c50);
+	_mm_storeu_ps(t + 5 * MATRIX_GEMM_NR + 4, c51);
+    }
+    for(size_t i = 0; i < mr; ++i) {
+	for(size_t j = 0; j < nr; ++j)
+	    c[i * ldc + j] += alpha * tile[i][j];
+    }
+}
+
+static float _kernel_sse2_dot(size_t n, float const * x, float const * y) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+	s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+	s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(x + i + 8), _mm_loadu_ps(y + i + 8)));
+	s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(x + i + 12), _mm_loadu_ps(y + i + 12)));
+    }
+    for(; i + 4 <= n; i += 4)
+	s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    float dot = _kernel_sse2_hsum(_mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+    for(; i < n; ++i)
+	dot += x[i] * y[i];
+    return dot;
+}
+
+static void _kernel_sse2_axpy(size_t n, float a, float const * x, float * y) {
+    __m128 va = _mm_set1_ps(a);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+	_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    for(; i < n; ++i)
+	y[i] += a * x[i];
+}
+
+static void _kernel_sse2_add(size_t n, float const * x, float * y) {
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+	_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    for(; i < n; ++i)
+	y[i] += x[i];
+}
+
+static void _kernel_sse2_scale(size_t n, float a, float * x) {
+    __m128 va = _mm_set1_ps(a);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+	_mm_storeu_ps(x + i, _mm_mul_ps(va, _mm_loadu_ps(x + i)));
+    for(; i < n; ++i)
+	x[i] *= a;
+}
+
+static void _kernel_sse2_mul(size_t n, float const * x, float * y) {
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+	_mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    for(; i < n; ++i)
+	y[i] *= x[i];
+}
+
+static void _kernel_sse2_momentum(size_t n, float const * c, float * v, float * p, kernel_optim_t const * k) {
+    float a = (k->nesterov ? k->rate : 0), b = (k->nesterov ? k->rate * k->momentum : k->rate);
+    __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b), scale = _mm_set1_ps(k->scale), decay = _mm_set1_ps(k->decay), mu = _mm_set1_ps(k->momentum);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+	__m128 pi = _mm_loadu_ps(p + i);
+	__m128 g = _mm_sub_ps(_mm_mul_ps(scale, _mm_loadu_ps(c + i)), _mm_mul_ps(decay, pi));
+	__m128 vi = _mm_add_ps(_mm_mul_ps(mu, _mm_loadu_ps(v + i)), g);
+	_mm_storeu_ps(v + i, vi);
+	_mm_storeu_ps(p + i, _mm_add_ps(_mm_mul_ps(vb, vi), _mm_add_ps(_mm_mul_ps(va, g), pi)));
+    }
+    kernel_scalar.momentum(n - i, c + i, v + i, p + i, k);
+}
+
+static void _kernel_sse2_adam(size_t n, float const * c, float * m, float * v, float * p, kernel_optim_t const * k) {
+    __m128 scale = _mm_set1_ps(k->scale), decay = _mm_set1_ps(k->decay), b1 = _mm_set1_ps(k->beta1), b2 = _mm_set1_ps(k->beta2);
+    __m128 nb1 = _mm_set1_ps(1 - k->beta1), nb2 = _mm_set1_ps(1 - k->beta2), c2 = _mm_set1_ps(k->correction2), eps = _mm_set1_ps(k->epsilon);
+    __m128 shrink = _mm_set1_ps(k->shrink), step = _mm_set1_ps(k->rate * k->correction1);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+	__m128 pi = _mm_loadu_ps(p + i);
+	__m128 g = _mm_sub_ps(_mm_mul_ps(scale, _mm_loadu_ps(c + i)), _mm_mul_ps(decay, pi));
+	__m128 mi = _mm_add_ps(_mm_mul_ps(b1, _mm_loadu_ps(m + i)), _mm_mul_ps(nb1, g));
+	__m128 vi = _mm_add_ps(_mm_mul_ps(b2, _mm_loadu_ps(v + i)), _mm_mul_ps(nb2, _mm_mul_ps(g, g)));
+	_mm_storeu_ps(m + i, mi);
+	_mm_storeu_ps(v + i, vi);
+	__m128 denom = _mm_add_ps(_mm_sqrt_ps(_mm_mul_ps(c2, vi)), eps);
+	_mm_storeu_ps(p + i, _mm_add_ps(_mm_mul_ps(shrink, pi), _mm_div_ps(_mm_mul_ps(step, mi), denom)));
+    }
+    kernel_scalar.adam(n - i, c + i, m + i, v + i, p + i, k);
+}
+
+static void _kernel_sse2_relu(size_t n, float * x) {
+    __m128 leak = _mm_set1_ps(RELU_LEAK);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+	__m128 v = _mm_loadu_ps(x + i);
+	_mm_storeu_ps(x + i, _mm_max_ps(v, _mm_mul_ps(leak, v)));
+    }
+    kernel_scalar.relu(n - i, x + i);
+}
+
+static void _kernel_sse2_logistic(size_t n, float * x) {
+    __m128 one = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+	__m128 e = _kernel_sse2_exp(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(x + i)));
+	_mm_storeu_ps(x + i, _mm_div_ps(one, _mm_add_ps(one, e)));
+    }
+    kernel_scalar.logistic(n - i, x + i);
+}
+
+static void _kernel_sse2_logisticFast(size_t n, float * x) {
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+	__m128 d = _mm_add_ps(one, _kernel_sse2_expFast(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(x + i))));
+	__m128 r = _mm_rcp_ps(d);
+	_mm_storeu_ps(x + i, _mm_mul_ps(r, _mm_sub_ps(two, _mm_mul_ps(d, r))));
+    }
+    kernel_scalar.logisticFast(n - i, x + i);
+}
+
+static void _kernel_sse2_logisticGrad(size_t n, float * y) {
+    __m128 one = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+	__m128 v = _mm_loadu_ps(y + i);
+	_mm_storeu_ps(y + i, _mm_mul_ps(v, _mm_sub_ps(one, v)));
+    }
+    kernel_scalar.logisticGrad(n - i, y + i);
+}
+
+static void _kernel_sse2_reluGrad(size_t n, float * y) {
+    __m128 one = _mm_set1_ps(1.0f), leak = _mm_set1_ps(RELU_LEAK);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+	__m128 positive = _mm_cmpgt_ps(_mm_loadu_ps(y + i), _mm_setzero_ps());
+	_mm_storeu_ps(y + i, _mm_or_ps(_mm_and_ps(positive, one), _mm_andnot_ps(positive, leak)));
+    }
+    kernel_scalar.reluGrad(n - i, y + i);
+}
+
+/** Sign-extends the low and high 8 bytes of a vector to 16-bit lanes */
+static inline void _kernel_sse2_widenI8(__m128i v, __m128i * lo, __m128i * hi) {
+    *lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+    *hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+}
+
+static int32_t _kernel_sse2_dotI8(size_t n, int8_t const * x, int8_t const * y) {
+    __m128i s = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+	__m128i xlo, xhi, ylo, yhi;
+	_kernel_sse2_widenI8(_mm_loadu_si128((__m128i const *)(x + i)), &xlo, &xhi);
+	_kernel_sse2_widenI8(_mm_loadu_si128((__m128i const *)(y + i)), &ylo, &yhi);
+	s = _mm_add_epi32(s, _mm_add_epi32(_mm_madd_epi16(xlo, ylo), _mm_madd_epi16(xhi, yhi)));
+    }
+    int32_t lanes [4];
+    _mm_storeu_si128((__m128i *)(lanes), s);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + kernel_scalar.dotI8(n - i, x + i, y + i);
+}
+
+static int64_t _kernel_sse2_dotI16(size_t n, int16_t const * x, int16_t const * y) {
+    __m128i s = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	/* Pairwise 32-bit sums, sign-extended to 64 bits before accumulating */
+	__m128i p = _mm_madd_epi16(_mm_loadu_si128((__m128i const *)(x + i)), _mm_loadu_si128((__m128i const *)(y + i)));
+	__m128i sign = _mm_srai_epi32(p, 31);
+	s = _mm_add_epi64(s, _mm_add_epi64(_mm_unpacklo_epi32(p, sign), _mm_unpackhi_epi32(p, sign)));
+    }
+    int64_t lanes [2];
+    _mm_storeu_si128((__m128i *)(lanes), s);
+    return lanes[0] + lanes[1] + kernel_scalar.dotI16(n - i, x + i, y + i);
+}
+
+/* SSE2 has no fp16 conversion instructions, those stay scalar */
+static float _kernel_sse2_dotF16(size_t n, uint16_t const * x, float const * y) {
+    return kernel_scalar.dotF16(n, x, y);
+}
+
+static void _kernel_sse2_widenF16(size_t n, uint16_t const * x, float * y) {
+    kernel_scalar.widenF16(n, x, y);
+}
+
+/** Widens the low and high 4 bf16 values of a vector, each becoming the upper half of a float lane */
+static inline void _kernel_sse2_widenBF16x8(__m128i v, __m128 * lo, __m128 * hi) {
+    *lo = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), v));
+    *hi = _mm_castsi128_ps(_mm_unpackhi_epi16(_mm_setzero_si128(), v));
+}
+
+static float _kernel_sse2_dotBF16(size_t n, uint16_t const * x, float const * y) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m128 lo, hi;
+	_kernel_sse2_widenBF16x8(_mm_loadu_si128((__m128i const *)(x + i)), &lo, &hi);
+	s0 = _mm_add_ps(s0, _mm_mul_ps(lo, _mm_loadu_ps(y + i)));
+	s1 = _mm_add_ps(s1, _mm_mul_ps(hi, _mm_loadu_ps(y + i + 4)));
+    }
+    return _kernel_sse2_hsum(_mm_add_ps(s0, s1)) + kernel_scalar.dotBF16(n - i, x + i, y + i);
+}
+
+static void _kernel_sse2_widenBF16(size_t n, uint16_t const * x, float * y) {
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+	__m128 lo, hi;
+	_kernel_sse2_widenBF16x8(_mm_loadu_si128((__m128i const *)(x + i)), &lo, &hi);
+	_mm_storeu_ps(y + i, lo);
+	_mm_storeu_ps(y + i + 4, hi);
+    }
+    kernel_scalar.widenBF16(n - i, x + i, y + i);
+}
+
+/** Low and high halves of the 32 x 32 bit products of the lanes of x with m */
+static inline void _kernel_sse2_mulhilo(__m128i x, __m128i m, __m128i * lo, __m128i * hi) {
+    __m128i even = _mm_mul_epu32(x, m), odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), m);
+    *lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    *hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 3, 1)));
+}
+
+/* Four blocks at a time, one per lane, transposed back into block order on the way out */
+static void _kernel_sse2_philox(size_t blocks, uint64_t key, uint64_t counter, uint64_t stream, uint32_t * out) {
+    __m128i const m0 = _mm_set1_epi32((int)(KERNEL_PHILOX_M0)), m1 = _mm_set1_epi32((int)(KERNEL_PHILOX_M1));
+    size_t b = 0;
+    for(; b + 4 <= blocks; b += 4) {
+	uint64_t c = counter + b;
+	__m128i x0 = _mm_setr_epi32((int)(uint32_t)(c), (int)(uint32_t)(c + 1), (int)(uint32_t)(c + 2), (int)(uint32_t)(c + 3));
+	__m128i x1 = _mm_setr_epi32((int)(uint32_t)(c >> 32), (int)(uint32_t)((c + 1) >> 32), (int)(uint32_t)((c + 2) >> 32), (int)(uint32_t)((c + 3) >> 32));
+	__m128i x2 = _mm_set1_epi32((int)(uint32_t)(stream)), x3 = _mm_set1_epi32((int)(uint32_t)(stream >> 32));
+	uint32_t k0 = (uint32_t)(key), k1 = (uint32_t)(key >> 32);
+	for(int r = 0; r < KERNEL_PHILOX_ROUNDS; ++r) {
+	    __m128i lo0, hi0, lo1, hi1;
+	    _kernel_sse2_mulhilo(x0, m0, &lo0, &hi0);
+	    _kernel_sse2_mulhilo(x2, m1, &lo1, &hi1);
+	    x0 = _mm_xor_si128(_mm_xor_si128(hi1, x1), _mm_set1_epi32((int)(k0)));
+	    x2 = _mm_xor_si128(_mm_xor_si128(hi0, x3), _mm_set1_epi32((int)(k1)));
+	    x1 = lo1;
+	    x3 = lo0;
+	    k0 += KERNEL_PHILOX_W0;
+	    k1 += KERNEL_PHILOX_W1;
+	}
+	__m128i t0 = _mm_unpacklo_epi32(x0, x1), t1 = _mm_unpackhi_epi32(x0, x1), t2 = _mm_unpacklo_epi32(x2, x3), t3 = _mm_unpackhi_epi32(x2, x3);
+	_mm_storeu_si128((__m128i *)(out + 4 * b), _mm_unpacklo_epi64(t0, t2));
+	_mm_storeu_si128((__m128i *)(out + 4 * b + 4), _mm_unpackhi_epi64(t0, t2));
+	_mm_storeu_si128((__m128i *)(out + 4 * b + 8), _mm_unpacklo_epi64(t1, t3));
+	_mm_storeu_si128((__m128i *)(out + 4 * b + 12), _mm_unpackhi_epi64(t1, t3));
+    }
+    kernel_scalar.philox(blocks - b, key, counter + b, stream, out + 4 * b);
+}
+
+kernel_t const kernel_sse2 = {
+    .isa = KERNEL_ISA_SSE2,
+    .name = "sse2",
+    .gemm = _kernel_sse2_gemm,
+    .dot = _kernel_sse2_dot,
+    .axpy = _kernel_sse2_axpy,
+    .add = _kernel_sse2_add,
+    .scale = _kernel_sse2_scale,
+    .mul = _kernel_sse2_mul,
+    .momentum = _kernel_sse2_momentum,
+    .adam = _kernel_sse2_adam,
+    .relu = _kernel_sse2_relu,
+    .logistic = _kernel_sse2_logistic,
+    .logisticFast = _kernel_sse2_logisticFast,
+    .logisticGrad = _kernel_sse2_logisticGrad,
+    .reluGrad = _kernel_sse2_reluGrad,
+    .dotI8 = _kernel_sse2_dotI8,
+    .dotI16 = _kernel_sse2_dotI16,
+    .dotF16 = _kernel_sse2_dotF16,
+    .dotBF16 = _kernel_sse2_dotBF16,
+    .widenF16 = _kernel_sse2_widenF16,
+    .widenBF16 = _kernel_sse2_widenBF16,
+    .philox = _kernel_sse2_philox
+};
+
+#endif /* KERNEL_SIMD */
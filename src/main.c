@@ -10,15 +10,24 @@
 #include <string.h>
 
 #include "matrix.h"
+#include "kernel.h"
 #include "activation.h"
 #include "network.h"
 #include "set.h"
 #include "util.h"
+#include "serve.h"
+#include "stream.h"
+#include "quant.h"
+#include "prof.h"
 
 #ifndef MAIN_NETWORK_FILENAME
 #define MAIN_NETWORK_FILENAME "active.net"
 #endif /* NETWORK_FILENAME */
 
+#ifndef MAIN_CHECKPOINT_FILENAME
+#define MAIN_CHECKPOINT_FILENAME "active.ckpt"
+#endif /* MAIN_CHECKPOINT_FILENAME */
+
 #ifndef MAIN_HEATMAP_ORIGIN_X
 #define MAIN_HEATMAP_ORIGIN_X -2
 #endif /* MAIN_HEATMAP_ORIGIN_X */
@@ -33,17 +42,50 @@
 #define MAIN_HEATMAP_SIZE_Y 3
 #endif /* MAIN_HEATMAP_SIZE_Y */
 
+#ifndef MAIN_QUANT_FILENAME
+#define MAIN_QUANT_FILENAME "active.qnet"
+#endif /* MAIN_QUANT_FILENAME */
+#ifndef MAIN_QUANT_BENCH_TIME
+#define MAIN_QUANT_BENCH_TIME 0.25
+#endif /* MAIN_QUANT_BENCH_TIME */
+
+#ifndef MAIN_BATCH_SIZE
+#define MAIN_BATCH_SIZE 4096
+#endif /* MAIN_BATCH_SIZE */
+
+#ifndef MAIN_SERVE_SOCKET
+#define MAIN_SERVE_SOCKET "func.sock"
+#endif /* MAIN_SERVE_SOCKET */
+#ifndef MAIN_SERVE_BATCH
+#define MAIN_SERVE_BATCH 256
+#endif /* MAIN_SERVE_BATCH */
+#ifndef MAIN_SERVE_DELAY
+#define MAIN_SERVE_DELAY 0
+#endif /* MAIN_SERVE_DELAY */
+
 #ifndef MAIN_HEATMAP_STEP
 #define MAIN_HEATMAP_STEP 0.1f
 #endif /* MAIN_HEATMAP_STEP */
 
 void main_printHelp(char * programName);
 
+char const * main_dtypeName(network_dtype_t dtype);
+
 short main_loadNet(network_t * net, char const * networkFile);
 
-void main_train(char const * pointsFile, char const * configFile);
+util_err_t main_loadSet(set_t * set, char const * pointsFile, size_t inputs, size_t outputs);
+
+void main_train(char const * pointsFile, char const * configFile, char const * traceFile, int resume);
+
+void main_convert(char const * pointsFile, char const * setFile, size_t inputs, size_t outputs);
+
+void main_point(MATRIX_TYPE const * inputs, size_t count);
+
+void main_batch(char const * inFile, char const * outFile, size_t batchSize, char const * networkFile);
 
-void main_point(MATRIX_TYPE x, MATRIX_TYPE y);
+void main_quantize(char const * pointsFile, quant_bits_t bits);
+
+void main_serve(char const * socketFile, size_t maxBatch, long maxDelay);
 
 void main_heatmap(float originX, float originY, float sizeX, float sizeY, float step);
 
@@ -51,8 +93,8 @@ void main_weights(void);
 
 int main(int argc, char ** argv) {
 
-    /* Initialising random number generator */
-    srand(time(NULL));
+    /* Selecting the compute kernels for this CPU */
+    kernel_init();
 
     /* Checking command line arguments */
     if(argc < 2) {
@@ -66,23 +108,65 @@ int main(int argc, char ** argv) {
 	return 0;
 
     } else if(strcmp(argv[1], "train") == 0) {
-	if(argc < 4) {
+	int resume = (argc > 2 && strcmp(argv[2], "--resume") == 0);
+	if(argc < 4 + resume) {
 	    printf("Error: not enough arguments for 'train' command\nTry '%s help'\n", argv[0]);
 	    return 1;
 	} else {
-	    main_train(argv[2], argv[3]);
+	    main_train(argv[2 + resume], argv[3 + resume], (argc > 4 + resume ? argv[4 + resume] : NULL), resume);
 	}
 	
+    } else if(strcmp(argv[1], "convert") == 0) {
+	if(argc < 6) {
+	    printf("Error: not enough arguments for 'convert' command\nTry '%s help'\n", argv[0]);
+	    return 1;
+	}
+	size_t inputs = 0, outputs = 0;
+	sscanf(argv[4], "%lu", &inputs);
+	sscanf(argv[5], "%lu", &outputs);
+	main_convert(argv[2], argv[3], inputs, outputs);
+
     } else if(strcmp(argv[1], "point") == 0) {
-	if(argc < 4) {
+	if(argc < 3) {
 	    printf("Error: not enough arguments for 'point' command\nTry '%s help'\n", argv[0]);
 	    return 1;
 	} else {
-	    MATRIX_TYPE x = 0, y = 0;
-	    sscanf(argv[2], MATRIX_TYPE_SCANF, &x);
-	    sscanf(argv[3], MATRIX_TYPE_SCANF, &y);
-	    main_point(x, y);
+	    MATRIX_TYPE inputs [argc - 2];
+	    for(int i = 2; i < argc; ++i) {
+		inputs[i - 2] = 0;
+		sscanf(argv[i], MATRIX_TYPE_SCANF, (inputs + i - 2));
+	    }
+	    main_point(inputs, argc - 2);
+	}
+
+    } else if(strcmp(argv[1], "batch") == 0) {
+	size_t batchSize = MAIN_BATCH_SIZE;
+	if(argc > 4)
+	    sscanf(argv[4], "%lu", &batchSize);
+	main_batch((argc > 2 ? argv[2] : "-"), (argc > 3 ? argv[3] : "-"), batchSize, (argc > 5 ? argv[5] : MAIN_NETWORK_FILENAME));
+
+    } else if(strcmp(argv[1], "quantize") == 0) {
+	if(argc < 3) {
+	    printf("Error: not enough arguments for 'quantize' command\nTry '%s help'\n", argv[0]);
+	    return 1;
 	}
+	int bits = QUANT_INT8;
+	if(argc > 3)
+	    sscanf(argv[3], "%d", &bits);
+	if(bits != QUANT_INT8 && bits != QUANT_INT16) {
+	    printf("Error: quantization to %d bits is not supported, only 8 or 16\n", bits);
+	    return 1;
+	}
+	main_quantize(argv[2], (quant_bits_t)(bits));
+
+    } else if(strcmp(argv[1], "serve") == 0) {
+	size_t maxBatch = MAIN_SERVE_BATCH;
+	if(argc > 3)
+	    sscanf(argv[3], "%lu", &maxBatch);
+	long maxDelay = MAIN_SERVE_DELAY;
+	if(argc > 4)
+	    sscanf(argv[4], "%ld", &maxDelay);
+	main_serve((argc > 2 ? argv[2] : MAIN_SERVE_SOCKET), maxBatch, maxDelay);
 
     } else if(strcmp(argv[1], "heatmap") == 0) {
 	float originX = MAIN_HEATMAP_ORIGIN_X;
@@ -116,12 +200,39 @@ int main(int argc, char ** argv) {
 void main_printHelp(char * programName) {
     printf("Usage: '%s <command> <options>'\n", programName);
     puts("available <command>s and their <options>:\n"
-	 "  - train <points> <config> ............ train neural network with given points and config files\n"
-	 "  - point <x> <y> ...................... run inference and provide an output value for a given point (x,y)\n"
+	 "  - train [--resume] <points>\n"
+	 "          <config> [trace] ............. train neural network with given points (text or dataset file) and config files,\n"
+	 "                                         builds with profiling (make profile=true) print a summary of every epoch and write\n"
+	 "                                         a Chrome trace-event file (chrome://tracing, ui.perfetto.dev) to trace if given,\n"
+	 "                                         checkpoints (checkpoint_every) go to '" MAIN_CHECKPOINT_FILENAME "', --resume continues from it\n"
+	 "  - convert <points> <dataset>\n"
+	 "            <inputs> <outputs> ......... convert a text points file with the given numbers of input and output columns\n"
+	 "                                         to a binary dataset file, which train and quantize map straight into memory\n"
+	 "  - point <x> [y ...] .................. run inference and provide the output values for a given point (one value per network input)\n"
+	 "  - batch [input] [output]\n"
+	 "          [batch_size] [network] ....... run inference on every x,y line of input (default or '-' stdin) and write x,y,result lines\n"
+	 "                                         to output (default or '-' stdout), evaluating batch_size points at a time on all CPUs,\n"
+	 "                                         with the given network file (default '" MAIN_NETWORK_FILENAME "', quantized files are detected)\n"
+	 "  - quantize <points> [bits] ........... quantize the current network to 8 (default) or 16 bit integers, calibrated on the\n"
+	 "                                         points (text or dataset file), save it as '" MAIN_QUANT_FILENAME "' and report its accuracy and speed\n"
+	 "  - serve [socket] [max_batch]\n"
+	 "          [max_delay_us] ............... serve inference on a Unix socket (default '" MAIN_SERVE_SOCKET "') until interrupted,\n"
+	 "                                         coalescing requests into batches of up to max_batch points, waiting up to\n"
+	 "                                         max_delay_us for more requests (0 for lowest latency, more for throughput)\n"
 	 "  - heatmap [origin_x] [origin_y]\n"
 	 "            [size_x] [size_y] [step] ... run inference (optionally specify a custom area of size (size_x,size_y) from origin) and display heatmap\n"
-	 "  - weights ............................ dump the weights of the current network"
-	 "  - --help | -h | help ................. display this help menu");
+	 "  - weights ............................ dump the weights of every layer of the current network\n"
+	 "  - --help | -h | help ................. display this help menu\n"
+	 "environment:\n"
+	 "  - " KERNEL_ENV_OVERRIDE "=scalar|sse2|avx2|avx512 ... limit the compute kernels to the given instruction set");
+}
+
+char const * main_dtypeName(network_dtype_t dtype) {
+    switch(dtype) {
+	case NETWORK_DTYPE_F16: return "fp16";
+	case NETWORK_DTYPE_BF16: return "bf16";
+	default: return (sizeof(MATRIX_TYPE) == sizeof(double) ? "fp64" : "fp32");
+    }
 }
 
 short main_loadNet(network_t * net, char const * networkFile) {
@@ -132,61 +243,269 @@ short main_loadNet(network_t * net, char const * networkFile) {
     return 1;
 }
 
-void main_train(char const * pointsFile, char const * configFile) {
+util_err_t main_loadSet(set_t * set, char const * pointsFile, size_t inputs, size_t outputs) {
+    /* Binary dataset files are mapped, anything else is parsed as text points */
+    util_err_t res = util_loadSet(set, pointsFile);
+    if(res == UTIL_ERR_FORMAT)
+	return util_loadPoints(set, pointsFile, inputs, outputs);
+    if(res == UTIL_OK && (set->inSize != inputs || set->outSize != outputs)) {
+	printf("Error: Dataset '%s' has %lu input(s) and %lu output(s), the network %lu and %lu\n", pointsFile, set->inSize, set->outSize, inputs, outputs);
+	set_destroy(set);
+	return UTIL_ERR_PARAM;
+    }
+    return res;
+}
+
+void main_train(char const * pointsFile, char const * configFile, char const * traceFile, int resume) {
     /* Load config file */
     util_config_t conf = {0};
-    if(util_loadConfig(&conf, configFile) != UTIL_OK) {
+    util_err_t confRes = util_loadConfig(&conf, configFile);
+    if(confRes == UTIL_ERR_FORMAT) {
+	printf("Error: Config doesn't describe a valid network\nCheck the 'layers' and 'activations' in file '%s'?\n", configFile);
+	return;
+    } else if(confRes != UTIL_OK) {
 	printf("Error: Config coould not be loaded\nCheck if file '%s' exists?\n", configFile);
 	return;
     }
 
-    /* Load points file */
-    set_t set = {0};
-    if(util_loadPoints(&set, pointsFile) != UTIL_OK) {
-	printf("Error: Training points coould not be loaded\nCheck if file '%s' exists?\n", pointsFile);
+    /* The configured seed, or one picked from the clock, a resumed run shuffling from the seed of the checkpointed one and
+     * continuing with the pass after the checkpoint */
+    checkpoint_header_t checkpoint = { .progress.seed = conf.seed };
+    if(resume && checkpoint_readHeader(MAIN_CHECKPOINT_FILENAME, &checkpoint) != CHECKPOINT_OK) {
+	printf("Error: Checkpoint could not be loaded\nCheck if file '%s' exists?\n", MAIN_CHECKPOINT_FILENAME);
 	return;
     }
+    uint64_t seed = checkpoint.progress.seed;
+    if(seed == 0) {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	seed = (uint64_t)(now.tv_sec) * 1000000000u + (uint64_t)(now.tv_nsec);
+    }
+    printf("Seed %lu\n", (unsigned long)(seed));
+
+    /* Load points file, or open it for streaming in chunks, with as many inputs and outputs as the configured network */
+    set_t set = {0};
+    stream_t stream, evalStream;
+    set_source_t source = {0}, evalSource = {0};
+    int streaming = (conf.streamChunk > 0);
+    if(streaming) {
+	stream_options_t streamOptions = { .chunkSize = conf.streamChunk, .shuffle = conf.shuffle, .seed = seed,
+					   .pass = (size_t)(checkpoint.progress.iterations) };
+	stream_err_t streamRes = stream_open(&stream, pointsFile, conf.inSize, conf.layers[conf.depth - 1], &streamOptions);
+	/* Losses are evaluated over a stream of their own, so that the training stream's passes stay those of the iterations */
+	stream_options_t evalOptions = { .chunkSize = conf.streamChunk, .quiet = 1 };
+	if(streamRes == STREAM_OK) {
+	    streamRes = stream_open(&evalStream, pointsFile, conf.inSize, conf.layers[conf.depth - 1], &evalOptions);
+	    if(streamRes != STREAM_OK)
+		stream_close(&stream);
+	}
+	if(streamRes != STREAM_OK) {
+	    printf("Error: Training points could not be streamed (error %d)\nCheck if file '%s' exists and matches the network?\n", streamRes, pointsFile);
+	    return;
+	}
+	source = stream_source(&stream);
+	evalSource = stream_source(&evalStream);
+    } else {
+	util_err_t setRes = main_loadSet(&set, pointsFile, conf.inSize, conf.layers[conf.depth - 1]);
+	if(setRes != UTIL_OK) {
+	    if(setRes != UTIL_ERR_PARAM)
+		printf("Error: Training points coould not be loaded\nCheck if file '%s' exists?\n", pointsFile);
+	    return;
+	}
+    }
+
+    /* Holding the last points out of training, as a view into the end of the set */
+    set_t validation = {0};
+    if(conf.validationSplit > 0 && streaming) {
+	puts("Warning: validation_split is ignored when streaming");
+    } else if(conf.validationSplit > 0) {
+	size_t held = (size_t)(set.size * conf.validationSplit);
+	held = (held < 1 ? 1 : (held >= set.size ? set.size - 1 : held));
+	if(held > 0) {
+	    validation = (set_t){ .in = set.in + (set.size - held) * set.inSize, .out = set.out + (set.size - held) * set.outSize,
+				  .size = held, .inSize = set.inSize, .outSize = set.outSize };
+	    set.size -= held;
+	}
+    }
 
     /* Initialize network */
     network_t net = {0};
-    size_t layers [2] = { conf.hiddenSize, 1 };
-    activation_t activations [2] = { activation_get(conf.hiddenActivation), activation_get(conf.outputActivation) };
-    network_init(&net, 3, 2, layers, activations);
-    /* Set weights configs and initialize weights */
-    network_weightRandMin = conf.weightRandMin;
-    network_weightRandMax = conf.weightRandMax;
-    network_weightRandDiv = conf.weightRandDiv;
-    network_initWeights(&net);
+    size_t * layers = conf.layers;
+    activation_t activations [conf.depth];
+    for(size_t i = 0; i < conf.depth; ++i)
+	activations[i] = activation_get(conf.activations[i]);
+    if(network_init(&net, conf.inSize, conf.depth, layers, activations) != NETWORK_OK) {
+	puts("Error: Network could not be initialized");
+	set_destroy(&set);
+	if(streaming) {
+	    stream_close(&stream);
+	    stream_close(&evalStream);
+	}
+	network_destroy(&net);
+	return;
+    }
+    /* Initialize weights from the seed */
+    MATRIX_TYPE low = conf.weightRandMin / conf.weightRandDiv, high = conf.weightRandMax / conf.weightRandDiv;
+    if(network_initWeights(&net, conf.weightInit, low, high, seed) != NETWORK_OK) {
+	printf("Error: Weight initialization %d is not supported\n", conf.weightInit);
+	set_destroy(&set);
+	if(streaming) {
+	    stream_close(&stream);
+	    stream_close(&evalStream);
+	}
+	network_destroy(&net);
+	return;
+    }
+    if(network_setDtype(&net, conf.weightDtype) != NETWORK_OK) {
+	printf("Error: Weight storage type %d is not supported\n", conf.weightDtype);
+	set_destroy(&set);
+	if(streaming) {
+	    stream_close(&stream);
+	    stream_close(&evalStream);
+	}
+	network_destroy(&net);
+	return;
+    }
 
     /* Run training */
-    set_train(&set, &net, layers, conf.learningRate, conf.itCount);
+    set_result_t result = {0};
+    set_options_t options = { .mode = conf.trainMode, .learnRate = conf.learningRate, .optimizer = conf.optimizer, .iterations = conf.itCount, .batchSize = conf.batchSize, .threads = conf.threads,
+			      .evalEvery = conf.evalEvery, .evalSamples = conf.evalSamples, .validation = (validation.size > 0 ? &validation : NULL),
+			      .lossTarget = conf.lossTarget, .patience = conf.patience, .minDelta = conf.minDelta, .timeBudget = conf.timeBudget,
+			      .keepBest = conf.keepBest, .log = stdout, .result = &result,
+			      .checkpoint = (conf.checkpointEvery > 0 ? MAIN_CHECKPOINT_FILENAME : NULL), .checkpointEvery = conf.checkpointEvery,
+			      .resume = (resume ? MAIN_CHECKPOINT_FILENAME : NULL), .seed = seed,
+			      .evalSource = (streaming ? &evalSource : NULL) };
+
+    /* Resuming starts from the checkpointed weights, checked against the configured network and optimizer before training loads all of it */
+    if(resume) {
+	optim_t optim = {0};
+	checkpoint_progress_t progress;
+	int loaded = (optim_init(&optim, &net, &conf.optimizer, conf.learningRate) == OPTIM_OK
+		      && checkpoint_load(MAIN_CHECKPOINT_FILENAME, &net, &optim, NULL, &progress) == CHECKPOINT_OK);
+	optim_destroy(&optim);
+	if(!loaded) {
+	    printf("Error: Checkpoint '%s' doesn't match the configured network and optimizer\n", MAIN_CHECKPOINT_FILENAME);
+	    set_destroy(&set);
+	    if(streaming) {
+		stream_close(&stream);
+		stream_close(&evalStream);
+	    }
+	    network_destroy(&net);
+	    return;
+	}
+	printf("Resuming after %lu of %lu iteration(s)\n", (size_t)(progress.iterations), conf.itCount);
+    }
+    MATRIX_TYPE startLoss = 0, endLoss = 0;
+    if(streaming && set_loss_source(&evalSource, &net, &startLoss) != SET_OK) {
+	/* The first pass over the points is the one finding out whether there are any */
+	printf("Error: Training points could not be streamed (error %d)\nCheck if file '%s' exists and matches the network?\n", stream_error(&evalStream), pointsFile);
+	stream_close(&stream);
+	stream_close(&evalStream);
+	network_destroy(&net);
+	return;
+    } else if(!streaming) {
+	set_loss(&set, &net, &startLoss);
+    }
+#ifdef PROF_ENABLE
+    prof_start(traceFile);
+#else
+    if(traceFile)
+	printf("Warning: built without profiling (make profile=true), no trace written to '%s'\n", traceFile);
+#endif /* PROF_ENABLE */
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    set_err_t trainRes = (streaming ? set_train_source(&source, &net, layers, &options) : set_train(&set, &net, layers, &options));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef PROF_ENABLE
+    if(prof_stop() != PROF_OK && traceFile)
+	printf("Error: Trace could not be written\nCheck if file '%s' is writable?\n", traceFile);
+#endif /* PROF_ENABLE */
+    if(streaming)
+	set_loss_source(&evalSource, &net, &endLoss);
+    else
+	set_loss(&set, &net, &endLoss);
+
+    /* Report convergence against throughput (a stream knows its size after the first pass) */
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    double samples = (double)(streaming ? stream_size(&stream) : set.size) * (result.iterations - result.resumed);
+    if(trainRes != SET_OK)
+	printf("Error: Training failed (error %d)\n", trainRes);
+    if(result.stop == SET_STOP_TARGET)
+	printf("Stopped after %lu of %lu iteration(s): loss target %g reached\n", result.iterations, conf.itCount, conf.lossTarget);
+    else if(result.stop == SET_STOP_PATIENCE)
+	printf("Stopped after %lu of %lu iteration(s): no improvement in %lu evaluation(s)\n", result.iterations, conf.itCount, conf.patience);
+    else if(result.stop == SET_STOP_TIME)
+	printf("Stopped after %lu of %lu iteration(s): time budget of %g s used up\n", result.iterations, conf.itCount, conf.timeBudget);
+    if(conf.keepBest && result.evaluations > 0 && result.bestIteration != result.iterations)
+	printf("Kept the weights of iteration %lu (evaluated loss %g)\n", result.bestIteration, result.bestLoss);
+    if(options.checkpoint)
+	printf("Wrote %lu checkpoint(s) to '%s'\n", result.checkpoints, MAIN_CHECKPOINT_FILENAME);
+    printf("Training (%s%s, %lu thread(s), %s weights): %.0f samples in %.3f s (%.0f samples/s), loss %g -> %g\n",
+	    (conf.trainMode == SET_MODE_ASYNC ? "asynchronous" : "synchronous"), (streaming ? ", streamed" : ""), (conf.threads > 1 ? conf.threads : 1),
+	    main_dtypeName(net.dtype), samples, seconds, (seconds > 0 ? samples / seconds : 0), startLoss, endLoss);
 
     /* Save network */
-    util_saveNetwork(&net, MAIN_NETWORK_FILENAME);
+    if(util_saveNetwork(&net, MAIN_NETWORK_FILENAME) != UTIL_OK)
+	printf("Error: Network could not be saved\nCheck if file '%s' is writable?\n", MAIN_NETWORK_FILENAME);
 
     /* Dispose of any allocated/initialised resources */
     set_destroy(&set);
+    if(streaming) {
+	stream_close(&stream);
+	stream_close(&evalStream);
+    }
     network_destroy(&net);
 }
 
-void main_point(MATRIX_TYPE x, MATRIX_TYPE y) {
+void main_convert(char const * pointsFile, char const * setFile, size_t inputs, size_t outputs) {
+    /* Parse the text points once */
+    if(inputs == 0 || outputs == 0) {
+	puts("Error: The numbers of inputs and outputs have to be positive");
+	return;
+    }
+    set_t set = {0};
+    if(util_loadPoints(&set, pointsFile, inputs, outputs) != UTIL_OK) {
+	printf("Error: Points could not be loaded\nCheck if file '%s' exists?\n", pointsFile);
+	return;
+    }
+
+    /* Write them out as the packed blocks */
+    if(util_saveSet(&set, setFile) != UTIL_OK)
+	printf("Error: Dataset could not be saved\nCheck if file '%s' is writable?\n", setFile);
+    else
+	printf("Converted %lu point(s) of %lu input(s) and %lu output(s) from '%s' to '%s'\n", set.size, inputs, outputs, pointsFile, setFile);
+
+    set_destroy(&set);
+}
+
+void main_point(MATRIX_TYPE const * inputs, size_t count) {
     /* Load network */
     network_t net = {0};
-    main_loadNet(&net, MAIN_NETWORK_FILENAME);
+    if(!main_loadNet(&net, MAIN_NETWORK_FILENAME))
+	return;
+    if(count != net.inSize) {
+	printf("Error: The network takes %lu input(s), got %lu\n", net.inSize, count);
+	network_destroy(&net);
+	return;
+    }
 
     /* Set up and run inference */
     matrix_t in = {0}, out = {0};
-    matrix_init(&in, 3, 1);
-    matrix_init(&out, 1, 1);
-    matrix_set(&in, 0, 0, x);
-    matrix_set(&in, 1, 0, y);
-    matrix_set(&in, 2, 0, 1.0f);
+    matrix_init(&in, net.inSize, 1);
+    matrix_init(&out, net.outSize, 1);
+    for(size_t i = 0; i < count; ++i)
+	matrix_set(&in, i, 0, inputs[i]);
     network_inference(&net, &in, &out);
 
     /* Print result */
-    MATRIX_TYPE outVal = 0;
-    matrix_get(&out, 0, 0, &outVal);
-    printf("Inference result: (" MATRIX_TYPE_PRINTF ", " MATRIX_TYPE_PRINTF ") -> (" MATRIX_TYPE_PRINTF ")\n", x, y, outVal);
+    fputs("Inference result: (", stdout);
+    for(size_t i = 0; i < count; ++i)
+	printf((i + 1 < count ? MATRIX_TYPE_PRINTF ", " : MATRIX_TYPE_PRINTF), inputs[i]);
+    fputs(") -> (", stdout);
+    for(size_t i = 0; i < net.outSize; ++i)
+	printf((i + 1 < net.outSize ? MATRIX_TYPE_PRINTF ", " : MATRIX_TYPE_PRINTF), out.data[i]);
+    puts(")");
 
     /* Dispose of any allocated resources */
     matrix_destroy(&in);
@@ -194,14 +513,135 @@ void main_point(MATRIX_TYPE x, MATRIX_TYPE y) {
     network_destroy(&net);
 }
 
+void main_batch(char const * inFile, char const * outFile, size_t batchSize, char const * networkFile) {
+    /* Load network, quantized or not */
+    network_t net = {0};
+    quant_network_t qnet = {0};
+    int quantized = (quant_load(&qnet, networkFile) == QUANT_OK);
+    if(!quantized && !main_loadNet(&net, networkFile))
+	return;
+    util_infer_t infer = {0};
+    util_err_t res = (quantized ? util_infer_initQuant(&infer, &qnet, batchSize, pool_cpuCount()) : util_infer_init(&infer, &net, batchSize, pool_cpuCount()));
+
+    /* Open input and output, '-' meaning the standard streams */
+    FILE * in = (strcmp(inFile, "-") == 0 ? stdin : fopen(inFile, "r"));
+    FILE * out = (strcmp(outFile, "-") == 0 ? stdout : fopen(outFile, "w"));
+    if(!in)
+	printf("Error: Input could not be opened\nCheck if file '%s' exists?\n", inFile);
+    else if(!out)
+	printf("Error: Output could not be opened\nCheck if file '%s' is writable?\n", outFile);
+    else if(res != UTIL_OK || util_batch(&infer, in, out) != UTIL_OK)
+	fputs("Error: Batch inference failed\n", stderr);
+
+    /* Dispose of any allocated resources */
+    if(in && in != stdin)
+	fclose(in);
+    if(out && out != stdout)
+	fclose(out);
+    util_infer_destroy(&infer);
+    quant_destroy(&qnet);
+    network_destroy(&net);
+}
+
+/** Returns the seconds the given engine takes for 'total' points, going over the given points as often as needed */
+static double main_inferTime(util_infer_t * infer, MATRIX_TYPE const * points, MATRIX_TYPE * results, size_t count, size_t total) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(size_t done = 0; done < total; ) {
+	size_t n = (total - done < count ? total - done : count);
+	util_infer_run(infer, points, results, n);
+	done += n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+/** Returns the points per second of single-threaded inference of the given engine over the given points, doubling the points timed
+ * (which warms up as well) until that takes MAIN_QUANT_BENCH_TIME seconds, so that the time spent doesn't depend on the network size */
+static double main_inferRate(util_infer_t * infer, MATRIX_TYPE const * points, MATRIX_TYPE * results, size_t count) {
+    size_t total = 1;
+    double seconds = main_inferTime(infer, points, results, count, total);
+    while(seconds < MAIN_QUANT_BENCH_TIME) {
+	total *= 2;
+	seconds = main_inferTime(infer, points, results, count, total);
+    }
+    return (seconds > 0 ? total / seconds : 0);
+}
+
+void main_quantize(char const * pointsFile, quant_bits_t bits) {
+    /* Load network and calibration points */
+    network_t net = {0};
+    if(!main_loadNet(&net, MAIN_NETWORK_FILENAME))
+	return;
+    set_t set = {0};
+    util_err_t setRes = main_loadSet(&set, pointsFile, net.inSize, net.outSize);
+    if(setRes != UTIL_OK) {
+	if(setRes != UTIL_ERR_PARAM)
+	    printf("Error: Calibration points could not be loaded\nCheck if file '%s' exists?\n", pointsFile);
+	network_destroy(&net);
+	return;
+    }
+
+    /* Quantize, save and compare */
+    quant_network_t qnet = {0};
+    quant_report_t report = {0};
+    if(quant_calibrate(&qnet, &net, &set, bits) != QUANT_OK || quant_compare(&qnet, &net, &set, &report) != QUANT_OK) {
+	puts("Error: Quantization failed");
+    } else if(quant_save(&qnet, MAIN_QUANT_FILENAME) != QUANT_OK) {
+	printf("Error: Quantized network could not be saved\nCheck if file '%s' is writable?\n", MAIN_QUANT_FILENAME);
+    } else {
+	printf("Quantized '%s' to int%d as '%s', weights %lu -> %lu bytes (%.2fx smaller)\n", MAIN_NETWORK_FILENAME, bits, MAIN_QUANT_FILENAME,
+	       report.floatBytes, report.quantBytes, (double)(report.floatBytes) / report.quantBytes);
+	printf("Accuracy against the float network on %lu outputs: max error %g, mean error %g, RMS error %g\n",
+	       report.count, report.maxErr, report.meanErr, report.rmsErr);
+
+	/* Single-threaded throughput of both over the calibration points, which the set already stores consecutively */
+	MATRIX_TYPE * results = (MATRIX_TYPE *)(malloc(set.size * net.outSize * sizeof(MATRIX_TYPE)));
+	util_infer_t floatInfer = {0}, quantInfer = {0};
+	if(results && util_infer_init(&floatInfer, &net, set.size, 1) == UTIL_OK && util_infer_initQuant(&quantInfer, &qnet, set.size, 1) == UTIL_OK) {
+	    double floatRate = main_inferRate(&floatInfer, set.in, results, set.size);
+	    double quantRate = main_inferRate(&quantInfer, set.in, results, set.size);
+	    printf("Throughput (1 thread, %s kernels): float %.0f points/s, int%d %.0f points/s\n", kernel.name, floatRate, bits, quantRate);
+	}
+	util_infer_destroy(&floatInfer);
+	util_infer_destroy(&quantInfer);
+	free(results);
+    }
+
+    /* Dispose of any allocated resources */
+    quant_destroy(&qnet);
+    set_destroy(&set);
+    network_destroy(&net);
+}
+
+void main_serve(char const * socketFile, size_t maxBatch, long maxDelay) {
+    /* Load network */
+    network_t net = {0};
+    if(!main_loadNet(&net, MAIN_NETWORK_FILENAME))
+	return;
+
+    /* Serve until interrupted */
+    serve_options_t options = { .path = socketFile, .maxBatch = maxBatch, .maxDelay = maxDelay, .threads = pool_cpuCount() };
+    printf("Serving '%s' on '%s'\n", MAIN_NETWORK_FILENAME, socketFile);
+    fflush(stdout);
+    serve_err_t res = serve_run(&net, &options);
+    if(res != SERVE_OK)
+	printf("Error: Serving failed (error %d)\nCheck that nothing but a socket is at '%s' and that it can be created?\n", res, socketFile);
+
+    /* Dispose of any allocated resources */
+    network_destroy(&net);
+}
+
 void main_heatmap(float originX, float originY, float sizeX, float sizeY, float step) {
     /* Load network */
     network_t net = {0};
-    main_loadNet(&net, MAIN_NETWORK_FILENAME);
+    if(!main_loadNet(&net, MAIN_NETWORK_FILENAME))
+	return;
 
     /* Generate heatmap */
     char charset [7] = {'.', ',', '-', ';', '!', 'I', 'H'};
-    util_heatmap(&net, originX, originY, sizeX, sizeY, step, charset, 7);
+    if(util_heatmap(&net, originX, originY, sizeX, sizeY, step, charset, 7, pool_cpuCount()) != UTIL_OK)
+	printf("Error: Heatmap could not be generated\nThe network needs 2 inputs (it has %lu)\n", net.inSize);
 
     /* Dispose of any allocated resources */
     network_destroy(&net);
@@ -210,13 +650,23 @@ void main_heatmap(float originX, float originY, float sizeX, float sizeY, float
 void main_weights(void) {
     /* Load network */
     network_t net = {0};
-    main_loadNet(&net, MAIN_NETWORK_FILENAME);
+    if(!main_loadNet(&net, MAIN_NETWORK_FILENAME))
+	return;
 
-    /* Dump weights */
-    puts("Hidden layer weights:");
-    matrix_print(net.weights);
-    puts("\nOutput layer weights:");
-    matrix_print(net.weights + 1);
+    /* Dump weights, widened if stored at reduced precision */
+    if(network_initMaster(&net) != NETWORK_OK) {
+	puts("Error: Weights could not be widened");
+	network_destroy(&net);
+	return;
+    }
+    printf("Weights stored as %s, %lu input(s)\n", main_dtypeName(net.dtype), net.inSize);
+    for(size_t i = 0; i < net.depth; ++i) {
+	printf("\n%s layer %lu weights (%lu x %lu, activation %d):\n", (i + 1 < net.depth ? "Hidden" : "Output"), i,
+	       net.weights[i].rows, net.weights[i].cols, net.activations[i].type);
+	matrix_print(net.weights + i);
+	printf("%s layer %lu biases:\n", (i + 1 < net.depth ? "Hidden" : "Output"), i);
+	matrix_print(net.biases + i);
+    }
 
     /* Dispose of any allocated resources */
     network_destroy(&net);
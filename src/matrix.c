@@ -1,4 +1,5 @@
 #include "matrix.h"
+#include "kernel.h"
 
 matrix_err_t _matrix_flatIdx(size_t row, size_t col, size_t rows, size_t cols, size_t * idx) {
     matrix_err_t result = MATRIX_ERR_INDEX;
@@ -71,34 +72,228 @@ matrix_err_t matrix_copy(matrix_t * m1, matrix_t * m2) {
     return result;
 }
 
+matrix_err_t matrix_add(matrix_t * m1, matrix_t * m2) {
+    if(m1->cols != m2->cols || m1->rows != m2->rows || m1->dataLen != m2->dataLen)
+	return MATRIX_ERR_MISMATCH;
+    kernel.add(m1->dataLen, m1->data, m2->data);
+    return MATRIX_OK;
+}
+
+matrix_err_t matrix_scale(matrix_t * m, MATRIX_TYPE a) {
+    if(!m)
+	return MATRIX_ERR;
+    kernel.scale(m->dataLen, a, m->data);
+    return MATRIX_OK;
+}
+
+matrix_err_t matrix_axpy(MATRIX_TYPE a, matrix_t * m1, matrix_t * m2) {
+    if(m1->cols != m2->cols || m1->rows != m2->rows || m1->dataLen != m2->dataLen)
+	return MATRIX_ERR_MISMATCH;
+    kernel.axpy(m1->dataLen, a, m1->data, m2->data);
+    return MATRIX_OK;
+}
+
 matrix_err_t matrix_matmul(matrix_t * m1, matrix_t * m2, matrix_t * result) {
     /* Check appropriate dimensions */
     if(!(m1->cols == m2->rows && result->rows == m1->rows && result->cols == m2->cols)) {
 	return MATRIX_ERR_MISMATCH;
     }
-    /* Do the multiplication */
-    for(size_t row = 0; row < m1->rows; ++row) {
-	for(size_t col = 0; col < m2->cols; ++col) {
-	    /* Dot product of corresponding row and column of m1 and m2 */
-	    MATRIX_TYPE resVal = 0;
-	    /* Here, m1->cols is guaranteed to be equal to m2->rows, so we can index both the m1 column and m2 row */
-	    for(size_t idx = 0; idx < m1->cols; ++idx) {
-		MATRIX_TYPE val1;
-		matrix_get(m1, row, idx, &val1);
-		MATRIX_TYPE val2;
-		matrix_get(m2, idx, col, &val2);
-		resVal += val1 * val2;
+    /* Do the multiplication (column vectors take the matrix-vector path inside matrix_gemm) */
+    matrix_gemm(MATRIX_NOTRANS, MATRIX_NOTRANS, m1->rows, m2->cols, m1->cols,
+		1, m1->data, m1->cols, m2->data, m2->cols, 0, result->data, result->cols);
+    return MATRIX_OK;
+}
+
+/* Per-thread packing buffers for matrix_gemm, grown on demand and reused between calls */
+static __thread MATRIX_TYPE * _matrix_packABuf = NULL;
+static __thread size_t _matrix_packALen = 0;
+static __thread MATRIX_TYPE * _matrix_packBBuf = NULL;
+static __thread size_t _matrix_packBLen = 0;
+
+/** Returns a 64-byte aligned packing buffer of at least the given length, reallocating it if too small */
+static MATRIX_TYPE * _matrix_packBuffer(MATRIX_TYPE ** buf, size_t * len, size_t need) {
+    if(*len < need) {
+	void * mem = NULL;
+	free(*buf);
+	*buf = NULL;
+	*len = 0;
+	if(posix_memalign(&mem, 64, need * sizeof(MATRIX_TYPE)) != 0)
+	    return NULL;
+	*buf = (MATRIX_TYPE *)mem;
+	*len = need;
+    }
+    return *buf;
+}
+
+void matrix_gemmRelease(void) {
+    free(_matrix_packABuf);
+    _matrix_packABuf = NULL;
+    _matrix_packALen = 0;
+    free(_matrix_packBBuf);
+    _matrix_packBBuf = NULL;
+    _matrix_packBLen = 0;
+}
+
+/** Scales an MxN block of C by beta (beta == 0 clears it, so C may hold uninitialised values) */
+static void _matrix_scale(size_t M, size_t N, MATRIX_TYPE beta, MATRIX_TYPE * C, size_t ldc) {
+    if(beta == 1)
+	return;
+    for(size_t i = 0; i < M; ++i) {
+	MATRIX_TYPE * c = C + i * ldc;
+	if(beta == 0) {
+	    for(size_t j = 0; j < N; ++j)
+		c[j] = 0;
+	} else {
+	    kernel.scale(N, beta, c);
+	}
+    }
+}
+
+/** Unblocked product for small shapes, where packing would cost more than it saves */
+static void _matrix_gemmDirect(matrix_trans_t transA, matrix_trans_t transB, size_t M, size_t N, size_t K,
+			       MATRIX_TYPE alpha, MATRIX_TYPE const * A, size_t lda, MATRIX_TYPE const * B, size_t ldb,
+			       MATRIX_TYPE * C, size_t ldc) {
+    for(size_t i = 0; i < M; ++i) {
+	MATRIX_TYPE * c = C + i * ldc;
+	if(!transB) {
+	    /* Row of C as a sum of scaled rows of B */
+	    for(size_t p = 0; p < K; ++p)
+		kernel.axpy(N, alpha * (transA ? A[p * lda + i] : A[i * lda + p]), B + p * ldb, c);
+	} else if(!transA) {
+	    /* Both operands read along contiguous rows, every element of C is a dot product */
+	    for(size_t j = 0; j < N; ++j)
+		c[j] += alpha * kernel.dot(K, A + i * lda, B + j * ldb);
+	} else {
+	    for(size_t j = 0; j < N; ++j) {
+		MATRIX_TYPE dot = 0;
+		for(size_t p = 0; p < K; ++p)
+		    dot += A[p * lda + i] * B[j * ldb + p];
+		c[j] += alpha * dot;
 	    }
-	    matrix_set(result, row, col, resVal);
 	}
     }
-    return MATRIX_OK;
+}
+
+/** Packs an mc x kc block of op(A) into MR-row panels stored column by column, zero-padding the last panel */
+static void _matrix_packA(matrix_trans_t transA, size_t mc, size_t kc, MATRIX_TYPE const * A, size_t lda, MATRIX_TYPE * pack) {
+    for(size_t i0 = 0; i0 < mc; i0 += MATRIX_GEMM_MR) {
+	size_t mr = (mc - i0 < MATRIX_GEMM_MR ? mc - i0 : MATRIX_GEMM_MR);
+	for(size_t p = 0; p < kc; ++p) {
+	    for(size_t i = 0; i < MATRIX_GEMM_MR; ++i) {
+		if(i < mr)
+		    *pack++ = (transA ? A[p * lda + i0 + i] : A[(i0 + i) * lda + p]);
+		else
+		    *pack++ = 0;
+	    }
+	}
+    }
+}
+
+/** Packs a kc x nc block of op(B) into NR-column panels stored row by row, zero-padding the last panel */
+static void _matrix_packB(matrix_trans_t transB, size_t kc, size_t nc, MATRIX_TYPE const * B, size_t ldb, MATRIX_TYPE * pack) {
+    for(size_t j0 = 0; j0 < nc; j0 += MATRIX_GEMM_NR) {
+	size_t nr = (nc - j0 < MATRIX_GEMM_NR ? nc - j0 : MATRIX_GEMM_NR);
+	for(size_t p = 0; p < kc; ++p) {
+	    if(!transB && nr == MATRIX_GEMM_NR) {
+		MATRIX_TYPE const * b = B + p * ldb + j0;
+		for(size_t j = 0; j < MATRIX_GEMM_NR; ++j)
+		    *pack++ = b[j];
+		continue;
+	    }
+	    for(size_t j = 0; j < MATRIX_GEMM_NR; ++j) {
+		if(j < nr)
+		    *pack++ = (transB ? B[(j0 + j) * ldb + p] : B[p * ldb + j0 + j]);
+		else
+		    *pack++ = 0;
+	    }
+	}
+    }
+}
+
+void matrix_gemm(matrix_trans_t transA, matrix_trans_t transB, size_t M, size_t N, size_t K,
+		 MATRIX_TYPE alpha, MATRIX_TYPE const * A, size_t lda, MATRIX_TYPE const * B, size_t ldb,
+		 MATRIX_TYPE beta, MATRIX_TYPE * C, size_t ldc) {
+    if(M == 0 || N == 0)
+	return;
+
+    /* Column vector results (the per-sample inference case) and row vector results are matrix-vector products */
+    if(N == 1 && (transB || ldb == 1) && (ldc == 1 || M == 1)) {
+	if(transA)
+	    matrix_gemv(MATRIX_TRANS, K, M, alpha, A, lda, B, beta, C);
+	else
+	    matrix_gemv(MATRIX_NOTRANS, M, K, alpha, A, lda, B, beta, C);
+	return;
+    }
+    if(M == 1 && (!transA || lda == 1)) {
+	if(transB)
+	    matrix_gemv(MATRIX_NOTRANS, N, K, alpha, B, ldb, A, beta, C);
+	else
+	    matrix_gemv(MATRIX_TRANS, K, N, alpha, B, ldb, A, beta, C);
+	return;
+    }
+
+    _matrix_scale(M, N, beta, C, ldc);
+    if(K == 0 || alpha == 0)
+	return;
+
+    /* Falling back to the direct loop for small products or if the packing buffers can't be allocated */
+    MATRIX_TYPE * packA = NULL, * packB = NULL;
+    if(M * N * K >= MATRIX_GEMM_SMALL) {
+	packA = _matrix_packBuffer(&_matrix_packABuf, &_matrix_packALen, MATRIX_GEMM_MC * MATRIX_GEMM_KC);
+	packB = _matrix_packBuffer(&_matrix_packBBuf, &_matrix_packBLen,
+				   MATRIX_GEMM_KC * (MATRIX_GEMM_NC + MATRIX_GEMM_NR));
+    }
+    if(!packA || !packB) {
+	_matrix_gemmDirect(transA, transB, M, N, K, alpha, A, lda, B, ldb, C, ldc);
+	return;
+    }
+
+    /* Blocked product: B blocks are packed once per (jc, pc) and reused by every A block */
+    for(size_t jc = 0; jc < N; jc += MATRIX_GEMM_NC) {
+	size_t nc = (N - jc < MATRIX_GEMM_NC ? N - jc : MATRIX_GEMM_NC);
+	for(size_t pc = 0; pc < K; pc += MATRIX_GEMM_KC) {
+	    size_t kc = (K - pc < MATRIX_GEMM_KC ? K - pc : MATRIX_GEMM_KC);
+	    _matrix_packB(transB, kc, nc, (transB ? B + jc * ldb + pc : B + pc * ldb + jc), ldb, packB);
+
+	    for(size_t ic = 0; ic < M; ic += MATRIX_GEMM_MC) {
+		size_t mc = (M - ic < MATRIX_GEMM_MC ? M - ic : MATRIX_GEMM_MC);
+		_matrix_packA(transA, mc, kc, (transA ? A + pc * lda + ic : A + ic * lda + pc), lda, packA);
+
+		/* Sweeping the register tiles of the current block */
+		for(size_t jr = 0; jr < nc; jr += MATRIX_GEMM_NR) {
+		    size_t nr = (nc - jr < MATRIX_GEMM_NR ? nc - jr : MATRIX_GEMM_NR);
+		    for(size_t ir = 0; ir < mc; ir += MATRIX_GEMM_MR) {
+			size_t mr = (mc - ir < MATRIX_GEMM_MR ? mc - ir : MATRIX_GEMM_MR);
+			kernel.gemm(kc, packA + ir * kc, packB + jr * kc,
+				    C + (ic + ir) * ldc + jc + jr, ldc, mr, nr, alpha);
+		    }
+		}
+	    }
+	}
+    }
+}
+
+void matrix_gemv(matrix_trans_t transA, size_t M, size_t N, MATRIX_TYPE alpha, MATRIX_TYPE const * A, size_t lda,
+		 MATRIX_TYPE const * x, MATRIX_TYPE beta, MATRIX_TYPE * y) {
+    if(!transA) {
+	/* y = alpha * A * x, one dot product per row */
+	for(size_t i = 0; i < M; ++i)
+	    y[i] = alpha * kernel.dot(N, A + i * lda, x) + (beta == 0 ? 0 : beta * y[i]);
+    } else {
+	/* y = alpha * A^T * x, accumulated as one axpy per row of A so that A is still read row by row */
+	_matrix_scale(1, N, beta, y, N);
+	for(size_t i = 0; i < M; ++i) {
+	    MATRIX_TYPE s = alpha * x[i];
+	    if(s != 0)
+		kernel.axpy(N, s, A + i * lda, y);
+	}
+    }
 }
 
 matrix_err_t matrix_print(matrix_t * m) {
     for(size_t row = 0; row < m->rows; ++row) {
 	for(size_t col = 0; col < m->cols; ++col) {
-	    MATRIX_TYPE val;
+	    MATRIX_TYPE val = 0;
 	    matrix_get(m, row, col, &val);
 	    printf(MATRIX_TYPE_PRINTF "\t", val);
 	}
@@ -11,6 +11,8 @@
 
 #ifndef MATRIX_TYPE
 #define MATRIX_TYPE float
+/* Marks the single precision default, which the SIMD kernels in kernel.h are written for */
+#define MATRIX_TYPE_FLOAT
 #endif /* MATRIX_TYPE */
 
 #ifndef MATRIX_TYPE_PRINTF
@@ -21,6 +23,30 @@
 #define MATRIX_TYPE_SCANF "%f"
 #endif /* MATRIX_TYPE_SCANF */
 
+/* GEMM register tile: rows (MR) and columns (NR) of the result computed by one micro-kernel call */
+#ifndef MATRIX_GEMM_MR
+#define MATRIX_GEMM_MR 6
+#endif /* MATRIX_GEMM_MR */
+#ifndef MATRIX_GEMM_NR
+#define MATRIX_GEMM_NR 16
+#endif /* MATRIX_GEMM_NR */
+
+/* GEMM cache blocking: KC*NR panel of B stays in L1, MC*KC block of A in L2, KC*NC block of B in L3 */
+#ifndef MATRIX_GEMM_KC
+#define MATRIX_GEMM_KC 256
+#endif /* MATRIX_GEMM_KC */
+#ifndef MATRIX_GEMM_MC
+#define MATRIX_GEMM_MC 96
+#endif /* MATRIX_GEMM_MC */
+#ifndef MATRIX_GEMM_NC
+#define MATRIX_GEMM_NC 2048
+#endif /* MATRIX_GEMM_NC */
+
+/* Products with fewer multiply-adds than this skip packing and use a direct loop */
+#ifndef MATRIX_GEMM_SMALL
+#define MATRIX_GEMM_SMALL (32 * 32 * 32)
+#endif /* MATRIX_GEMM_SMALL */
+
 /** Structure containing data for a matrix */
 typedef struct {
 
@@ -46,6 +72,14 @@ typedef enum {
     MATRIX_ERR = 4
 } matrix_err_t;
 
+/** Operand transposition for the raw matrix_gemm/matrix_gemv kernels */
+typedef enum {
+    /** Use the operand as stored */
+    MATRIX_NOTRANS = 0,
+    /** Use the transpose of the stored operand */
+    MATRIX_TRANS = 1
+} matrix_trans_t;
+
 
 /** Calculate the flat index of a matrix based on its parameters */
 matrix_err_t _matrix_flatIdx(size_t row, size_t col, size_t rows, size_t cols, size_t * idx);
@@ -71,6 +105,32 @@ matrix_err_t matrix_copy(matrix_t * m1, matrix_t * m2);
 /** Multiply two matrices, save the result into the third (result = m1*m2) - all three matrices must have appropriate dimensions */
 matrix_err_t matrix_matmul(matrix_t * m1, matrix_t * m2, matrix_t * result);
 
+/** Adds m1 to m2 elementwise (m2 += m1) */
+matrix_err_t matrix_add(matrix_t * m1, matrix_t * m2);
+
+/** Multiplies every element of the matrix by the given scalar */
+matrix_err_t matrix_scale(matrix_t * m, MATRIX_TYPE a);
+
+/** Adds a scalar multiple of m1 to m2 elementwise (m2 += a * m1) */
+matrix_err_t matrix_axpy(MATRIX_TYPE a, matrix_t * m1, matrix_t * m2);
+
+/** General matrix multiply on raw row-major buffers, C = alpha * op(A) * op(B) + beta * C
+ * @param M the number of rows of op(A) and C
+ * @param N the number of columns of op(B) and C
+ * @param K the number of columns of op(A) and rows of op(B)
+ * @param lda,ldb,ldc the row strides (in elements) of the stored A, B and C buffers
+ */
+void matrix_gemm(matrix_trans_t transA, matrix_trans_t transB, size_t M, size_t N, size_t K,
+		 MATRIX_TYPE alpha, MATRIX_TYPE const * A, size_t lda, MATRIX_TYPE const * B, size_t ldb,
+		 MATRIX_TYPE beta, MATRIX_TYPE * C, size_t ldc);
+
+/** Matrix-vector product on raw row-major buffers, y = alpha * op(A) * x + beta * y, where A is stored as M rows of N elements with row stride lda */
+void matrix_gemv(matrix_trans_t transA, size_t M, size_t N, MATRIX_TYPE alpha, MATRIX_TYPE const * A, size_t lda,
+		 MATRIX_TYPE const * x, MATRIX_TYPE beta, MATRIX_TYPE * y);
+
+/** Frees the calling thread's GEMM packing buffers (call before a worker thread exits) */
+void matrix_gemmRelease(void);
+
 /** Prints the matrix in a readable way */
 matrix_err_t matrix_print(matrix_t * m);
 
@@ -1,8 +1,7 @@
 #include "network.h"
 
-int32_t network_weightRandMin = -50;
-int32_t network_weightRandMax = 50;
-float network_weightRandDiv = 1000.0f;
+#include "kernel.h"
+#include "prof.h"
 
 network_err_t network_init(network_t * net, size_t inSize, size_t depth, size_t * layers, activation_t * activations) {
     /* Checking validity of properties */
@@ -15,59 +14,186 @@ network_err_t network_init(network_t * net, size_t inSize, size_t depth, size_t
     net->inSize = inSize;
     net->outSize = layers[depth - 1];
     net->depth = depth;
+    net->dtype = NETWORK_DTYPE_NATIVE;
+    net->stored = NULL;
 
-    /* Allocating weights and activations size */
-    net->weights = (matrix_t *)(malloc(net->depth * sizeof(matrix_t)));
+    /* Allocating weights, biases and activations size */
+    net->weights = (matrix_t *)(calloc(net->depth, sizeof(matrix_t)));
+    net->biases = (matrix_t *)(calloc(net->depth, sizeof(matrix_t)));
     net->activations = (activation_t *)(malloc(net->depth * sizeof(activation_t)));
 
     /* Checking weights allocation */
-    if(!net->weights || !net->activations)
+    if(!net->weights || !net->biases || !net->activations)
 	return NETWORK_ERR_ALLOC;
 
-    /* Initialising weights and activations */
+    /* Initialising weights, biases and activations */
     for(size_t i = 0; i < depth; ++i) {
-	/* Zero-initialising the empty matrix */
-	*(net->weights + i) = (matrix_t){0};
-	/* Allocate matrices for the weights */
-	if(matrix_init((net->weights + i), layers[i], (i > 0 ? layers[i-1] : inSize)) != MATRIX_OK)
+	/* Allocate matrices for the weights and the (zeroed) biases */
+	if(matrix_init((net->weights + i), layers[i], (i > 0 ? layers[i-1] : inSize)) != MATRIX_OK
+	   || matrix_init((net->biases + i), layers[i], 1) != MATRIX_OK || !net->biases[i].data)
 	    return NETWORK_ERR_ALLOC;
+	memset(net->biases[i].data, 0, layers[i] * sizeof(MATRIX_TYPE));
 	/* Copy over activation functions */
 	net->activations[i] = activations[i];
     }
     return NETWORK_OK;
 }
 
-network_err_t network_initWeights(network_t * net) {
+network_err_t network_initWeights(network_t * net, network_init_t init, MATRIX_TYPE low, MATRIX_TYPE high, uint64_t seed) {
+    if(!net || init > NETWORK_INIT_HE)
+	return NETWORK_ERR_PARAM;
+    rng_t rng;
+    rng_init(&rng, seed, NETWORK_RNG_STREAM);
     for(size_t idx = 0; idx < net->depth; ++idx) {
-	matrix_populate((net->weights + idx), _network_random);
+	/* Every layer from its own substream, so that its weights don't depend on the sizes of the layers before it */
+	rng_t layerRng = rng_split(&rng, idx);
+	matrix_t * weights = (net->weights + idx);
+	double inputs = weights->cols, outputs = weights->rows;
+	if(init == NETWORK_INIT_XAVIER) {
+	    MATRIX_TYPE limit = (MATRIX_TYPE)(sqrt(6 / (inputs + outputs)));
+	    rng_fillUniform(&layerRng, weights->data, weights->dataLen, -limit, limit);
+	} else if(init == NETWORK_INIT_HE) {
+	    rng_fillNormal(&layerRng, weights->data, weights->dataLen, 0, (MATRIX_TYPE)(sqrt(2 / inputs)));
+	} else {
+	    rng_fillUniform(&layerRng, weights->data, weights->dataLen, low, high);
+	}
     }
     return NETWORK_OK;
 }
 
-MATRIX_TYPE _network_random(size_t idx) {
-    return (((rand() % (network_weightRandMax - network_weightRandMin)) + network_weightRandMin) / network_weightRandDiv);
+/** Returns non-zero if the given weights live in the file mapping of the network */
+static int _network_mapped(network_t const * net, void const * ptr) {
+    return (net->mapping && (char const *)(ptr) >= (char const *)(net->mapping) && (char const *)(ptr) < (char const *)(net->mapping) + net->mappingLen);
+}
+
+/** Frees the reduced precision weight copies (unless they live in the file mapping), going back to the native dtype */
+static void _network_freeStored(network_t * net) {
+    if(net->stored) {
+	for(size_t i = 0; i < net->depth; ++i) {
+	    if(!_network_mapped(net, net->stored[i]))
+		free(net->stored[i]);
+	}
+    }
+    free(net->stored);
+    net->stored = NULL;
+    net->dtype = NETWORK_DTYPE_NATIVE;
 }
 
 network_err_t network_destroy(network_t * net) {
-    /* Destroying associated weights */
-    for(size_t i = 0; i > net->depth; ++i) {
-	matrix_destroy((net->weights + i));
+    if(!net)
+	return NETWORK_ERR_NULL;
+    /* Destroying associated weights, unless they live in a file mapping */
+    for(size_t i = 0; i < net->depth; ++i) {
+	if(net->weights && !_network_mapped(net, net->weights[i].data))
+	    matrix_destroy((net->weights + i));
+	if(net->biases && !_network_mapped(net, net->biases[i].data))
+	    matrix_destroy((net->biases + i));
     }
-    /* Freeing space allocated for weights and activations */
+    _network_freeStored(net);
+    if(net->mapping)
+	munmap(net->mapping, net->mappingLen);
+    /* Freeing space allocated for weights, biases and activations */
     free(net->weights);
+    free(net->biases);
     free(net->activations);
+    *net = (network_t){0};
     return NETWORK_OK;
 }
 
+network_err_t network_setDtype(network_t * net, network_dtype_t dtype) {
+    /* Validating arguments */
+    if(!net)
+	return NETWORK_ERR_NULL;
+    if(dtype != NETWORK_DTYPE_NATIVE && dtype != NETWORK_DTYPE_F16 && dtype != NETWORK_DTYPE_BF16)
+	return NETWORK_ERR_PARAM;
+
+    /* The copies are rounded from the master weights, which have to exist first */
+    network_err_t res = network_initMaster(net);
+    if(res != NETWORK_OK)
+	return res;
+    _network_freeStored(net);
+    if(dtype == NETWORK_DTYPE_NATIVE)
+	return NETWORK_OK;
+
+    net->stored = (uint16_t **)(calloc(net->depth, sizeof(uint16_t *)));
+    if(!net->stored)
+	return NETWORK_ERR_ALLOC;
+    net->dtype = dtype;
+    for(size_t i = 0; i < net->depth; ++i) {
+	net->stored[i] = (uint16_t *)(malloc(net->weights[i].dataLen * sizeof(uint16_t)));
+	if(!net->stored[i]) {
+	    _network_freeStored(net);
+	    return NETWORK_ERR_ALLOC;
+	}
+	network_syncWeights(net, i, 0, net->weights[i].dataLen);
+    }
+    return NETWORK_OK;
+}
+
+network_err_t network_initMaster(network_t * net) {
+    if(!net)
+	return NETWORK_ERR_NULL;
+    for(size_t i = 0; i < net->depth; ++i) {
+	matrix_t * weights = (net->weights + i);
+	if(weights->data)
+	    continue;
+	if(net->dtype == NETWORK_DTYPE_NATIVE || !net->stored)
+	    return NETWORK_ERR;
+	if(matrix_init(weights, weights->rows, weights->cols) != MATRIX_OK || !weights->data)
+	    return NETWORK_ERR_ALLOC;
+	if(net->dtype == NETWORK_DTYPE_F16)
+	    kernel.widenF16(weights->dataLen, net->stored[i], weights->data);
+	else
+	    kernel.widenBF16(weights->dataLen, net->stored[i], weights->data);
+    }
+    return NETWORK_OK;
+}
+
+network_err_t network_syncWeights(network_t * net, size_t layerIdx, size_t start, size_t count) {
+    if(!net)
+	return NETWORK_ERR_NULL;
+    if(layerIdx >= net->depth || start + count > net->weights[layerIdx].dataLen)
+	return NETWORK_ERR_IDX;
+    MATRIX_TYPE const * master = net->weights[layerIdx].data + start;
+    if(net->dtype == NETWORK_DTYPE_F16) {
+	uint16_t * stored = net->stored[layerIdx] + start;
+	for(size_t i = 0; i < count; ++i)
+	    stored[i] = kernel_floatToF16(master[i]);
+    } else if(net->dtype == NETWORK_DTYPE_BF16) {
+	uint16_t * stored = net->stored[layerIdx] + start;
+	for(size_t i = 0; i < count; ++i)
+	    stored[i] = kernel_floatToBF16(master[i]);
+    }
+    return NETWORK_OK;
+}
+
+size_t network_dtypeSize(network_t const * net) {
+    return (net->dtype == NETWORK_DTYPE_NATIVE ? sizeof(MATRIX_TYPE) : sizeof(uint16_t));
+}
+
 network_err_t network_setWeights(network_t * net, size_t layerIdx, matrix_t * weights) {
     /* Validating arguments */
     if(!net || !weights)
 	return NETWORK_ERR_NULL;
     if(layerIdx >= net->depth)
 	return NETWORK_ERR_IDX;
-    /* Copying over weights */
+    if(network_initMaster(net) != NETWORK_OK)
+	return NETWORK_ERR_ALLOC;
+    /* Copying over weights, then into the reduced precision copy */
     if(matrix_copy(weights, (net->weights + layerIdx)) != MATRIX_OK)
 	return NETWORK_ERR;
+    return network_syncWeights(net, layerIdx, 0, net->weights[layerIdx].dataLen);
+}
+
+network_err_t network_setBiases(network_t * net, size_t layerIdx, matrix_t * biases) {
+    /* Validating arguments */
+    if(!net || !biases)
+	return NETWORK_ERR_NULL;
+    if(layerIdx >= net->depth)
+	return NETWORK_ERR_IDX;
+    /* Copying over biases */
+    if(matrix_copy(biases, (net->biases + layerIdx)) != MATRIX_OK)
+	return NETWORK_ERR;
     return NETWORK_OK;
 }
 
@@ -82,94 +208,251 @@ network_err_t network_setActivation(network_t * net, size_t layerIdx, activation
     return NETWORK_OK;
 }
 
+/** Fused layer step for a single input vector, post = f(W x + b), also keeping pre = W x + b if requested,
+ * done NETWORK_FUSE_BLOCK outputs at a time so that the bias, the tracker copy and the activation all find the block still in L1 */
+static void _network_layerForward(network_t * net, size_t layerIdx, MATRIX_TYPE const * x, MATRIX_TYPE * pre, MATRIX_TYPE * post) {
+    matrix_t * weights = (net->weights + layerIdx);
+    MATRIX_TYPE const * bias = net->biases[layerIdx].data;
+    size_t cols = weights->cols;
+    for(size_t start = 0; start < weights->rows; start += NETWORK_FUSE_BLOCK) {
+	size_t count = (weights->rows - start < NETWORK_FUSE_BLOCK ? weights->rows - start : NETWORK_FUSE_BLOCK);
+	MATRIX_TYPE * y = post + start;
+	/* Dot products in the inference storage type, accumulated at full precision */
+	if(net->dtype == NETWORK_DTYPE_NATIVE) {
+	    for(size_t r = 0; r < count; ++r)
+		y[r] = kernel.dot(cols, weights->data + (start + r) * cols, x) + bias[start + r];
+	} else {
+	    uint16_t const * stored = net->stored[layerIdx] + start * cols;
+	    for(size_t r = 0; r < count; ++r) {
+		uint16_t const * row = stored + r * cols;
+		y[r] = (net->dtype == NETWORK_DTYPE_F16 ? kernel.dotF16(cols, row, x) : kernel.dotBF16(cols, row, x)) + bias[start + r];
+	    }
+	}
+	if(pre)
+	    memcpy(pre + start, y, count * sizeof(MATRIX_TYPE));
+	matrix_t view = { .data = y, .dataLen = count, .rows = count, .cols = 1 };
+	PROF_BEGIN(actStart);
+	net->activations[layerIdx].f(&view);
+	PROF_END(actStart, PROF_ACTIVATION, layerIdx);
+    }
+}
+
+/** Fused layer step for 'count' columns (row stride = count), Y = f(W X + b), one block of MATRIX_GEMM_MC output rows at a time:
+ * the block starts out as the broadcast biases, the GEMM accumulates onto it and the activation runs while it is still in cache,
+ * reduced precision weights being widened block by block into the workspace, so that only one block is ever held at full precision */
+static network_err_t _network_layerGemm(network_t * net, network_workspace_t * ws, size_t layerIdx, MATRIX_TYPE const * x, size_t count, MATRIX_TYPE * y) {
+    matrix_t * weights = (net->weights + layerIdx);
+    MATRIX_TYPE const * bias = net->biases[layerIdx].data;
+    if(count == 1) {
+	_network_layerForward(net, layerIdx, x, NULL, y);
+	return NETWORK_OK;
+    }
+    if(net->dtype != NETWORK_DTYPE_NATIVE && !ws->widened)
+	return NETWORK_ERR_INFERENCE;
+    for(size_t row = 0; row < weights->rows; row += MATRIX_GEMM_MC) {
+	size_t block = (weights->rows - row < MATRIX_GEMM_MC ? weights->rows - row : MATRIX_GEMM_MC);
+	MATRIX_TYPE * out = y + row * count;
+	for(size_t r = 0; r < block; ++r) {
+	    for(size_t c = 0; c < count; ++c)
+		out[r * count + c] = bias[row + r];
+	}
+	MATRIX_TYPE const * w = weights->data + row * weights->cols;
+	if(net->dtype != NETWORK_DTYPE_NATIVE) {
+	    uint16_t const * stored = net->stored[layerIdx] + row * weights->cols;
+	    if(net->dtype == NETWORK_DTYPE_F16)
+		kernel.widenF16(block * weights->cols, stored, ws->widened);
+	    else
+		kernel.widenBF16(block * weights->cols, stored, ws->widened);
+	    w = ws->widened;
+	}
+	matrix_gemm(MATRIX_NOTRANS, MATRIX_NOTRANS, block, count, weights->cols, 1, w, weights->cols, x, count, 1, out, count);
+	matrix_t view = { .data = out, .dataLen = block * count, .rows = block, .cols = count };
+	PROF_BEGIN(actStart);
+	net->activations[layerIdx].f(&view);
+	PROF_END(actStart, PROF_ACTIVATION, layerIdx);
+    }
+    return NETWORK_OK;
+}
+
 network_err_t network_inference(network_t * net, matrix_t * input, matrix_t * output) {
     return network_inference_track(net, input, output, NULL);
 }
 
 network_err_t network_inference_track(network_t * net, matrix_t * input, matrix_t * output, network_tracker_t * nodes) {
     /* Validating arguments */
-    if(!net || !input || !output)
+    if(!net)
+	return NETWORK_ERR_NULL;
+
+    /* One-off inference, with a workspace that only lives for this call */
+    network_workspace_t ws = {0};
+    network_err_t result = network_workspace_init(&ws, net);
+    if(result != NETWORK_OK)
+	return result;
+    result = network_inference_ws(net, &ws, input, output, nodes);
+    network_workspace_destroy(&ws);
+    return result;
+}
+
+network_err_t network_inference_ws(network_t * net, network_workspace_t * ws, matrix_t * input, matrix_t * output, network_tracker_t * nodes) {
+    /* Validating arguments */
+    if(!net || !ws || !input || !output)
 	return NETWORK_ERR_NULL;
     if(input->rows != net->inSize || output->rows != net->outSize)
 	return NETWORK_ERR_PARAM;
 
-    /* Running inference (a series of matrix multiplication) */
-    matrix_t prevResult = {0};
-    if(matrix_init(&prevResult, net->inSize, 1) != MATRIX_OK)
-	return NETWORK_ERR_ALLOC;
-    if(matrix_copy(input, &prevResult) != MATRIX_OK)
-	return NETWORK_ERR_INFERENCE;
-
-    /* Iteratively performing matrix multiplication */
+    /* Running inference (a series of fused matrix-vector products), the first layer reads the input directly */
+    MATRIX_TYPE const * prevResult = input->data;
+    size_t prevSize = net->inSize;
     for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+	matrix_t * weights = (net->weights + layerIdx);
+	if(weights->cols != prevSize || weights->rows > ws->size)
+	    return NETWORK_ERR_INFERENCE;
+	if(nodes && (layerIdx >= nodes->depth || weights->rows > nodes->layers[layerIdx]))
+	    return NETWORK_ERR_PARAM;
 
-	/* Allocate space for temporary result */
-	matrix_t tmpResult = {0};
-	if(matrix_init(&tmpResult, (net->weights + layerIdx)->rows, 1) != MATRIX_OK)
-	    return NETWORK_ERR_ALLOC;
+	/* Writing into the free ping-pong buffer, or straight into the output for the last layer,
+	 * or when tracking into the tracker planes, the activated plane then being the next layer's input */
+	MATRIX_TYPE * result = (nodes ? nodes->post[layerIdx] : (layerIdx == net->depth - 1 ? output->data : ws->act[layerIdx % 2]));
+	PROF_BEGIN(layerStart);
+	_network_layerForward(net, layerIdx, prevResult, (nodes ? nodes->pre[layerIdx] : NULL), result);
+	if(nodes && layerIdx == net->depth - 1)
+	    memcpy(output->data, result, weights->rows * sizeof(MATRIX_TYPE));
+	PROF_END(layerStart, PROF_FORWARD, layerIdx);
+	/* Dot products and biases, reading the weights (in the storage type), the biases and the input, writing the output */
+	PROF_COUNT(PROF_FORWARD, layerIdx, 2 * weights->rows * weights->cols + weights->rows,
+		   weights->rows * weights->cols * network_dtypeSize(net) + (2 * weights->rows + weights->cols) * sizeof(MATRIX_TYPE));
 
-	/* Do matrix multiplication */
-	if(matrix_matmul((net->weights + layerIdx), &prevResult, &tmpResult) != MATRIX_OK)
+	prevResult = result;
+	prevSize = weights->rows;
+    }
+    return NETWORK_OK;
+}
+
+network_err_t network_inference_batch(network_t * net, network_workspace_t * ws, matrix_t * input, matrix_t * output, matrix_t * layerOut) {
+    /* Validating arguments */
+    if(!net || !ws || !input || !output)
+	return NETWORK_ERR_NULL;
+    size_t count = input->cols;
+    if(input->rows != net->inSize || output->rows != net->outSize || output->cols != count || count > ws->batch)
+	return NETWORK_ERR_PARAM;
+
+    /* Each layer is one fused GEMM, bias and activation over all columns, with the columns packed densely (row stride = count) */
+    MATRIX_TYPE const * prevResult = input->data;
+    size_t prevSize = net->inSize;
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+	matrix_t * weights = (net->weights + layerIdx);
+	if(weights->cols != prevSize || weights->rows > ws->size)
 	    return NETWORK_ERR_INFERENCE;
-	/* Free temporarily allocated space, copy temporary result over to the previous result */
-	if(matrix_destroy(&prevResult) != MATRIX_OK)
-	    return NETWORK_ERR_ALLOC;
 
-	/* Attempting to write to nodes before activation */
-	if(nodes) {
-	    for(size_t i = 0; i < tmpResult.rows; ++i) {
-		MATRIX_TYPE num;
-		matrix_get(&tmpResult, i, 0, &num);
-		nodes->layerData[layerIdx][i][0] = num;
-	    }
+	/* Writing into the tracked layer output if requested, otherwise into a ping-pong buffer or the output */
+	MATRIX_TYPE * result;
+	if(layerOut) {
+	    if(layerOut[layerIdx].dataLen < weights->rows * count)
+		return NETWORK_ERR_PARAM;
+	    result = layerOut[layerIdx].data;
+	} else {
+	    result = (layerIdx == net->depth - 1 ? output->data : ws->act[layerIdx % 2]);
 	}
+	PROF_BEGIN(layerStart);
+	network_err_t res = _network_layerGemm(net, ws, layerIdx, prevResult, count, result);
+	if(res != NETWORK_OK)
+	    return res;
+	PROF_END(layerStart, PROF_FORWARD, layerIdx);
+	PROF_COUNT(PROF_FORWARD, layerIdx, (2 * weights->cols + 1) * weights->rows * count,
+		   weights->rows * weights->cols * network_dtypeSize(net) + (weights->rows * (count + 1) + weights->cols * count) * sizeof(MATRIX_TYPE));
 
-	/* Calling activation function */
-	net->activations[layerIdx].f(&tmpResult);
+	prevResult = result;
+	prevSize = weights->rows;
+    }
 
-	/* Attempting to write nodes after activation */
-	if(nodes) {
-	    for(size_t i = 0; i < tmpResult.rows; ++i) {
-		MATRIX_TYPE num;
-		matrix_get(&tmpResult, i, 0, &num);
-		nodes->layerData[layerIdx][i][1] = num;
-	    }
-	}
+    /* The tracked last layer still has to end up in the output */
+    if(layerOut && output->data != layerOut[net->depth - 1].data) {
+	for(size_t i = 0; i < net->outSize * count; ++i)
+	    output->data[i] = prevResult[i];
+    }
+    return NETWORK_OK;
+}
 
-	/* Overwriting the previous result with the current temporary result */
-	prevResult = tmpResult;
+network_err_t network_workspace_init(network_workspace_t * ws, network_t * net) {
+    return network_workspace_initBatch(ws, net, 1);
+}
+
+network_err_t network_workspace_initBatch(network_workspace_t * ws, network_t * net, size_t batch) {
+    if(!ws || !net)
+	return NETWORK_ERR_NULL;
+    if(batch < 1)
+	return NETWORK_ERR_PARAM;
+
+    /* Sizing the buffers for the widest layer */
+    ws->size = net->inSize;
+    for(size_t i = 0; i < net->depth; ++i) {
+	if((net->weights + i)->rows > ws->size)
+	    ws->size = (net->weights + i)->rows;
     }
+    ws->batch = batch;
 
-    /* Writing data to output and freeing allocated resources */
-    if(matrix_copy(&prevResult, output) != MATRIX_OK)
-	return NETWORK_ERR_INFERENCE;
-    if(matrix_destroy(&prevResult) != MATRIX_OK)
+    /* Carving the four buffers (and the widened weight block of a reduced precision network) out of a single allocation */
+    size_t bufLen = ws->size * ws->batch;
+    size_t widenedLen = (net->dtype == NETWORK_DTYPE_NATIVE ? 0 : MATRIX_GEMM_MC * ws->size);
+    ws->data = (MATRIX_TYPE *)(malloc((4 * bufLen + widenedLen) * sizeof(MATRIX_TYPE)));
+    if(!ws->data)
 	return NETWORK_ERR_ALLOC;
+    ws->act[0] = ws->data;
+    ws->act[1] = ws->data + bufLen;
+    ws->err[0] = ws->data + 2 * bufLen;
+    ws->err[1] = ws->data + 3 * bufLen;
+    ws->widened = (widenedLen ? ws->data + 4 * bufLen : NULL);
+    return NETWORK_OK;
+}
+
+network_err_t network_workspace_destroy(network_workspace_t * ws) {
+    if(!ws)
+	return NETWORK_ERR_NULL;
+    free(ws->data);
+    *ws = (network_workspace_t){0};
     return NETWORK_OK;
 }
 
 network_err_t network_tracker_init(network_tracker_t * tracker, size_t depth, size_t * layers) {
+    if(!tracker || !layers)
+	return NETWORK_ERR_NULL;
+    if(depth == 0)
+	return NETWORK_ERR_PARAM;
+
+    /* Sizing the arena, the layer sizes and plane pointers first, then every plane rounded up to a whole cache line */
+    size_t const align = 64;
+    size_t const planeAlign = align / sizeof(MATRIX_TYPE);
+    size_t headLen = depth * sizeof(size_t) + 2 * depth * sizeof(MATRIX_TYPE *);
+    headLen = (headLen + align - 1) / align * align;
+    size_t planeLen = 0;
+    for(size_t i = 0; i < depth; ++i)
+	planeLen += 2 * ((layers[i] + planeAlign - 1) / planeAlign * planeAlign);
+
+    void * data = NULL;
+    if(posix_memalign(&data, align, headLen + planeLen * sizeof(MATRIX_TYPE)) != 0)
+	return NETWORK_ERR_ALLOC;
+
+    /* Carving the arena up */
     tracker->depth = depth;
-    tracker->layers = (size_t *)(malloc(depth * sizeof(size_t)));
-    tracker->layerData = (MATRIX_TYPE ***)(malloc(tracker->depth * sizeof(MATRIX_TYPE **)));
+    tracker->data = data;
+    tracker->layers = (size_t *)(data);
+    tracker->pre = (MATRIX_TYPE **)(tracker->layers + depth);
+    tracker->post = tracker->pre + depth;
+    MATRIX_TYPE * plane = (MATRIX_TYPE *)((char *)(data) + headLen);
     for(size_t i = 0; i < depth; ++i) {
+	size_t len = (layers[i] + planeAlign - 1) / planeAlign * planeAlign;
 	tracker->layers[i] = layers[i];
-	tracker->layerData[i] = (MATRIX_TYPE **)(malloc(tracker->layers[i] * sizeof(MATRIX_TYPE *)));
-	for(size_t j = 0; j < tracker->layers[i]; ++j) {
-	    tracker->layerData[i][j] = (MATRIX_TYPE *)(malloc(2 * sizeof(MATRIX_TYPE)));
-	}
+	tracker->pre[i] = plane;
+	tracker->post[i] = plane + len;
+	plane += 2 * len;
     }
     return NETWORK_OK;
 }
 
 network_err_t network_tracker_destroy(network_tracker_t * tracker) {
-    for(size_t i = 0; i < tracker->depth; ++i) {
-	for(size_t j = 0; j < tracker->layers[i]; ++j) {
-	    free(tracker->layerData[i][j]);
-	}
-	free(tracker->layerData[i]);
-    }
-    free(tracker->layerData);
-    free(tracker->layers);
+    if(!tracker)
+	return NETWORK_ERR_NULL;
+    free(tracker->data);
+    *tracker = (network_tracker_t){0};
     return NETWORK_OK;
 }
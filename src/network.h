@@ -7,16 +7,41 @@
 #define NETWORK_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "matrix.h"
 #include "activation.h"
+#include "rng.h"
 
-/** Minimum value for the weight initialization random integer generator */
-extern int32_t network_weightRandMin;
-/** Maximum value for the weight initialization random integer generator */
-extern int32_t network_weightRandMax;
-/** Inverse multiplier for the generated integer for random weight initialization - use this to initialize to floating point numbers */
-extern float network_weightRandDiv;
+/** Number of layer outputs the fused single vector layer step finishes (dot products, bias, tracker copy, activation) at a time */
+#ifndef NETWORK_FUSE_BLOCK
+#define NETWORK_FUSE_BLOCK 64
+#endif /* NETWORK_FUSE_BLOCK */
+
+/** Random number stream of the weight initialization, every layer drawing from a substream of its own */
+#define NETWORK_RNG_STREAM 1
+
+/** Weight initialization schemes, the biases always starting at zero */
+typedef enum {
+    /** Uniform within a given range */
+    NETWORK_INIT_UNIFORM = 0,
+    /** Xavier (Glorot) uniform within +-sqrt(6 / (inputs + outputs)) of every layer, suiting logistic layers */
+    NETWORK_INIT_XAVIER = 1,
+    /** He (Kaiming) normal with a standard deviation of sqrt(2 / inputs) of every layer, suiting ReLU layers */
+    NETWORK_INIT_HE = 2
+} network_init_t;
+
+/** Storage types of the weights used for inference, anything but native being a reduced precision copy of the full precision (master) weights */
+typedef enum {
+    /** MATRIX_TYPE, inference uses the master weights directly */
+    NETWORK_DTYPE_NATIVE = 0,
+    /** IEEE 754 half precision, 10 mantissa bits and 5 exponent bits (largest value 65504) */
+    NETWORK_DTYPE_F16 = 1,
+    /** bfloat16, 7 mantissa bits and the full float exponent range */
+    NETWORK_DTYPE_BF16 = 2
+} network_dtype_t;
 
 /** Data structure representing a neural network */
 typedef struct {
@@ -30,21 +55,55 @@ typedef struct {
     size_t depth;
     /** Array of weights for each layer, represented as a matrix */
     matrix_t * weights;
+    /** Array of biases for each layer, represented as a column vector (kept at full precision whatever the dtype) */
+    matrix_t * biases;
     /** Array of activation functions for each corresponding layer */
     activation_t * activations;
 
+    /** The storage type of the weights used by inference */
+    network_dtype_t dtype;
+    /** Per-layer row-major reduced precision weights used by inference, rounded from the master weights (NULL if the dtype is native),
+     * a network loaded from a reduced precision file has empty master weight matrices (NULL data, only the shape set) until network_initMaster is called */
+    uint16_t ** stored;
+
+    /** Memory mapping of the file the weights were loaded from, which the weight matrices point into (NULL if the weights are allocated) */
+    void * mapping;
+    /** The length of the memory mapping */
+    size_t mappingLen;
+
 } network_t;
 
-/** Data structure tracking the values within internal network nodes during inference */
+/** Data structure tracking the values within internal network nodes during inference,
+ * kept in a single 64-byte aligned allocation with separate contiguous planes of values before and after activation for each layer */
 typedef struct {
     /** The total number of tracked layers */
     size_t depth;
     /** The sizes of each individual layer */
     size_t * layers;
-    /** The data within the network tracker (first array is layer, second is node at layer, third is before/after activation) */
-    MATRIX_TYPE *** layerData;
+    /** The values of each layer before activation (pre[layer][node]) */
+    MATRIX_TYPE ** pre;
+    /** The values of each layer after activation (post[layer][node]) */
+    MATRIX_TYPE ** post;
+    /** The single allocation backing all of the above */
+    void * data;
 } network_tracker_t;
 
+/** Preallocated scratch buffers for inference and training, sized once for a given network so that repeated calls don't allocate */
+typedef struct {
+    /** The number of rows in each buffer (the widest layer of the network) */
+    size_t size;
+    /** The number of columns (samples) in each buffer, 1 unless initialized for batched inference */
+    size_t batch;
+    /** Ping-pong activation buffers, each layer reads its input from one and writes its output into the other */
+    MATRIX_TYPE * act[2];
+    /** Ping-pong error derivative buffers, used the same way by backpropagation */
+    MATRIX_TYPE * err[2];
+    /** Widened block of up to MATRIX_GEMM_MC reduced precision weight rows for batched inference (NULL if the dtype is native) */
+    MATRIX_TYPE * widened;
+    /** The single allocation backing all of the buffers */
+    MATRIX_TYPE * data;
+} network_workspace_t;
+
 /** Network error/result type, returned from network.h functions */
 typedef enum {
     /** Default state, successful operation */
@@ -73,15 +132,30 @@ typedef enum {
  */
 network_err_t network_init(network_t * net, size_t inSize, size_t depth, size_t * layers, activation_t * activations);
 
-/** Initialize the weights of a network_t data structure to random values */
-network_err_t network_initWeights(network_t * net);
-
-/** Internal function for weight initialization, generates random numbers for each given index */
-MATRIX_TYPE _network_random(size_t idx);
+/** Initialize the weights of a network_t data structure to random values of the given scheme ('low' and 'high' being the range of
+ * NETWORK_INIT_UNIFORM), the same seed always giving the same weights */
+network_err_t network_initWeights(network_t * net, network_init_t init, MATRIX_TYPE low, MATRIX_TYPE high, uint64_t seed);
 
 /** Deallocate data used by a network_t structure */
 network_err_t network_destroy(network_t * net);
 
+/** Sets the storage type of the weights used for inference, rounding the master weights into (or dropping) the reduced precision copies */
+network_err_t network_setDtype(network_t * net, network_dtype_t dtype);
+
+/** Makes sure the network has full precision master weights, widening them from the reduced precision copies if it was loaded without them
+ * (needed before training or reading the weight matrices directly) */
+network_err_t network_initMaster(network_t * net);
+
+/** Rounds 'count' master weights of a layer, from the flat (row-major) index 'start', into the reduced precision copy after they were updated,
+ * does nothing if the dtype is native */
+network_err_t network_syncWeights(network_t * net, size_t layerIdx, size_t start, size_t count);
+
+/** Returns the size in bytes of one weight as used by inference */
+size_t network_dtypeSize(network_t const * net);
+
+/** Copies over given biases to a given layer in the network (the provided biases matrix must have the appropriate shape) */
+network_err_t network_setBiases(network_t * net, size_t layerIdx, matrix_t * biases);
+
 /** Copies over given weights to a given layer in the network (the provided weights matrix must have the appropriate shape) */
 network_err_t network_setWeights(network_t * net, size_t layerIdx, matrix_t * weights);
 
@@ -101,6 +175,28 @@ network_err_t network_inference(network_t * net, matrix_t * input, matrix_t * ou
  */
 network_err_t network_inference_track(network_t * net, matrix_t * input, matrix_t * output, network_tracker_t * nodes);
 
+/** Runs network inference using the buffers of a preallocated workspace instead of allocating, optionally tracking the values at all nodes
+ * @param ws workspace initialized for this network (or one with layers at least as wide)
+ * @param nodes tracker object for the internal state of the nodes after inference, or NULL
+ */
+network_err_t network_inference_ws(network_t * net, network_workspace_t * ws, matrix_t * input, matrix_t * output, network_tracker_t * nodes);
+
+/** Runs inference on a batch of inputs, one per column, as one matrix-matrix product per layer
+ * @param input the matrix containing the inputs as columns, expected to be 'inSize' x B, with B at most the workspace batch size
+ * @param output the matrix receiving the outputs as columns, expected to be 'outSize' x B
+ * @param layerOut optional array of 'depth' matrices, each at least (layer size x B) elements, receiving the activated output of every layer (used for training), or NULL
+ */
+network_err_t network_inference_batch(network_t * net, network_workspace_t * ws, matrix_t * input, matrix_t * output, matrix_t * layerOut);
+
+/** Initializes a workspace with buffers large enough for the layers of the given network (must be destroyed after) */
+network_err_t network_workspace_init(network_workspace_t * ws, network_t * net);
+
+/** Initializes a workspace with buffers large enough for batches of up to 'batch' samples through the given network (must be destroyed after) */
+network_err_t network_workspace_initBatch(network_workspace_t * ws, network_t * net, size_t batch);
+
+/** Destroys a workspace which will no longer be used */
+network_err_t network_workspace_destroy(network_workspace_t * ws);
+
 /** Initializes a network internal node tracker data structure 
  * @param layers the node count for each layer in the network, the last being the number of outputs, as an array
  */
@@ -0,0 +1,122 @@
+#include "optim.h"
+
+#include <math.h>
+#include <string.h>
+
+/** Returns the number of states per parameter of an optimizer type */
+static size_t _optim_states(optim_type_t type) {
+    switch(type) {
+	case OPTIM_MOMENTUM:
+	case OPTIM_NESTEROV:
+	    return 1;
+	case OPTIM_ADAM:
+	case OPTIM_ADAMW:
+	    return 2;
+	default:
+	    return 0;
+    }
+}
+
+optim_err_t optim_init(optim_t * optim, network_t const * net, optim_options_t const * options, float learnRate) {
+    /* Checking parameters */
+    if(!optim || !net || !options || options->type > OPTIM_ADAMW)
+	return OPTIM_ERR_PARAM;
+
+    *optim = (optim_t){ .options = *options, .rate = learnRate, .depth = net->depth };
+    size_t states = _optim_states(options->type);
+    if(states == 0)
+	return OPTIM_OK;
+
+    /* Every layer's state right after the one of the layer before it, in one zeroed block */
+    optim->offsets = (size_t *)(malloc(net->depth * sizeof(size_t)));
+    if(!optim->offsets)
+	return OPTIM_ERR_ALLOC;
+    size_t total = 0;
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+	optim->offsets[layerIdx] = total;
+	total += states * (net->weights[layerIdx].dataLen + net->biases[layerIdx].dataLen);
+    }
+    optim->state = (MATRIX_TYPE *)(calloc(total, sizeof(MATRIX_TYPE)));
+    if(!optim->state) {
+	optim_destroy(optim);
+	return OPTIM_ERR_ALLOC;
+    }
+    optim->stateLen = total;
+    return OPTIM_OK;
+}
+
+optim_err_t optim_destroy(optim_t * optim) {
+    if(!optim)
+	return OPTIM_ERR_PARAM;
+    free(optim->state);
+    free(optim->offsets);
+    *optim = (optim_t){0};
+    return OPTIM_OK;
+}
+
+float optim_schedule(optim_options_t const * options, float learnRate, size_t iteration, size_t iterations) {
+    /* Linear warm-up, reaching the full rate at its last iteration */
+    if(iteration < options->warmup)
+	return learnRate * (iteration + 1) / options->warmup;
+    size_t t = iteration - options->warmup, length = (iterations > options->warmup ? iterations - options->warmup : 1);
+
+    switch(options->schedule) {
+	case OPTIM_SCHEDULE_STEP:
+	    return (options->stepSize > 0 ? learnRate * powf(options->gamma, (float)(t / options->stepSize)) : learnRate);
+	case OPTIM_SCHEDULE_COSINE:
+	    return options->minRate + (learnRate - options->minRate) * 0.5f * (1 + cosf((float)(M_PI) * t / length));
+	default:
+	    return learnRate;
+    }
+}
+
+kernel_optim_t optim_step(optim_t * optim) {
+    optim_options_t const * options = &optim->options;
+    kernel_optim_t step = { .scale = 1, .rate = optim->rate, .momentum = options->momentum, .nesterov = (options->type == OPTIM_NESTEROV),
+			    .beta1 = options->beta1, .beta2 = options->beta2, .epsilon = options->epsilon, .shrink = 1 };
+
+    /* Decoupled weight decay shrinks the weights directly, otherwise it is an L2 penalty added to the gradient */
+    if(options->type == OPTIM_ADAMW)
+	step.shrink = 1 - optim->rate * options->weightDecay;
+    else
+	step.decay = options->weightDecay;
+
+    /* Adam's moments start at zero, the bias corrections scale them up over the first steps */
+    if(options->type == OPTIM_ADAM || options->type == OPTIM_ADAMW) {
+	uint64_t t = __atomic_add_fetch(&optim->steps, 1, __ATOMIC_RELAXED);
+	step.correction1 = 1 / (1 - pow(options->beta1, (double)(t)));
+	step.correction2 = 1 / (1 - pow(options->beta2, (double)(t)));
+    }
+    return step;
+}
+
+void optim_apply(optim_t * optim, kernel_optim_t const * step, network_t * net, size_t layerIdx, int bias, size_t start, size_t count,
+		 MATRIX_TYPE scale, MATRIX_TYPE const * c) {
+    matrix_t * weights = (net->weights + layerIdx);
+    matrix_t * biases = (net->biases + layerIdx);
+    MATRIX_TYPE * p = (bias ? biases->data : weights->data) + start;
+    kernel_optim_t k = *step;
+    k.scale = scale;
+    /* The biases never decay */
+    if(bias) {
+	k.decay = 0;
+	k.shrink = 1;
+    }
+
+    if(!optim->state) {
+	/* Plain SGD, p += rate * (scale * c - decay * p) */
+	if(k.decay != 0)
+	    kernel.scale(count, 1 - k.rate * k.decay, p);
+	kernel.axpy(count, k.rate * scale, c, p);
+    } else {
+	/* The state of the weights then the biases of the layer, the second state following the first of both */
+	MATRIX_TYPE * first = optim->state + optim->offsets[layerIdx] + (bias ? weights->dataLen : 0) + start;
+	if(optim->options.type == OPTIM_MOMENTUM || optim->options.type == OPTIM_NESTEROV)
+	    kernel.momentum(count, c, first, p, &k);
+	else
+	    kernel.adam(count, c, first, first + weights->dataLen + biases->dataLen, p, &k);
+    }
+
+    if(!bias)
+	network_syncWeights(net, layerIdx, start, count);
+}
@@ -0,0 +1,123 @@
+/**
+ * @file optim.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing the training optimizers (SGD, momentum, Nesterov, Adam, AdamW), their per-parameter state and the learning rate schedules
+ */
+#ifndef OPTIM_H
+#define OPTIM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "matrix.h"
+#include "kernel.h"
+#include "network.h"
+
+/** Default momentum factor */
+#ifndef OPTIM_DEFAULT_MOMENTUM
+#define OPTIM_DEFAULT_MOMENTUM 0.9f
+#endif /* OPTIM_DEFAULT_MOMENTUM */
+/** Default Adam decay rates of the first and second moments */
+#ifndef OPTIM_DEFAULT_BETA1
+#define OPTIM_DEFAULT_BETA1 0.9f
+#endif /* OPTIM_DEFAULT_BETA1 */
+#ifndef OPTIM_DEFAULT_BETA2
+#define OPTIM_DEFAULT_BETA2 0.999f
+#endif /* OPTIM_DEFAULT_BETA2 */
+/** Default Adam denominator offset */
+#ifndef OPTIM_DEFAULT_EPSILON
+#define OPTIM_DEFAULT_EPSILON 1e-8f
+#endif /* OPTIM_DEFAULT_EPSILON */
+
+/** Optimizer types */
+typedef enum {
+    /** Plain stochastic gradient descent, no state */
+    OPTIM_SGD = 0,
+    /** SGD with (heavy ball) momentum, one velocity per parameter */
+    OPTIM_MOMENTUM = 1,
+    /** SGD with Nesterov momentum, one velocity per parameter */
+    OPTIM_NESTEROV = 2,
+    /** Adam, two moments per parameter, weight decay being an L2 penalty */
+    OPTIM_ADAM = 3,
+    /** Adam with decoupled weight decay */
+    OPTIM_ADAMW = 4
+} optim_type_t;
+
+/** Learning rate schedules, over training iterations (passes over the set) */
+typedef enum {
+    /** The learning rate stays the same */
+    OPTIM_SCHEDULE_CONSTANT = 0,
+    /** The learning rate is multiplied by 'gamma' every 'stepSize' iterations */
+    OPTIM_SCHEDULE_STEP = 1,
+    /** The learning rate follows half a cosine from the learning rate down to 'minRate' over the iterations */
+    OPTIM_SCHEDULE_COSINE = 2
+} optim_schedule_t;
+
+/** Optimizer and learning rate schedule options, a zero-initialized structure being plain SGD at a constant rate */
+typedef struct {
+    /** The optimizer */
+    optim_type_t type;
+    /** Momentum factor of OPTIM_MOMENTUM and OPTIM_NESTEROV */
+    float momentum;
+    /** Adam decay rates of the first and second moments, and its denominator offset */
+    float beta1, beta2, epsilon;
+    /** Weight decay factor (the biases never decay), an L2 penalty but with OPTIM_ADAMW, 0 for none */
+    float weightDecay;
+
+    /** The learning rate schedule */
+    optim_schedule_t schedule;
+    /** Iterations between the steps of OPTIM_SCHEDULE_STEP, and the factor of every step */
+    size_t stepSize;
+    float gamma;
+    /** Final learning rate of OPTIM_SCHEDULE_COSINE */
+    float minRate;
+    /** Iterations at the start the learning rate ramps up linearly over before the schedule starts, 0 for none */
+    size_t warmup;
+} optim_options_t;
+
+/** Data structure representing an optimizer, with the state of every parameter of a network */
+typedef struct {
+    /** The options */
+    optim_options_t options;
+    /** The current learning rate */
+    float rate;
+    /** The number of layers */
+    size_t depth;
+    /** The state of every layer in one block, each layer's the first state (velocity or first moment) of its weights and of its biases,
+     * followed by the second state (second moment) of both for Adam, NULL for SGD */
+    MATRIX_TYPE * state;
+    size_t stateLen;
+    /** Offset of every layer's state within the block */
+    size_t * offsets;
+    /** The number of update steps started, counting the bias corrections of Adam */
+    uint64_t steps;
+} optim_t;
+
+/** Optimizer error types */
+typedef enum {
+    /** Success state */
+    OPTIM_OK = 0,
+    /** Error with function parameters */
+    OPTIM_ERR_PARAM = 1,
+    /** Error allocating memory */
+    OPTIM_ERR_ALLOC = 2
+} optim_err_t;
+
+/** Initializes an optimizer for the given network at the given learning rate, its state starting out zeroed */
+optim_err_t optim_init(optim_t * optim, network_t const * net, optim_options_t const * options, float learnRate);
+
+/** Destroys an optimizer */
+optim_err_t optim_destroy(optim_t * optim);
+
+/** Returns the scheduled learning rate of the iteration 'iteration' (from 0) out of 'iterations', starting from 'learnRate' */
+float optim_schedule(optim_options_t const * options, float learnRate, size_t iteration, size_t iterations);
+
+/** Starts an update step, returning the hyperparameters of its fused kernels, safe to call from several threads at once */
+kernel_optim_t optim_step(optim_t * optim);
+
+/** Applies 'scale' times the corrections 'c' (the negative gradient) to 'count' weights of a layer (or its biases if 'bias' is set) from the flat
+ * index 'start' within the step, in one fused pass over the parameters and their state, re-rounding the reduced precision weights */
+void optim_apply(optim_t * optim, kernel_optim_t const * step, network_t * net, size_t layerIdx, int bias, size_t start, size_t count,
+		 MATRIX_TYPE scale, MATRIX_TYPE const * c);
+
+#endif /* OPTIM_H */
@@ -0,0 +1,134 @@
+#include "pool.h"
+
+#include <unistd.h>
+
+#include "matrix.h"
+
+struct pool_slot {
+    pool_t * pool;
+    size_t worker;
+};
+
+/** Worker thread loop, runs every new task until the pool is stopped */
+static void * _pool_worker(void * arg) {
+    pool_slot_t * slot = (pool_slot_t *)arg;
+    pool_t * pool = slot->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for(;;) {
+	while(pool->generation == seen && !pool->stop)
+	    pthread_cond_wait(&pool->wake, &pool->lock);
+	if(pool->stop)
+	    break;
+	seen = pool->generation;
+	pool_task_t task = pool->task;
+	void * taskArg = pool->arg;
+	pthread_mutex_unlock(&pool->lock);
+
+	task(taskArg, slot->worker, pool->size);
+
+	pthread_mutex_lock(&pool->lock);
+	if(--pool->running == 0)
+	    pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Releasing thread-local scratch memory before the thread goes away */
+    matrix_gemmRelease();
+    return NULL;
+}
+
+pool_err_t pool_init(pool_t * pool, size_t size) {
+    if(!pool)
+	return POOL_ERR_PARAM;
+
+    *pool = (pool_t){0};
+    pool->size = (size > 0 ? size : 1);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    if(pool->size == 1)
+	return POOL_OK;
+
+    /* Starting the worker threads, the caller is worker 0 */
+    pool->threads = (pthread_t *)(malloc((pool->size - 1) * sizeof(pthread_t)));
+    pool->slots = (pool_slot_t *)(malloc((pool->size - 1) * sizeof(pool_slot_t)));
+    if(!pool->threads || !pool->slots) {
+	/* Falling back to running everything on the calling thread */
+	free(pool->threads);
+	free(pool->slots);
+	pool->threads = NULL;
+	pool->slots = NULL;
+	pool->size = 1;
+	return POOL_ERR_ALLOC;
+    }
+    for(size_t i = 0; i < pool->size - 1; ++i) {
+	pool->slots[i] = (pool_slot_t){ .pool = pool, .worker = i + 1 };
+	if(pthread_create((pool->threads + i), NULL, _pool_worker, (pool->slots + i)) != 0) {
+	    /* The pool stays usable with the threads started so far */
+	    pool->size = i + 1;
+	    return POOL_ERR_THREAD;
+	}
+    }
+    return POOL_OK;
+}
+
+pool_err_t pool_run(pool_t * pool, pool_task_t task, void * arg) {
+    if(!pool || !task)
+	return POOL_ERR_PARAM;
+
+    /* Waking the workers */
+    if(pool->size > 1) {
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->arg = arg;
+	pool->running = pool->size - 1;
+	++pool->generation;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+    }
+
+    /* Doing the calling thread's share, then waiting for the rest */
+    task(arg, 0, pool->size);
+    if(pool->size > 1) {
+	pthread_mutex_lock(&pool->lock);
+	while(pool->running > 0)
+	    pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+    }
+    return POOL_OK;
+}
+
+pool_err_t pool_destroy(pool_t * pool) {
+    if(!pool)
+	return POOL_ERR_PARAM;
+
+    /* Stopping and joining the workers */
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    if(pool->threads) {
+	for(size_t i = 0; i < pool->size - 1; ++i)
+	    pthread_join(pool->threads[i], NULL);
+    }
+
+    free(pool->threads);
+    free(pool->slots);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    *pool = (pool_t){0};
+    return POOL_OK;
+}
+
+void pool_split(size_t count, size_t worker, size_t workers, size_t * start, size_t * end) {
+    *start = (count * worker) / workers;
+    *end = (count * (worker + 1)) / workers;
+}
+
+size_t pool_cpuCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0 ? (size_t)count : 1);
+}
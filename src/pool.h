@@ -0,0 +1,74 @@
+/**
+ * @file pool.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing a fixed-size fork-join thread pool
+ */
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/** Task run by every worker of the pool, given its index (0 is the calling thread) and the total number of workers */
+typedef void (*pool_task_t) (void * arg, size_t worker, size_t workers);
+
+/** Per-thread slot of a pool */
+typedef struct pool_slot pool_slot_t;
+
+/** Data structure representing a thread pool, its workers wait between runs instead of being recreated */
+typedef struct {
+    /** The total number of workers, including the thread calling pool_run */
+    size_t size;
+    /** The worker threads (size - 1 of them) */
+    pthread_t * threads;
+    /** The worker thread slots */
+    pool_slot_t * slots;
+
+    /** Lock protecting the run state below */
+    pthread_mutex_t lock;
+    /** Signalled when a new run starts or the pool stops */
+    pthread_cond_t wake;
+    /** Signalled when the last worker of a run finishes */
+    pthread_cond_t done;
+
+    /** The task of the current run */
+    pool_task_t task;
+    /** The argument of the current run */
+    void * arg;
+    /** Run counter, workers wait for it to change */
+    unsigned long generation;
+    /** The number of worker threads still busy with the current run */
+    size_t running;
+    /** Set when the pool is being destroyed */
+    int stop;
+} pool_t;
+
+/** Pool error types */
+typedef enum {
+    /** Success state */
+    POOL_OK = 0,
+    /** Error with function parameters */
+    POOL_ERR_PARAM = 1,
+    /** Error creating a thread */
+    POOL_ERR_THREAD = 2,
+    /** Error allocating memory */
+    POOL_ERR_ALLOC = 3
+} pool_err_t;
+
+/** Initializes a pool of the given total number of workers (0 or 1 runs every task on the calling thread only),
+ * the pool must stay at the same address until destroyed, on failure to start all threads it stays usable with fewer workers */
+pool_err_t pool_init(pool_t * pool, size_t size);
+
+/** Runs the task once on every worker, with the calling thread as worker 0, and returns once all workers have finished */
+pool_err_t pool_run(pool_t * pool, pool_task_t task, void * arg);
+
+/** Stops and joins the worker threads and frees the pool */
+pool_err_t pool_destroy(pool_t * pool);
+
+/** Returns the [start, end) part of 'count' items assigned to the given worker, split as evenly as possible in worker order */
+void pool_split(size_t count, size_t worker, size_t workers, size_t * start, size_t * end);
+
+/** Returns the number of online processors, at least 1 */
+size_t pool_cpuCount(void);
+
+#endif /* POOL_H */
@@ -0,0 +1,279 @@
+#include "prof.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/** Names of the phases in summaries and traces */
+static char const * const _prof_names [PROF_PHASES] = { "forward", "backward", "update", "activation", "load", "prefetch", "epoch" };
+
+/** Totals over every thread */
+typedef struct {
+    uint64_t ns [PROF_PHASES];
+    uint64_t calls [PROF_PHASES];
+    uint64_t flops, bytes;
+    double loss;
+    uint64_t lossCount;
+} _prof_totals_t;
+
+/** Lock protecting the thread list */
+static pthread_mutex_t _prof_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Whether the profiler is running */
+static int _prof_active = 0;
+/** Profiling session counter, thread counters of older sessions being stale */
+static unsigned long _prof_session = 0;
+/** The counters of every thread that measured anything */
+static prof_thread_t * _prof_threads = NULL;
+static unsigned int _prof_threadCount = 0;
+/** Start of the session and of the current epoch */
+static uint64_t _prof_origin = 0, _prof_epochStart = 0;
+/** Totals at the end of the previous epoch */
+static _prof_totals_t _prof_last;
+/** The trace file, NULL if none */
+static char * _prof_traceFile = NULL;
+
+/** The counters of the calling thread, and the session they belong to */
+static __thread prof_thread_t * _prof_self = NULL;
+static __thread unsigned long _prof_selfSession = 0;
+
+static uint64_t _prof_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec) * 1000000000ull + now.tv_nsec;
+}
+
+/** Returns the counters of the calling thread, registering them on first use within the session (NULL if out of memory) */
+static prof_thread_t * _prof_thread(void) {
+    if(_prof_self && _prof_selfSession == _prof_session)
+	return _prof_self;
+    prof_thread_t * self = (prof_thread_t *)(calloc(1, sizeof(prof_thread_t)));
+    if(!self)
+	return NULL;
+    pthread_mutex_lock(&_prof_lock);
+    self->tid = _prof_threadCount++;
+    self->next = _prof_threads;
+    _prof_threads = self;
+    pthread_mutex_unlock(&_prof_lock);
+    _prof_self = self;
+    _prof_selfSession = _prof_session;
+    return self;
+}
+
+/** Returns the counter index of a layer */
+static size_t _prof_layer(size_t layer) {
+    return (layer < PROF_MAX_LAYERS ? layer : PROF_MAX_LAYERS - 1);
+}
+
+/** Adds a trace event to the calling thread's trace */
+static void _prof_trace(prof_thread_t * self, prof_phase_t phase, size_t layer, uint64_t start, uint64_t duration, double value) {
+    if(!_prof_traceFile)
+	return;
+    if(self->eventCount == self->eventCap) {
+	size_t cap = (self->eventCap ? self->eventCap * 2 : 1024);
+	prof_event_t * events = (cap <= PROF_TRACE_MAX ? (prof_event_t *)(realloc(self->events, cap * sizeof(prof_event_t))) : NULL);
+	if(!events) {
+	    ++self->dropped;
+	    return;
+	}
+	self->events = events;
+	self->eventCap = cap;
+    }
+    self->events[self->eventCount++] = (prof_event_t){ .phase = phase, .layer = (layer == PROF_NO_LAYER ? UINT32_MAX : (uint32_t)(layer)),
+						       .start = start - _prof_origin, .duration = duration, .value = value };
+}
+
+/** Sums the counters of every thread */
+static void _prof_sum(_prof_totals_t * totals) {
+    memset(totals, 0, sizeof(_prof_totals_t));
+    pthread_mutex_lock(&_prof_lock);
+    for(prof_thread_t * t = _prof_threads; t; t = t->next) {
+	for(size_t p = 0; p < PROF_PHASES; ++p) {
+	    totals->ns[p] += t->ns[p];
+	    totals->calls[p] += t->calls[p];
+	    for(size_t l = 0; l < PROF_MAX_LAYERS; ++l) {
+		totals->flops += t->flops[l][p];
+		totals->bytes += t->bytes[l][p];
+	    }
+	}
+	totals->loss += t->loss;
+	totals->lossCount += t->lossCount;
+    }
+    pthread_mutex_unlock(&_prof_lock);
+}
+
+/** Frees the counters of every thread */
+static void _prof_free(void) {
+    pthread_mutex_lock(&_prof_lock);
+    while(_prof_threads) {
+	prof_thread_t * next = _prof_threads->next;
+	free(_prof_threads->events);
+	free(_prof_threads);
+	_prof_threads = next;
+    }
+    _prof_threadCount = 0;
+    pthread_mutex_unlock(&_prof_lock);
+}
+
+/** Writes every trace event as Chrome trace-event JSON (see chrome://tracing or ui.perfetto.dev) */
+static prof_err_t _prof_writeTrace(char const * filename) {
+    FILE * fp = fopen(filename, "w");
+    if(!fp)
+	return PROF_ERR_FILE;
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    int first = 1;
+    for(prof_thread_t * t = _prof_threads; t; t = t->next) {
+	fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}", (first ? "" : ",\n"), t->tid, t->tid);
+	first = 0;
+	for(size_t i = 0; i < t->eventCount; ++i) {
+	    prof_event_t const * e = t->events + i;
+	    fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"train\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u",
+		    _prof_names[e->phase], e->start * 1e-3, e->duration * 1e-3, t->tid);
+	    if(e->phase == PROF_EPOCH) {
+		fprintf(fp, ", \"args\": {\"epoch\": %u, \"loss\": %g}}", e->layer, e->value);
+		fprintf(fp, ",\n{\"name\": \"loss\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u, \"args\": {\"loss\": %g}}",
+			(e->start + e->duration) * 1e-3, t->tid, e->value);
+	    } else if(e->layer != UINT32_MAX) {
+		fprintf(fp, ", \"args\": {\"layer\": %u}}", e->layer);
+	    } else {
+		fputc('}', fp);
+	    }
+	}
+    }
+    fprintf(fp, "\n]}\n");
+    return (fclose(fp) == 0 ? PROF_OK : PROF_ERR_FILE);
+}
+
+prof_err_t prof_start(char const * traceFile) {
+    if(_prof_active)
+	return PROF_ERR_PARAM;
+    _prof_free();
+    free(_prof_traceFile);
+    _prof_traceFile = (traceFile ? strdup(traceFile) : NULL);
+    memset(&_prof_last, 0, sizeof(_prof_totals_t));
+    ++_prof_session;
+    _prof_origin = _prof_epochStart = _prof_now();
+    _prof_active = 1;
+    return PROF_OK;
+}
+
+prof_err_t prof_stop(void) {
+    if(!_prof_active)
+	return PROF_ERR_PARAM;
+    _prof_active = 0;
+
+    /* Totals of every layer in every phase that counted any work */
+    uint64_t flops [PROF_MAX_LAYERS][PROF_PHASES] = {{0}}, bytes [PROF_MAX_LAYERS][PROF_PHASES] = {{0}};
+    size_t dropped = 0;
+    pthread_mutex_lock(&_prof_lock);
+    for(prof_thread_t * t = _prof_threads; t; t = t->next) {
+	for(size_t l = 0; l < PROF_MAX_LAYERS; ++l) {
+	    for(size_t p = 0; p < PROF_PHASES; ++p) {
+		flops[l][p] += t->flops[l][p];
+		bytes[l][p] += t->bytes[l][p];
+	    }
+	}
+	dropped += t->dropped;
+    }
+    pthread_mutex_unlock(&_prof_lock);
+    for(size_t l = 0; l < PROF_MAX_LAYERS; ++l) {
+	int any = 0;
+	for(size_t p = 0; p < PROF_PHASES; ++p) {
+	    if(flops[l][p] || bytes[l][p]) {
+		if(!any)
+		    fprintf(stderr, "Layer %lu:", l);
+		fprintf(stderr, "%s %s %.4g GFLOP %.4g GB", (any ? "," : ""), _prof_names[p], flops[l][p] * 1e-9, bytes[l][p] * 1e-9);
+		any = 1;
+	    }
+	}
+	if(any)
+	    fputc('\n', stderr);
+    }
+
+    prof_err_t res = PROF_OK;
+    if(_prof_traceFile) {
+	if(dropped > 0)
+	    fprintf(stderr, "Warning: %lu trace events past the limit of %d per thread were dropped\n", dropped, PROF_TRACE_MAX);
+	res = _prof_writeTrace(_prof_traceFile);
+	free(_prof_traceFile);
+	_prof_traceFile = NULL;
+    }
+    _prof_free();
+    return res;
+}
+
+uint64_t prof_begin(void) {
+    return (_prof_active ? _prof_now() : 0);
+}
+
+void prof_end(prof_phase_t phase, size_t layer, uint64_t start) {
+    if(!start || !_prof_active)
+	return;
+    uint64_t end = _prof_now();
+    prof_thread_t * self = _prof_thread();
+    if(!self)
+	return;
+    self->ns[phase] += end - start;
+    ++self->calls[phase];
+    _prof_trace(self, phase, layer, start, end - start, 0);
+}
+
+void prof_count(prof_phase_t phase, size_t layer, uint64_t flops, uint64_t bytes) {
+    if(!_prof_active)
+	return;
+    prof_thread_t * self = _prof_thread();
+    if(!self)
+	return;
+    self->flops[_prof_layer(layer)][phase] += flops;
+    self->bytes[_prof_layer(layer)][phase] += bytes;
+}
+
+void prof_loss(MATRIX_TYPE const * output, MATRIX_TYPE const * target, size_t count) {
+    if(!_prof_active)
+	return;
+    prof_thread_t * self = _prof_thread();
+    if(!self)
+	return;
+    for(size_t i = 0; i < count; ++i) {
+	double diff = (double)(output[i]) - target[i];
+	self->loss += diff * diff;
+    }
+    self->lossCount += count;
+}
+
+void prof_epoch(size_t epoch) {
+    if(!_prof_active)
+	return;
+    uint64_t now = _prof_now();
+    prof_thread_t * self = _prof_thread();
+    if(!self)
+	return;
+    self->ns[PROF_EPOCH] += now - _prof_epochStart;
+    ++self->calls[PROF_EPOCH];
+
+    /* The counters of this epoch, against the totals at the end of the previous one */
+    _prof_totals_t totals;
+    _prof_sum(&totals);
+    double seconds = (now - _prof_epochStart) * 1e-9;
+    uint64_t lossCount = totals.lossCount - _prof_last.lossCount;
+    double loss = (lossCount > 0 ? (totals.loss - _prof_last.loss) / lossCount : 0);
+    _prof_trace(self, PROF_EPOCH, epoch, _prof_epochStart, now - _prof_epochStart, loss);
+
+    fprintf(stderr, "Epoch %lu: ", epoch);
+    if(lossCount > 0)
+	fprintf(stderr, "loss %g, ", loss);
+    fprintf(stderr, "%.3f ms", seconds * 1e3);
+    if(seconds > 0)
+	fprintf(stderr, ", %.3f GFLOP/s, %.3f GB/s", (totals.flops - _prof_last.flops) * 1e-9 / seconds, (totals.bytes - _prof_last.bytes) * 1e-9 / seconds);
+    int first = 1;
+    for(size_t p = 0; p < PROF_EPOCH; ++p) {
+	if(totals.calls[p] == _prof_last.calls[p])
+	    continue;
+	fprintf(stderr, "%s%s %.3f ms", (first ? " (" : ", "), _prof_names[p], (totals.ns[p] - _prof_last.ns[p]) * 1e-6);
+	first = 0;
+    }
+    fprintf(stderr, "%s\n", (first ? "" : ")"));
+
+    _prof_last = totals;
+    _prof_epochStart = _prof_now();
+}
@@ -0,0 +1,129 @@
+/**
+ * @file prof.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing the training profiler: phase timers, per-layer FLOP and byte counters, the per-epoch loss,
+ * epoch summaries and Chrome trace-event output, the PROF_ instrumentation macros only being compiled in with PROF_ENABLE defined (make profile=true)
+ */
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+/** Number of layers with counters of their own, deeper layers being counted with the last one */
+#ifndef PROF_MAX_LAYERS
+#define PROF_MAX_LAYERS 64
+#endif /* PROF_MAX_LAYERS */
+/** Maximum number of trace events kept per thread, later ones only being counted */
+#ifndef PROF_TRACE_MAX
+#define PROF_TRACE_MAX (1 << 18)
+#endif /* PROF_TRACE_MAX */
+/** Layer index of measurements not belonging to a layer */
+#define PROF_NO_LAYER ((size_t)(-1))
+
+/** Profiled phases */
+typedef enum {
+    /** Layer inference, including its activation */
+    PROF_FORWARD = 0,
+    /** Error derivative propagation and the gradient computation, including the activation derivatives */
+    PROF_BACKWARD = 1,
+    /** Applying the corrections to the weights and biases */
+    PROF_UPDATE = 2,
+    /** Activation functions and their derivatives (nested within forward and backward) */
+    PROF_ACTIVATION = 3,
+    /** Waiting for the next chunk of training data */
+    PROF_LOAD = 4,
+    /** Reading and parsing a chunk on the prefetch thread of a stream */
+    PROF_PREFETCH = 5,
+    /** A whole epoch (pass over the training data) */
+    PROF_EPOCH = 6,
+    /** The number of phases */
+    PROF_PHASES = 7
+} prof_phase_t;
+
+/** A trace event, a complete duration event in the Chrome trace */
+typedef struct {
+    /** The phase */
+    uint32_t phase;
+    /** The layer (the epoch of PROF_EPOCH events), UINT32_MAX if none */
+    uint32_t layer;
+    /** Start and duration, in nanoseconds since prof_start */
+    uint64_t start, duration;
+    /** The epoch loss of PROF_EPOCH events */
+    double value;
+} prof_event_t;
+
+/** Counters of a single thread, only ever written by that thread, so that the hot paths need no synchronisation */
+typedef struct prof_thread {
+    /** Trace thread id, in order of first use */
+    unsigned int tid;
+    /** Total nanoseconds and calls of every phase */
+    uint64_t ns [PROF_PHASES];
+    uint64_t calls [PROF_PHASES];
+    /** Floating point operations and bytes moved of every layer in every phase */
+    uint64_t flops [PROF_MAX_LAYERS][PROF_PHASES];
+    uint64_t bytes [PROF_MAX_LAYERS][PROF_PHASES];
+    /** Sum of the squared training errors and the number of values summed */
+    double loss;
+    uint64_t lossCount;
+    /** Trace events, and the number of those that didn't fit */
+    prof_event_t * events;
+    size_t eventCount, eventCap, dropped;
+    /** Next thread of the profiler */
+    struct prof_thread * next;
+} prof_thread_t;
+
+/** Profiler error types */
+typedef enum {
+    /** Success state */
+    PROF_OK = 0,
+    /** Error with function parameters, or the profiler not running */
+    PROF_ERR_PARAM = 1,
+    /** Error writing the trace file */
+    PROF_ERR_FILE = 2
+} prof_err_t;
+
+/** Starts profiling, resetting all counters, the trace being written to 'traceFile' by prof_stop (NULL for summaries only) */
+prof_err_t prof_start(char const * traceFile);
+
+/** Stops profiling, printing the per-layer totals to stderr and writing the trace file */
+prof_err_t prof_stop(void);
+
+/** Returns the start time of a measurement, 0 if the profiler isn't running */
+uint64_t prof_begin(void);
+
+/** Ends a measurement started by prof_begin, adding it to the phase of the calling thread (and to its trace) */
+void prof_end(prof_phase_t phase, size_t layer, uint64_t start);
+
+/** Adds floating point operations and bytes moved to a layer of a phase */
+void prof_count(prof_phase_t phase, size_t layer, uint64_t flops, uint64_t bytes);
+
+/** Adds the squared errors of 'count' outputs against their targets to the epoch loss */
+void prof_loss(MATRIX_TYPE const * output, MATRIX_TYPE const * target, size_t count);
+
+/** Ends an epoch (started by the previous one or prof_start), printing its summary to stderr: the loss, the time spent in every phase
+ * (summed over threads), the FLOP and byte rates, and adding it to the trace */
+void prof_epoch(size_t epoch);
+
+#ifdef PROF_ENABLE
+/** Starts a scoped timer of the given name */
+#define PROF_BEGIN(name) uint64_t name = prof_begin()
+/** Ends the scoped timer of the given name, adding it to a phase of a layer */
+#define PROF_END(name, phase, layer) prof_end((phase), (layer), name)
+/** Counts floating point operations and bytes moved */
+#define PROF_COUNT(phase, layer, flops, bytes) prof_count((phase), (layer), (flops), (bytes))
+/** Adds squared errors to the epoch loss */
+#define PROF_LOSS(output, target, count) prof_loss((output), (target), (count))
+/** Ends an epoch */
+#define PROF_EPOCH(epoch) prof_epoch(epoch)
+#else
+#define PROF_BEGIN(name) ((void)0)
+#define PROF_END(name, phase, layer) ((void)0)
+#define PROF_COUNT(phase, layer, flops, bytes) ((void)0)
+#define PROF_LOSS(output, target, count) ((void)0)
+#define PROF_EPOCH(epoch) ((void)0)
+#endif /* PROF_ENABLE */
+
+#endif /* PROF_H */
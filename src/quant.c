@@ -0,0 +1,329 @@
+#include "quant.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "kernel.h"
+
+/** Quantized network file header, followed by one quant_fileLayer_t, the row scales, the row biases and the weights per layer */
+typedef struct {
+    char magic [8];
+    uint32_t version;
+    /** Written as 0x01020304 in the writing host byte order, files of the other byte order are rejected */
+    uint32_t endian;
+    uint32_t bits;
+    uint32_t depth;
+    uint64_t inSize;
+} _quant_fileHeader_t;
+
+typedef struct {
+    uint64_t rows, cols;
+    float inScale;
+    uint32_t activation;
+} _quant_fileLayer_t;
+
+/** Returns the largest representable magnitude of the given width */
+static float _quant_max(quant_bits_t bits) {
+    return (bits == QUANT_INT8 ? 127.0f : 32767.0f);
+}
+
+/** Returns the element size of the given width */
+static size_t _quant_size(quant_bits_t bits) {
+    return (bits == QUANT_INT8 ? sizeof(int8_t) : sizeof(int16_t));
+}
+
+/** Quantizes n values with the given scale into int8 or int16 */
+static void _quant_values(quant_bits_t bits, size_t n, MATRIX_TYPE const * x, float scale, void * q) {
+    float limit = _quant_max(bits), inv = 1.0f / scale;
+    for(size_t i = 0; i < n; ++i) {
+	float v = nearbyintf(x[i] * inv);
+	v = (v > limit ? limit : (v < -limit ? -limit : v));
+	if(bits == QUANT_INT8)
+	    ((int8_t *)(q))[i] = (int8_t)(v);
+	else
+	    ((int16_t *)(q))[i] = (int16_t)(v);
+    }
+}
+
+/** Returns the scale mapping the given largest magnitude onto the largest integer of the width */
+static float _quant_scale(quant_bits_t bits, float maxAbs) {
+    return (maxAbs > 0 ? maxAbs / _quant_max(bits) : 1.0f);
+}
+
+/** Allocates the zeroed layer table */
+static quant_err_t _quant_alloc(quant_network_t * qnet, size_t depth) {
+    qnet->depth = depth;
+    qnet->layers = (quant_layer_t *)(calloc(depth, sizeof(quant_layer_t)));
+    return (qnet->layers ? QUANT_OK : QUANT_ERR_ALLOC);
+}
+
+/** Allocates a layer's weights, scales and biases, widening the network's buffer width as needed */
+static quant_err_t _quant_allocLayer(quant_network_t * qnet, quant_layer_t * layer, size_t rows, size_t cols) {
+    layer->rows = rows;
+    layer->cols = cols;
+    layer->weights = malloc(rows * cols * _quant_size(qnet->bits));
+    layer->scales = (float *)(malloc(rows * sizeof(float)));
+    layer->bias = (float *)(malloc(rows * sizeof(float)));
+    if(rows > qnet->width)
+	qnet->width = rows;
+    if(cols > qnet->width)
+	qnet->width = cols;
+    return (layer->weights && layer->scales && layer->bias ? QUANT_OK : QUANT_ERR_ALLOC);
+}
+
+quant_err_t quant_calibrate(quant_network_t * qnet, network_t * net, set_t * set, quant_bits_t bits) {
+    if(!qnet || !net || !set || set->inSize != net->inSize || (bits != QUANT_INT8 && bits != QUANT_INT16))
+	return QUANT_ERR_PARAM;
+    if(network_initMaster(net) != NETWORK_OK)
+	return QUANT_ERR_ALLOC;
+
+    *qnet = (quant_network_t){ .inSize = net->inSize, .outSize = net->outSize, .bits = bits };
+    if(_quant_alloc(qnet, net->depth) != QUANT_OK) {
+	quant_destroy(qnet);
+	return QUANT_ERR_ALLOC;
+    }
+
+    /* Weights, one scale per row from the row's largest magnitude */
+    for(size_t l = 0; l < net->depth; ++l) {
+	matrix_t * weights = (net->weights + l);
+	quant_layer_t * layer = (qnet->layers + l);
+	if(_quant_allocLayer(qnet, layer, weights->rows, weights->cols) != QUANT_OK) {
+	    quant_destroy(qnet);
+	    return QUANT_ERR_ALLOC;
+	}
+	layer->activation = net->activations[l];
+	for(size_t r = 0; r < weights->rows; ++r) {
+	    MATRIX_TYPE const * row = weights->data + r * weights->cols;
+	    float maxAbs = 0;
+	    for(size_t c = 0; c < weights->cols; ++c)
+		maxAbs = fmaxf(maxAbs, fabsf(row[c]));
+	    layer->scales[r] = _quant_scale(bits, maxAbs);
+	    _quant_values(bits, weights->cols, row, layer->scales[r], (char *)(layer->weights) + r * weights->cols * _quant_size(bits));
+	    layer->bias[r] = (float)(net->biases[l].data[r]);
+	}
+    }
+
+    /* Inputs, one scale per layer from the largest magnitude of the layer inputs over the set */
+    size_t layers [net->depth];
+    float maxIn [net->depth];
+    for(size_t l = 0; l < net->depth; ++l) {
+	layers[l] = net->weights[l].rows;
+	maxIn[l] = 0;
+    }
+    network_tracker_t tracker = {0};
+    network_workspace_t ws = {0};
+    matrix_t out = {0};
+    matrix_init(&out, net->outSize, 1);
+    quant_err_t res = QUANT_OK;
+    if(network_tracker_init(&tracker, net->depth, layers) != NETWORK_OK || network_workspace_init(&ws, net) != NETWORK_OK || !out.data)
+	res = QUANT_ERR_ALLOC;
+    for(size_t idx = 0; idx < set->size && res == QUANT_OK; ++idx) {
+	matrix_t in = set_inView(set, idx);
+	if(network_inference_ws(net, &ws, &in, &out, &tracker) != NETWORK_OK) {
+	    res = QUANT_ERR_INFERENCE;
+	    break;
+	}
+	for(size_t l = 0; l < net->depth; ++l) {
+	    MATRIX_TYPE const * layerIn = (l > 0 ? tracker.post[l-1] : in.data);
+	    for(size_t i = 0; i < net->weights[l].cols; ++i)
+		maxIn[l] = fmaxf(maxIn[l], fabsf(layerIn[i]));
+	}
+    }
+    for(size_t l = 0; l < net->depth; ++l)
+	qnet->layers[l].inScale = _quant_scale(bits, maxIn[l]);
+
+    network_tracker_destroy(&tracker);
+    network_workspace_destroy(&ws);
+    matrix_destroy(&out);
+    if(res != QUANT_OK)
+	quant_destroy(qnet);
+    return res;
+}
+
+quant_err_t quant_destroy(quant_network_t * qnet) {
+    if(!qnet)
+	return QUANT_ERR_PARAM;
+    for(size_t l = 0; qnet->layers && l < qnet->depth; ++l) {
+	free(qnet->layers[l].weights);
+	free(qnet->layers[l].scales);
+	free(qnet->layers[l].bias);
+    }
+    free(qnet->layers);
+    *qnet = (quant_network_t){0};
+    return QUANT_OK;
+}
+
+quant_err_t quant_workspace_init(quant_workspace_t * ws, quant_network_t * qnet, size_t capacity) {
+    if(!ws || !qnet || capacity == 0)
+	return QUANT_ERR_PARAM;
+    *ws = (quant_workspace_t){ .capacity = capacity };
+    ws->in = malloc(capacity * qnet->width * _quant_size(qnet->bits));
+    ws->act[0] = (MATRIX_TYPE *)(malloc(2 * capacity * qnet->width * sizeof(MATRIX_TYPE)));
+    if(!ws->in || !ws->act[0]) {
+	quant_workspace_destroy(ws);
+	return QUANT_ERR_ALLOC;
+    }
+    ws->act[1] = ws->act[0] + capacity * qnet->width;
+    return QUANT_OK;
+}
+
+quant_err_t quant_workspace_destroy(quant_workspace_t * ws) {
+    if(!ws)
+	return QUANT_ERR_PARAM;
+    free(ws->in);
+    free(ws->act[0]);
+    *ws = (quant_workspace_t){0};
+    return QUANT_OK;
+}
+
+quant_err_t quant_inference_batch(quant_network_t * qnet, quant_workspace_t * ws, MATRIX_TYPE const * points, MATRIX_TYPE * results, size_t count) {
+    if(!qnet || !ws || !points || !results || count > ws->capacity)
+	return QUANT_ERR_PARAM;
+
+    size_t elemSize = _quant_size(qnet->bits);
+    MATRIX_TYPE const * prev = points;
+    for(size_t l = 0; l < qnet->depth; ++l) {
+	quant_layer_t * layer = (qnet->layers + l);
+	MATRIX_TYPE * result = (l == qnet->depth - 1 ? results : ws->act[l % 2]);
+
+	/* Quantizing every point's inputs with the layer input scale */
+	_quant_values(qnet->bits, count * layer->cols, prev, layer->inScale, ws->in);
+
+	/* Integer products a tile of weight rows at a time against all points, scaled back per row and biased */
+	for(size_t r0 = 0; r0 < layer->rows; r0 += QUANT_ROW_TILE) {
+	    size_t r1 = (r0 + QUANT_ROW_TILE < layer->rows ? r0 + QUANT_ROW_TILE : layer->rows);
+	    for(size_t p = 0; p < count; ++p) {
+		void const * x = (char const *)(ws->in) + p * layer->cols * elemSize;
+		for(size_t r = r0; r < r1; ++r) {
+		    void const * w = (char const *)(layer->weights) + r * layer->cols * elemSize;
+		    double sum = (qnet->bits == QUANT_INT8 ? (double)(kernel.dotI8(layer->cols, (int8_t const *)(w), (int8_t const *)(x)))
+				  : (double)(kernel.dotI16(layer->cols, (int16_t const *)(w), (int16_t const *)(x))));
+		    result[p * layer->rows + r] = (MATRIX_TYPE)(sum * layer->scales[r] * layer->inScale + layer->bias[r]);
+		}
+	    }
+	}
+
+	/* Activations in floating point over the whole block */
+	matrix_t view = { .data = result, .dataLen = count * layer->rows, .rows = layer->rows, .cols = count };
+	layer->activation.f(&view);
+	prev = result;
+    }
+    return QUANT_OK;
+}
+
+quant_err_t quant_compare(quant_network_t * qnet, network_t * net, set_t * set, quant_report_t * report) {
+    if(!qnet || !net || !set || !report || set->inSize != qnet->inSize || net->outSize != qnet->outSize)
+	return QUANT_ERR_PARAM;
+
+    *report = (quant_report_t){0};
+    for(size_t l = 0; l < net->depth; ++l) {
+	report->floatBytes += net->weights[l].rows * (net->weights[l].cols * network_dtypeSize(net) + sizeof(MATRIX_TYPE));
+	report->quantBytes += qnet->layers[l].rows * (qnet->layers[l].cols * _quant_size(qnet->bits) + 2 * sizeof(float)) + sizeof(float);
+    }
+
+    /* Running both networks point by point */
+    quant_workspace_t qws = {0};
+    network_workspace_t ws = {0};
+    matrix_t out = {0};
+    matrix_init(&out, net->outSize, 1);
+    MATRIX_TYPE qout [net->outSize];
+    quant_err_t res = QUANT_OK;
+    if(quant_workspace_init(&qws, qnet, 1) != QUANT_OK || network_workspace_init(&ws, net) != NETWORK_OK || !out.data)
+	res = QUANT_ERR_ALLOC;
+    double sumAbs = 0, sumSq = 0;
+    for(size_t idx = 0; idx < set->size && res == QUANT_OK; ++idx) {
+	matrix_t in = set_inView(set, idx);
+	if(network_inference_ws(net, &ws, &in, &out, NULL) != NETWORK_OK
+	   || quant_inference_batch(qnet, &qws, in.data, qout, 1) != QUANT_OK) {
+	    res = QUANT_ERR_INFERENCE;
+	    break;
+	}
+	for(size_t i = 0; i < net->outSize; ++i) {
+	    double diff = fabs((double)(out.data[i]) - qout[i]);
+	    report->maxErr = (diff > report->maxErr ? diff : report->maxErr);
+	    sumAbs += diff;
+	    sumSq += diff * diff;
+	    ++report->count;
+	}
+    }
+    if(report->count > 0) {
+	report->meanErr = sumAbs / report->count;
+	report->rmsErr = sqrt(sumSq / report->count);
+    }
+
+    quant_workspace_destroy(&qws);
+    network_workspace_destroy(&ws);
+    matrix_destroy(&out);
+    return res;
+}
+
+quant_err_t quant_save(quant_network_t * qnet, char const * filename) {
+    if(!qnet || !filename)
+	return QUANT_ERR_PARAM;
+    FILE * fp = fopen(filename, "wb");
+    if(!fp)
+	return QUANT_ERR_FILE;
+
+    _quant_fileHeader_t header = { .magic = QUANT_MAGIC, .version = QUANT_VERSION, .endian = 0x01020304u,
+	.bits = qnet->bits, .depth = qnet->depth, .inSize = qnet->inSize };
+    int ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+    for(size_t l = 0; l < qnet->depth && ok; ++l) {
+	quant_layer_t * layer = (qnet->layers + l);
+	_quant_fileLayer_t entry = { .rows = layer->rows, .cols = layer->cols, .inScale = layer->inScale, .activation = layer->activation.type };
+	ok = (fwrite(&entry, sizeof(entry), 1, fp) == 1
+	      && fwrite(layer->scales, sizeof(float), layer->rows, fp) == layer->rows
+	      && fwrite(layer->bias, sizeof(float), layer->rows, fp) == layer->rows
+	      && fwrite(layer->weights, _quant_size(qnet->bits), layer->rows * layer->cols, fp) == layer->rows * layer->cols);
+    }
+    if(fclose(fp) != 0 || !ok)
+	return QUANT_ERR_FILE;
+    return QUANT_OK;
+}
+
+quant_err_t quant_load(quant_network_t * qnet, char const * filename) {
+    if(!qnet || !filename)
+	return QUANT_ERR_PARAM;
+    FILE * fp = fopen(filename, "rb");
+    if(!fp)
+	return QUANT_ERR_FILE;
+
+    /* Checking the header */
+    _quant_fileHeader_t header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, QUANT_MAGIC, sizeof(QUANT_MAGIC)) != 0
+       || header.version != QUANT_VERSION || header.endian != 0x01020304u || header.depth == 0 || header.inSize == 0 || header.inSize > (1u << 24)
+       || (header.bits != QUANT_INT8 && header.bits != QUANT_INT16)) {
+	fclose(fp);
+	return QUANT_ERR_FORMAT;
+    }
+    *qnet = (quant_network_t){ .inSize = header.inSize, .bits = (quant_bits_t)(header.bits) };
+    quant_err_t res = _quant_alloc(qnet, header.depth);
+
+    /* Reading every layer, checking that the shapes chain up */
+    size_t prevSize = qnet->inSize;
+    for(size_t l = 0; l < qnet->depth && res == QUANT_OK; ++l) {
+	quant_layer_t * layer = (qnet->layers + l);
+	_quant_fileLayer_t entry;
+	if(fread(&entry, sizeof(entry), 1, fp) != 1 || entry.cols != prevSize || entry.rows == 0 || entry.rows > (1u << 24)) {
+	    res = QUANT_ERR_FORMAT;
+	    break;
+	}
+	res = _quant_allocLayer(qnet, layer, entry.rows, entry.cols);
+	if(res != QUANT_OK)
+	    break;
+	layer->inScale = entry.inScale;
+	layer->activation = activation_get((activation_type_t)(entry.activation));
+	if(!layer->activation.f || fread(layer->scales, sizeof(float), layer->rows, fp) != layer->rows
+	   || fread(layer->bias, sizeof(float), layer->rows, fp) != layer->rows
+	   || fread(layer->weights, _quant_size(qnet->bits), layer->rows * layer->cols, fp) != layer->rows * layer->cols) {
+	    res = QUANT_ERR_FORMAT;
+	    break;
+	}
+	prevSize = layer->rows;
+    }
+    qnet->outSize = prevSize;
+    fclose(fp);
+    if(res != QUANT_OK)
+	quant_destroy(qnet);
+    return res;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file quant.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing post-training integer quantization of networks and integer inference
+ */
+#ifndef QUANT_H
+#define QUANT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "matrix.h"
+#include "network.h"
+#include "set.h"
+
+/** Quantized network file magic bytes */
+#define QUANT_MAGIC "FUNCQNT"
+/** Quantized network file format version */
+#define QUANT_VERSION 2
+/** Number of weight rows evaluated against a whole batch at a time, keeping them in cache */
+#define QUANT_ROW_TILE 64
+
+/** Quantized integer widths */
+typedef enum {
+    /** 8-bit weights and activations, values within [-127, 127] */
+    QUANT_INT8 = 8,
+    /** 16-bit weights and activations, values within [-32767, 32767] */
+    QUANT_INT16 = 16
+} quant_bits_t;
+
+/** Quantized layer, weights W ~ scales[row] * q and inputs x ~ inScale * q */
+typedef struct {
+    /** The weight matrix shape */
+    size_t rows, cols;
+    /** Row-major quantized weights, int8_t or int16_t depending on the network width */
+    void * weights;
+    /** Per-row weight scales */
+    float * scales;
+    /** Per-row biases, kept in floating point and added after scaling */
+    float * bias;
+    /** Scale of the layer inputs, from the largest input magnitude seen during calibration */
+    float inScale;
+    /** The layer activation function, run in floating point */
+    activation_t activation;
+} quant_layer_t;
+
+/** Quantized network */
+typedef struct {
+    /** The input and output sizes */
+    size_t inSize, outSize;
+    /** The number of layers */
+    size_t depth;
+    /** The integer width of weights and activations */
+    quant_bits_t bits;
+    /** The widest layer input or output */
+    size_t width;
+    /** The layers */
+    quant_layer_t * layers;
+} quant_network_t;
+
+/** Scratch buffers for batched quantized inference, point-major */
+typedef struct {
+    /** The maximum number of points per call */
+    size_t capacity;
+    /** Quantized layer inputs, capacity * width integers */
+    void * in;
+    /** Ping-pong layer outputs, capacity * width values each */
+    MATRIX_TYPE * act[2];
+} quant_workspace_t;
+
+/** Accuracy of a quantized network against its floating point original */
+typedef struct {
+    /** The number of compared outputs */
+    size_t count;
+    /** Largest and mean absolute output difference */
+    double maxErr, meanErr;
+    /** Root mean squared output difference */
+    double rmsErr;
+    /** Weight storage of the original (in its inference dtype) and of the quantized network (including scales), biases included, in bytes */
+    size_t floatBytes, quantBytes;
+} quant_report_t;
+
+/** Quantization error types */
+typedef enum {
+    /** Success state */
+    QUANT_OK = 0,
+    /** Error with function parameters */
+    QUANT_ERR_PARAM = 1,
+    /** Error allocating memory */
+    QUANT_ERR_ALLOC = 2,
+    /** Error opening, reading or writing a file */
+    QUANT_ERR_FILE = 3,
+    /** Error with the contents of a file */
+    QUANT_ERR_FORMAT = 4,
+    /** Error running inference */
+    QUANT_ERR_INFERENCE = 5
+} quant_err_t;
+
+/** Quantizes a network into an empty quantized network, calibrating the input scale of every layer on the inputs of the given set */
+quant_err_t quant_calibrate(quant_network_t * qnet, network_t * net, set_t * set, quant_bits_t bits);
+
+/** Destroys a quantized network */
+quant_err_t quant_destroy(quant_network_t * qnet);
+
+/** Initializes scratch buffers for up to 'capacity' points per inference call */
+quant_err_t quant_workspace_init(quant_workspace_t * ws, quant_network_t * qnet, size_t capacity);
+
+/** Destroys quantized inference scratch buffers */
+quant_err_t quant_workspace_destroy(quant_workspace_t * ws);
+
+/** Runs integer inference on 'count' points (each qnet->inSize consecutive values) into 'results' (each qnet->outSize consecutive values):
+ * every layer quantizes its inputs, multiplies them with the integer weights into exact integer sums and scales those back */
+quant_err_t quant_inference_batch(quant_network_t * qnet, quant_workspace_t * ws, MATRIX_TYPE const * points, MATRIX_TYPE * results, size_t count);
+
+/** Compares the quantized network with its original on every input of the given set */
+quant_err_t quant_compare(quant_network_t * qnet, network_t * net, set_t * set, quant_report_t * report);
+
+/** Saves a quantized network to a file */
+quant_err_t quant_save(quant_network_t * qnet, char const * filename);
+
+/** Loads a quantized network from a file into an empty quantized network, QUANT_ERR_FORMAT if it isn't a quantized network file */
+quant_err_t quant_load(quant_network_t * qnet, char const * filename);
+
+#endif /* QUANT_H */
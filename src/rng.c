@@ -0,0 +1,123 @@
+#include "rng.h"
+
+#include <math.h>
+
+#include "kernel.h"
+
+/** SplitMix64 finalizer, a bijective 64 bit mix */
+static uint64_t _rng_mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/** Returns a value in [0, 1) from the upper 24 bits of a word */
+static inline MATRIX_TYPE _rng_unit(uint32_t word) {
+    return (MATRIX_TYPE)(word >> 8) * (MATRIX_TYPE)(0x1p-24);
+}
+
+void rng_init(rng_t * rng, uint64_t seed, uint64_t stream) {
+    *rng = (rng_t){ .key = seed, .stream = stream, .used = 4 };
+}
+
+rng_t rng_split(rng_t const * rng, uint64_t index) {
+    rng_t split;
+    rng_init(&split, rng->key, _rng_mix(_rng_mix(rng->stream) + index));
+    return split;
+}
+
+uint32_t rng_next(rng_t * rng) {
+    if(rng->used == 4) {
+	kernel_scalar.philox(1, rng->key, rng->counter++, rng->stream, rng->words);
+	rng->used = 0;
+    }
+    return rng->words[rng->used++];
+}
+
+uint64_t rng_next64(rng_t * rng) {
+    uint64_t hi = rng_next(rng);
+    return (hi << 32) | rng_next(rng);
+}
+
+/** Returns a uniform integer in [0, bound) from a random word by Lemire's multiply-shift, rejecting the few products that would make
+ * the low values more likely (drawing further words from the generator for them) */
+static inline uint32_t _rng_lemire(rng_t * rng, uint32_t word, uint32_t bound) {
+    uint64_t m = (uint64_t)(word) * bound;
+    if((uint32_t)(m) < bound) {
+	uint32_t threshold = (uint32_t)(-bound) % bound;
+	while((uint32_t)(m) < threshold)
+	    m = (uint64_t)(rng_next(rng)) * bound;
+    }
+    return (uint32_t)(m >> 32);
+}
+
+uint64_t rng_below(rng_t * rng, uint64_t bound) {
+    if(bound == 0)
+	return 0;
+    if(bound <= UINT32_MAX)
+	return _rng_lemire(rng, rng_next(rng), (uint32_t)(bound));
+    /* Wider bounds reject the incomplete last multiple instead */
+    uint64_t limit = UINT64_MAX - UINT64_MAX % bound, x;
+    do {
+	x = rng_next64(rng);
+    } while(x >= limit);
+    return x % bound;
+}
+
+MATRIX_TYPE rng_uniform(rng_t * rng) {
+    return _rng_unit(rng_next(rng));
+}
+
+void rng_fill(rng_t * rng, uint32_t * out, size_t n) {
+    /* Whole blocks straight into the output, the words of a last partial block through the generator's own */
+    size_t blocks = n / 4;
+    kernel.philox(blocks, rng->key, rng->counter, rng->stream, out);
+    rng->counter += blocks;
+    rng->used = 4;
+    for(size_t i = 4 * blocks; i < n; ++i)
+	out[i] = rng_next(rng);
+}
+
+void rng_fillUniform(rng_t * rng, MATRIX_TYPE * out, size_t n, MATRIX_TYPE low, MATRIX_TYPE high) {
+    uint32_t words [4 * RNG_FILL_BLOCKS];
+    MATRIX_TYPE range = high - low;
+    for(size_t i = 0; i < n; ) {
+	size_t count = (n - i < 4 * RNG_FILL_BLOCKS ? n - i : 4 * RNG_FILL_BLOCKS);
+	rng_fill(rng, words, count);
+	for(size_t j = 0; j < count; ++j)
+	    out[i + j] = low + range * _rng_unit(words[j]);
+	i += count;
+    }
+}
+
+void rng_fillNormal(rng_t * rng, MATRIX_TYPE * out, size_t n, MATRIX_TYPE mean, MATRIX_TYPE stddev) {
+    uint32_t words [4 * RNG_FILL_BLOCKS];
+    for(size_t i = 0; i < n; ) {
+	/* Every pair of words gives a pair of values, an odd count dropping the last one */
+	size_t count = (n - i < 4 * RNG_FILL_BLOCKS ? n - i : 4 * RNG_FILL_BLOCKS);
+	rng_fill(rng, words, count + (count & 1));
+	for(size_t j = 0; j < count; j += 2) {
+	    /* The radius from (0, 1], so that the logarithm stays finite */
+	    double r = sqrt(-2 * log(_rng_unit(words[j]) + 0x1p-24)), theta = 2 * M_PI * _rng_unit(words[j + 1]);
+	    out[i + j] = mean + stddev * (MATRIX_TYPE)(r * cos(theta));
+	    if(j + 1 < count)
+		out[i + j + 1] = mean + stddev * (MATRIX_TYPE)(r * sin(theta));
+	}
+	i += count;
+    }
+}
+
+void rng_fillSwaps(rng_t * rng, size_t * swaps, size_t n) {
+    uint32_t words [4 * RNG_FILL_BLOCKS];
+    for(size_t i = 0; i < n; ) {
+	size_t count = (n - i < 4 * RNG_FILL_BLOCKS ? n - i : 4 * RNG_FILL_BLOCKS);
+	rng_fill(rng, words, count);
+	for(size_t j = 0; j < count; ++j) {
+	    uint64_t bound = i + j + 1;
+	    /* Beyond 32 bit indices a single word doesn't reach every index */
+	    swaps[i + j] = (bound <= UINT32_MAX ? (size_t)(_rng_lemire(rng, words[j], (uint32_t)(bound))) : (size_t)(rng_below(rng, bound)));
+	}
+	i += count;
+    }
+}
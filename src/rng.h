@@ -0,0 +1,64 @@
+/**
+ * @file rng.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing the counter-based random number generator (Philox4x32-10): explicitly seeded, split into independent streams
+ * (one per thread, layer or pass), with bulk fills for weight initialization and shuffling running on the vectorized kernels
+ */
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+/** Number of blocks (4 words each) the bulk fills generate per kernel call */
+#ifndef RNG_FILL_BLOCKS
+#define RNG_FILL_BLOCKS 64
+#endif /* RNG_FILL_BLOCKS */
+
+/** Data structure representing a random number generator, its words being those of the blocks (counter, stream) under the key of its seed,
+ * so that generators of different streams never overlap and every generator owns its whole state (one per thread, no locking) */
+typedef struct {
+    /** The key (the seed) and the stream */
+    uint64_t key, stream;
+    /** The counter of the next block */
+    uint64_t counter;
+    /** The words of the current block, and the number of them handed out */
+    uint32_t words [4];
+    unsigned int used;
+} rng_t;
+
+/** Initializes a generator for the given stream of the given seed, the same seed and stream always giving the same words */
+void rng_init(rng_t * rng, uint64_t seed, uint64_t stream);
+
+/** Returns an independent generator for the substream 'index' of a generator's stream (of the same seed), for splitting it between
+ * threads, layers or passes, the result not depending on how far the generator got */
+rng_t rng_split(rng_t const * rng, uint64_t index);
+
+/** Returns the next 32 random bits */
+uint32_t rng_next(rng_t * rng);
+
+/** Returns the next 64 random bits */
+uint64_t rng_next64(rng_t * rng);
+
+/** Returns a uniform integer in [0, bound), without modulo bias, 0 if bound is 0 */
+uint64_t rng_below(rng_t * rng, uint64_t bound);
+
+/** Returns a uniform value in [0, 1), of 24 random bits */
+MATRIX_TYPE rng_uniform(rng_t * rng);
+
+/** Fills 'out' with 'n' random words, starting on a fresh block */
+void rng_fill(rng_t * rng, uint32_t * out, size_t n);
+
+/** Fills 'out' with 'n' uniform values in [low, high), starting on a fresh block */
+void rng_fillUniform(rng_t * rng, MATRIX_TYPE * out, size_t n, MATRIX_TYPE low, MATRIX_TYPE high);
+
+/** Fills 'out' with 'n' normally distributed values (Box-Muller), starting on a fresh block */
+void rng_fillNormal(rng_t * rng, MATRIX_TYPE * out, size_t n, MATRIX_TYPE mean, MATRIX_TYPE stddev);
+
+/** Fills 'swaps' with the 'n' swaps of a Fisher-Yates shuffle, swaps[i] being exactly uniform in [0, i] (as from rng_below),
+ * starting on a fresh block, a shuffle exchanging element i with swaps[i] from the last element down */
+void rng_fillSwaps(rng_t * rng, size_t * swaps, size_t n);
+
+#endif /* RNG_H */
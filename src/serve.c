@@ -0,0 +1,428 @@
+/* For ppoll */
+#define _GNU_SOURCE
+
+#include "serve.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "util.h"
+
+/** Connected client (non-blocking), with the bytes received from it but not yet taken as a request and the responses not yet sent to it */
+typedef struct {
+    int fd;
+    unsigned char * buf;
+    size_t len, cap;
+    /** Bytes of the received ones taken into the current batch, and those making up the complete requests */
+    size_t taken, complete;
+    /** The times the complete requests had been received, and the number of them taken into the current batch */
+    struct timespec * arrivals;
+    size_t arrivalCount, arrivalCap, arrivalTaken;
+    unsigned char * out;
+    size_t outLen, outCap;
+    /** Set once the client sent an oversized request, which is answered with an error after the responses to its earlier requests */
+    int rejected;
+    /** Set once the client is only sent its remaining responses before it is closed */
+    int closing;
+} _serve_client_t;
+
+/** Request taken into the current micro-batch */
+typedef struct {
+    /** The client it came from, -1 once that client is gone */
+    int client;
+    /** The first point of the request within the batch and the number of its points */
+    size_t start, count;
+    /** The time the whole request had been received */
+    struct timespec arrival;
+} _serve_pending_t;
+
+/** Request statistics */
+typedef struct {
+    size_t requests, points, batches;
+    /** The most recent request latencies in microseconds, a ring of SERVE_LATENCY_WINDOW */
+    double * latencies;
+    size_t latencyCount;
+} _serve_stats_t;
+
+/** Set by the signal handler to stop the server */
+static volatile sig_atomic_t _serve_stop = 0;
+
+static void _serve_signal(int sig) {
+    (void)(sig);
+    _serve_stop = 1;
+}
+
+/** Returns the microseconds from 'from' to 'to' */
+static double _serve_elapsed(struct timespec const * from, struct timespec const * to) {
+    return (to->tv_sec - from->tv_sec) * 1e6 + (to->tv_nsec - from->tv_nsec) * 1e-3;
+}
+
+static int _serve_compare(void const * a, void const * b) {
+    double da = *(double const *)(a), db = *(double const *)(b);
+    return (da > db) - (da < db);
+}
+
+/** Prints the totals and the latency percentiles of the most recent requests */
+static void _serve_report(_serve_stats_t * stats) {
+    size_t count = (stats->latencyCount < SERVE_LATENCY_WINDOW ? stats->latencyCount : SERVE_LATENCY_WINDOW);
+    double p50 = 0, p99 = 0;
+    double * sorted = (double *)(malloc(count * sizeof(double) + 1));
+    if(sorted && count > 0) {
+	memcpy(sorted, stats->latencies, count * sizeof(double));
+	qsort(sorted, count, sizeof(double), _serve_compare);
+	p50 = sorted[count / 2];
+	p99 = sorted[(count * 99) / 100 < count ? (count * 99) / 100 : count - 1];
+    }
+    free(sorted);
+    printf("Served %lu requests, %lu points in %lu batches (%.1f points/batch), latency p50 %.1f us, p99 %.1f us\n",
+	   stats->requests, stats->points, stats->batches, (stats->batches > 0 ? (double)(stats->points) / stats->batches : 0), p50, p99);
+    fflush(stdout);
+}
+
+/** Appends to the responses waiting to be sent to a client, returning 0 on failure */
+static int _serve_queue(_serve_client_t * client, void const * data, size_t len) {
+    if(client->outCap - client->outLen < len) {
+	size_t cap = (client->outCap > 0 ? client->outCap : 8192);
+	while(cap - client->outLen < len)
+	    cap *= 2;
+	unsigned char * out = (unsigned char *)(realloc(client->out, cap));
+	if(!out)
+	    return 0;
+	client->out = out;
+	client->outCap = cap;
+    }
+    memcpy(client->out + client->outLen, data, len);
+    client->outLen += len;
+    return 1;
+}
+
+/** Sends as much of the waiting responses as the client takes without blocking, returning 0 once the client is gone */
+static int _serve_flush(_serve_client_t * client) {
+    size_t done = 0;
+    while(done < client->outLen) {
+	ssize_t sent = send(client->fd, client->out + done, client->outLen - done, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if(sent < 0 && errno == EINTR && !_serve_stop)
+	    continue;
+	if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+	    break;
+	if(sent <= 0)
+	    return 0;
+	done += sent;
+    }
+    memmove(client->out, client->out + done, client->outLen - done);
+    client->outLen -= done;
+    return 1;
+}
+
+/** Closes a client, forgetting its requests in the current batch so that a new client in its slot doesn't get their responses */
+static void _serve_close(_serve_client_t * clients, size_t idx, _serve_pending_t * pending, size_t pendingCount) {
+    for(size_t p = 0; p < pendingCount; ++p) {
+	if(pending[p].client == (int)(idx))
+	    pending[p].client = -1;
+    }
+    close(clients[idx].fd);
+    free(clients[idx].buf);
+    free(clients[idx].out);
+    free(clients[idx].arrivals);
+    clients[idx] = (_serve_client_t){ .fd = -1 };
+}
+
+/** Reads what is available from a client without blocking, until it has 'limit' bytes waiting, returning 0 once the client is gone */
+static int _serve_read(_serve_client_t * client, size_t limit) {
+    while(client->len < limit) {
+	if(client->cap - client->len < 4096) {
+	    size_t cap = (client->cap > 0 ? client->cap * 2 : 8192);
+	    unsigned char * buf = (unsigned char *)(realloc(client->buf, cap));
+	    if(!buf)
+		return 0;
+	    client->buf = buf;
+	    client->cap = cap;
+	}
+	ssize_t got = recv(client->fd, client->buf + client->len, client->cap - client->len, MSG_DONTWAIT);
+	if(got > 0) {
+	    client->len += got;
+	} else if(got < 0 && errno == EINTR) {
+	    continue;
+	} else {
+	    return (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+	}
+    }
+    return 1;
+}
+
+/** Reads from a client as _serve_read does, then notes the time for every request (of points of 'pointSize' bytes) that is now complete */
+static int _serve_receive(_serve_client_t * client, size_t limit, size_t pointSize, size_t maxCount) {
+    int res = _serve_read(client, limit);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while(res && client->len - client->complete >= sizeof(serve_request_t)) {
+	serve_request_t request;
+	memcpy(&request, client->buf + client->complete, sizeof(request));
+	/* Oversized requests are answered with an error as they are taken */
+	size_t len = sizeof(request) + request.count * pointSize;
+	if(request.count > maxCount || client->len - client->complete < len)
+	    break;
+	if(client->arrivalCount == client->arrivalCap) {
+	    size_t cap = (client->arrivalCap > 0 ? client->arrivalCap * 2 : 64);
+	    struct timespec * arrivals = (struct timespec *)(realloc(client->arrivals, cap * sizeof(struct timespec)));
+	    if(!arrivals)
+		return 0;
+	    client->arrivals = arrivals;
+	    client->arrivalCap = cap;
+	}
+	client->arrivals[client->arrivalCount++] = now;
+	client->complete += len;
+    }
+    return res;
+}
+
+serve_err_t serve_run(network_t * net, serve_options_t const * options) {
+    if(!net || !options || !options->path || options->maxBatch == 0 || net->inSize == 0)
+	return SERVE_ERR_PARAM;
+    size_t inputs = net->inSize, outSize = net->outSize;
+
+    /* Listening socket */
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if(strlen(options->path) >= sizeof(addr.sun_path))
+	return SERVE_ERR_PARAM;
+    strcpy(addr.sun_path, options->path);
+    /* Only a stale socket is replaced, never any other file at the path */
+    struct stat st;
+    if(lstat(options->path, &st) == 0) {
+	if(!S_ISSOCK(st.st_mode) || unlink(options->path) != 0)
+	    return SERVE_ERR_SOCKET;
+    } else if(errno != ENOENT) {
+	return SERVE_ERR_SOCKET;
+    }
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listenFd < 0)
+	return SERVE_ERR_SOCKET;
+    if(bind(listenFd, (struct sockaddr *)(&addr), sizeof(addr)) != 0 || listen(listenFd, 64) != 0) {
+	close(listenFd);
+	return SERVE_ERR_SOCKET;
+    }
+
+    /* Batch buffers, client slots and statistics */
+    util_infer_t infer = {0};
+    MATRIX_TYPE * points = (MATRIX_TYPE *)(malloc(options->maxBatch * net->inSize * sizeof(MATRIX_TYPE)));
+    MATRIX_TYPE * results = (MATRIX_TYPE *)(malloc(options->maxBatch * outSize * sizeof(MATRIX_TYPE)));
+    float * wire = (float *)(malloc(options->maxBatch * (outSize > inputs ? outSize : inputs) * sizeof(float)));
+    _serve_pending_t * pending = (_serve_pending_t *)(malloc(options->maxBatch * sizeof(_serve_pending_t)));
+    _serve_client_t * clients = (_serve_client_t *)(malloc(SERVE_MAX_CLIENTS * sizeof(_serve_client_t)));
+    struct pollfd * fds = (struct pollfd *)(malloc((SERVE_MAX_CLIENTS + 1) * sizeof(struct pollfd)));
+    size_t * fdClients = (size_t *)(malloc((SERVE_MAX_CLIENTS + 1) * sizeof(size_t)));
+    _serve_stats_t stats = { .latencies = (double *)(malloc(SERVE_LATENCY_WINDOW * sizeof(double))) };
+    serve_err_t res = SERVE_OK;
+    if(!points || !results || !wire || !pending || !clients || !fds || !fdClients || !stats.latencies
+       || util_infer_init(&infer, net, options->maxBatch, options->threads) != UTIL_OK)
+	res = SERVE_ERR_ALLOC;
+    for(size_t i = 0; clients && i < SERVE_MAX_CLIENTS; ++i)
+	clients[i] = (_serve_client_t){ .fd = -1 };
+
+    /* Stopping cleanly on SIGINT and SIGTERM, interrupting poll */
+    struct sigaction action = { .sa_handler = _serve_signal };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    _serve_stop = 0;
+
+    size_t pendingCount = 0, batchPoints = 0, scanStart = 0;
+    size_t maxRequest = sizeof(serve_request_t) + options->maxBatch * inputs * sizeof(float);
+    int backlog = 0;
+    struct timespec now, lastReport, oldest = {0};
+    clock_gettime(CLOCK_MONOTONIC, &lastReport);
+    size_t reportedRequests = 0;
+    while(res == SERVE_OK && !_serve_stop) {
+	/* Waiting for input, at most until the coalescing deadline of the oldest pending request (to the microsecond) */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	struct timespec timeout = { .tv_sec = SERVE_STATS_INTERVAL };
+	if(backlog) {
+	    timeout = (struct timespec){ 0 };
+	} else if(pendingCount > 0) {
+	    double left = options->maxDelay - _serve_elapsed(&oldest, &now);
+	    long long ns = (left > 0 ? (long long)(left * 1000) : 0);
+	    timeout = (struct timespec){ .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+	}
+	/* Clients are only read from while they have room for a whole request and aren't behind on reading their responses */
+	nfds_t nfds = 0;
+	fds[nfds++] = (struct pollfd){ .fd = listenFd, .events = POLLIN };
+	for(size_t i = 0; i < SERVE_MAX_CLIENTS; ++i) {
+	    if(clients[i].fd >= 0) {
+		short events = (clients[i].outLen > 0 ? POLLOUT : 0);
+		if(!clients[i].rejected && !clients[i].closing && clients[i].len < maxRequest && clients[i].outLen < SERVE_MAX_OUTPUT)
+		    events |= POLLIN;
+		fdClients[nfds] = i;
+		fds[nfds++] = (struct pollfd){ .fd = clients[i].fd, .events = events };
+	    }
+	}
+	if(ppoll(fds, nfds, &timeout, NULL) < 0 && errno != EINTR)
+	    break;
+
+	/* New connections */
+	if(fds[0].revents & POLLIN) {
+	    int fd = accept(listenFd, NULL, NULL);
+	    size_t slot = 0;
+	    while(fd >= 0 && slot < SERVE_MAX_CLIENTS && clients[slot].fd >= 0)
+		++slot;
+	    if(fd >= 0 && slot < SERVE_MAX_CLIENTS && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0)
+		clients[slot] = (_serve_client_t){ .fd = fd };
+	    else if(fd >= 0)
+		close(fd);
+	}
+
+	/* Sending what the clients take and reading what they sent, dropping the ones that went away */
+	for(nfds_t f = 1; f < nfds; ++f) {
+	    _serve_client_t * client = (clients + fdClients[f]);
+	    int alive = 1;
+	    if(fds[f].revents & POLLOUT)
+		alive = _serve_flush(client);
+	    if(alive && (fds[f].revents & POLLIN))
+		alive = _serve_receive(client, maxRequest, inputs * sizeof(float), options->maxBatch);
+	    else if(fds[f].revents & (POLLERR | POLLHUP | POLLNVAL))
+		alive = 0;
+	    if(!alive || (client->closing && client->outLen == 0))
+		_serve_close(clients, fdClients[f], pending, pendingCount);
+	}
+
+	/* Taking complete requests into the micro-batch while they fit, one request per client and round, the rounds starting after
+	 * the client taken from last, so that no client can crowd the others out of the batch */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	backlog = 0;
+	nfds_t first = 1;
+	while(first < nfds && fdClients[first] < scanStart)
+	    ++first;
+	for(int progress = 1; progress && !backlog; ) {
+	    progress = 0;
+	    for(nfds_t k = 0; k + 1 < nfds && !backlog; ++k) {
+		size_t i = fdClients[1 + (first - 1 + k) % (nfds - 1)];
+		_serve_client_t * client = (clients + i);
+		serve_request_t request;
+		if(client->fd < 0 || client->rejected || client->closing || client->outLen >= SERVE_MAX_OUTPUT || client->len - client->taken < sizeof(request))
+		    continue;
+		memcpy(&request, client->buf + client->taken, sizeof(request));
+		if(request.count > options->maxBatch) {
+		    /* Nothing more is taken from the client, its requests already in the batch being answered first */
+		    client->rejected = 1;
+		    continue;
+		}
+		size_t len = sizeof(request) + request.count * inputs * sizeof(float);
+		if(client->taken == client->complete)
+		    continue;
+		if(batchPoints + request.count > options->maxBatch || pendingCount == options->maxBatch) {
+		    backlog = 1;
+		    break;
+		}
+		/* Converting the points */
+		memcpy(wire, client->buf + client->taken + sizeof(request), request.count * inputs * sizeof(float));
+		for(size_t p = 0; p < request.count; ++p) {
+		    MATRIX_TYPE * point = points + (batchPoints + p) * net->inSize;
+		    for(size_t j = 0; j < inputs; ++j)
+			point[j] = wire[p * inputs + j];
+		}
+		pending[pendingCount++] = (_serve_pending_t){ .client = (int)(i), .start = batchPoints, .count = request.count,
+						       .arrival = client->arrivals[client->arrivalTaken++] };
+		if(pendingCount == 1 || _serve_elapsed(&pending[pendingCount - 1].arrival, &oldest) > 0)
+		    oldest = pending[pendingCount - 1].arrival;
+		batchPoints += request.count;
+		client->taken += len;
+		scanStart = i + 1;
+		progress = 1;
+	    }
+	}
+	for(nfds_t f = 1; f < nfds; ++f) {
+	    _serve_client_t * client = (clients + fdClients[f]);
+	    if(client->fd >= 0 && client->taken > 0) {
+		memmove(client->buf, client->buf + client->taken, client->len - client->taken);
+		client->len -= client->taken;
+		client->complete -= client->taken;
+		client->taken = 0;
+		memmove(client->arrivals, client->arrivals + client->arrivalTaken, (client->arrivalCount - client->arrivalTaken) * sizeof(struct timespec));
+		client->arrivalCount -= client->arrivalTaken;
+		client->arrivalTaken = 0;
+	    }
+	}
+
+	/* Running the batch once it is full or its oldest request has waited long enough */
+	if(pendingCount > 0 && (backlog || batchPoints == options->maxBatch
+	   || _serve_elapsed(&oldest, &now) >= options->maxDelay)) {
+	    int ok = (util_infer_run(&infer, points, results, batchPoints) == UTIL_OK);
+	    /* Queueing every response, then sending to each client what it takes without blocking, the rest on POLLOUT */
+	    for(size_t p = 0; p < pendingCount; ++p) {
+		_serve_pending_t * request = (pending + p);
+		if(request->client < 0)
+		    continue;
+		serve_response_t response = { .status = (ok ? SERVE_STATUS_OK : SERVE_STATUS_ERR_INFERENCE), .count = (ok ? request->count : 0) };
+		for(size_t j = 0; ok && j < request->count * outSize; ++j)
+		    wire[j] = results[request->start * outSize + j];
+		if(!_serve_queue(clients + request->client, &response, sizeof(response))
+		   || !_serve_queue(clients + request->client, wire, response.count * outSize * sizeof(float)))
+		    _serve_close(clients, request->client, pending, pendingCount);
+	    }
+	    for(size_t p = 0; p < pendingCount; ++p) {
+		_serve_pending_t * request = (pending + p);
+		if(request->client >= 0 && !_serve_flush(clients + request->client))
+		    _serve_close(clients, request->client, pending, pendingCount);
+		if(request->client < 0)
+		    continue;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		stats.latencies[stats.latencyCount++ % SERVE_LATENCY_WINDOW] = _serve_elapsed(&request->arrival, &now);
+		++stats.requests;
+		stats.points += request->count;
+	    }
+	    ++stats.batches;
+	    pendingCount = 0;
+	    batchPoints = 0;
+	}
+
+	/* Once no batch is pending, rejected clients get their error after all their earlier responses, and are closed once it is sent */
+	for(nfds_t f = 1; pendingCount == 0 && f < nfds; ++f) {
+	    _serve_client_t * client = (clients + fdClients[f]);
+	    if(client->fd >= 0 && client->rejected && !client->closing) {
+		serve_response_t response = { .status = SERVE_STATUS_ERR_SIZE, .count = 0 };
+		client->closing = 1;
+		if(!_serve_queue(client, &response, sizeof(response)) || !_serve_flush(client) || client->outLen == 0)
+		    _serve_close(clients, fdClients[f], pending, pendingCount);
+	    }
+	}
+
+	/* Periodic statistics while busy */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if(now.tv_sec - lastReport.tv_sec >= SERVE_STATS_INTERVAL) {
+	    if(stats.requests != reportedRequests)
+		_serve_report(&stats);
+	    reportedRequests = stats.requests;
+	    lastReport = now;
+	}
+    }
+    if(res == SERVE_OK)
+	_serve_report(&stats);
+
+    /* Closing everything down */
+    for(size_t i = 0; clients && i < SERVE_MAX_CLIENTS; ++i) {
+	if(clients[i].fd >= 0)
+	    _serve_close(clients, i, NULL, 0);
+    }
+    close(listenFd);
+    unlink(options->path);
+    util_infer_destroy(&infer);
+    free(points);
+    free(results);
+    free(wire);
+    free(pending);
+    free(clients);
+    free(fds);
+    free(fdClients);
+    free(stats.latencies);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    return res;
+}
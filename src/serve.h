@@ -0,0 +1,79 @@
+/**
+ * @file serve.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing a resident inference server over a Unix domain socket
+ *
+ * Protocol (all fields in the byte order of the server host): a client sends any number of requests over one connection,
+ * each a serve_request_t followed by 'count' points of net->inSize 32-bit floats, and gets one serve_response_t per request,
+ * in order, followed by 'count' results of net->outSize 32-bit floats if the status is SERVE_STATUS_OK.
+ */
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "network.h"
+
+/** Number of most recent request latencies kept for the percentile statistics */
+#define SERVE_LATENCY_WINDOW 65536
+/** Seconds between statistics reports while requests are coming in */
+#define SERVE_STATS_INTERVAL 10
+/** Maximum number of connected clients */
+#define SERVE_MAX_CLIENTS 1024
+/** Bytes of responses buffered for a client that isn't reading them, beyond which none of its requests are taken until it reads */
+#define SERVE_MAX_OUTPUT (1 << 20)
+
+/** Request header */
+typedef struct {
+    /** The number of points that follow */
+    uint32_t count;
+} serve_request_t;
+
+/** Response header */
+typedef struct {
+    /** The result status (serve_status_t) */
+    uint32_t status;
+    /** The number of results that follow */
+    uint32_t count;
+} serve_response_t;
+
+/** Response statuses */
+typedef enum {
+    /** Results follow */
+    SERVE_STATUS_OK = 0,
+    /** The request had more points than the server batch size, the connection is closed */
+    SERVE_STATUS_ERR_SIZE = 1,
+    /** The inference failed */
+    SERVE_STATUS_ERR_INFERENCE = 2
+} serve_status_t;
+
+/** Server options */
+typedef struct {
+    /** The socket path, replaced if a socket already exists there (any other file there is an error) */
+    char const * path;
+    /** The maximum number of points evaluated as one micro-batch, and so also per request */
+    size_t maxBatch;
+    /** Microseconds to wait for more requests to coalesce once one is pending, 0 to answer as soon as possible (lowest latency),
+     * higher values trade latency for fuller batches (throughput) */
+    long maxDelay;
+    /** The number of inference threads */
+    size_t threads;
+} serve_options_t;
+
+/** Server error types */
+typedef enum {
+    /** Success state, the server was shut down by a signal */
+    SERVE_OK = 0,
+    /** Error with function parameters */
+    SERVE_ERR_PARAM = 1,
+    /** Error setting up the socket */
+    SERVE_ERR_SOCKET = 2,
+    /** Error allocating memory */
+    SERVE_ERR_ALLOC = 3
+} serve_err_t;
+
+/** Serves inference on the given network until SIGINT or SIGTERM, printing request statistics periodically and at exit */
+serve_err_t serve_run(network_t * net, serve_options_t const * options);
+
+#endif /* SERVE_H */
@@ -1,4 +1,8 @@
 #include "set.h"
+#include "kernel.h"
+#include "prof.h"
+
+#include <time.h>
 
 set_err_t set_init(set_t * set, size_t size, size_t inSize, size_t outSize) {
     /* Checking parameters */
@@ -6,16 +10,14 @@ set_err_t set_init(set_t * set, size_t size, size_t inSize, size_t outSize) {
 	return SET_ERR_PARAM;
 
     /* Populating dataset params */
-    set->size = size;
-    set->inSize = inSize;
-    set->outSize = outSize;
+    *set = (set_t){ .size = size, .inSize = inSize, .outSize = outSize };
 
-    /* Allocating memory for inputs and outputs */
-    set->in = (matrix_t *)(malloc(set->size * sizeof(matrix_t)));
-    set->out = (matrix_t *)(malloc(set->size * sizeof(matrix_t)));
-    for(size_t i = 0; i < set->size; ++i) {
-	matrix_init((set->in + i), set->inSize, 1);
-	matrix_init((set->out + i), set->outSize, 1);
+    /* Allocating one zeroed block each for all inputs and all outputs */
+    set->in = (MATRIX_TYPE *)(calloc(size * inSize, sizeof(MATRIX_TYPE)));
+    set->out = (MATRIX_TYPE *)(calloc(size * outSize, sizeof(MATRIX_TYPE)));
+    if(!set->in || !set->out) {
+	set_destroy(set);
+	return SET_ERR;
     }
 
     return SET_OK;
@@ -26,17 +28,14 @@ set_err_t set_destroy(set_t * set) {
     if(!set)
 	return SET_ERR_PARAM;
 
-    /* Destroying dataset matrices */
-    for(size_t i = 0; i < set->size; ++i) {
-	matrix_destroy(set->in + i);
-	matrix_destroy(set->out + i);
+    /* Releasing the mapping or the allocated space for inputs and outputs */
+    if(set->mapping) {
+	munmap(set->mapping, set->mappingLen);
+    } else {
+	free(set->in);
+	free(set->out);
     }
-
-    /* Destroying allocated space for inputs and outputs */
-    free(set->in);
-    set->in = NULL;
-    free(set->out);
-    set->out = NULL;
+    *set = (set_t){0};
 
     return SET_OK;
 }
@@ -51,123 +50,838 @@ set_err_t set_setData(set_t * set, size_t idx, MATRIX_TYPE * inData, MATRIX_TYPE
 	return SET_ERR_IDX;
 
     /* Setting corresponding data */
-    for(size_t i = 0; i < set->inSize; ++i) {
-	matrix_set((set->in + idx), i, 0, inData[i]);
+    memcpy(set->in + idx * set->inSize, inData, set->inSize * sizeof(MATRIX_TYPE));
+    memcpy(set->out + idx * set->outSize, outData, set->outSize * sizeof(MATRIX_TYPE));
+    return SET_OK;
+}
+
+matrix_t set_inView(set_t const * set, size_t idx) {
+    return (matrix_t){ .data = set->in + idx * set->inSize, .dataLen = set->inSize, .rows = set->inSize, .cols = 1 };
+}
+
+matrix_t set_outView(set_t const * set, size_t idx) {
+    return (matrix_t){ .data = set->out + idx * set->outSize, .dataLen = set->outSize, .rows = set->outSize, .cols = 1 };
+}
+
+set_err_t set_train_sample(set_t * set, network_t * net, network_tracker_t * tracker, network_workspace_t * ws, matrix_t * out, size_t idx, optim_t * optim) {
+    /* Checking given params */
+    if(!set || !net || !tracker || !ws || !out || !optim || set->inSize != net->inSize || set->outSize != net->outSize)
+	return SET_ERR_PARAM;
+    if(idx >= set->size)
+	return SET_ERR_IDX;
+
+    /* Running inference with tracking */
+    matrix_t in = set_inView(set, idx);
+    if(network_inference_ws(net, ws, &in, out, tracker) != NETWORK_OK)
+	return SET_ERR_TRAIN;
+    PROF_LOSS(out->data, set->out + idx * set->outSize, set->outSize);
+
+    /* Output layer error derivatives, the activation derivatives (from the tracked activated values) times the local errors */
+    PROF_BEGIN(outStart);
+    size_t outIdx = net->depth - 1;
+    size_t outLen = net->weights[outIdx].rows;
+    MATRIX_TYPE * errD = ws->err[outIdx % 2];
+    memcpy(errD, tracker->post[outIdx], outLen * sizeof(MATRIX_TYPE));
+    matrix_t errView = { .data = errD, .dataLen = outLen, .rows = outLen, .cols = 1 };
+    PROF_BEGIN(outActStart);
+    net->activations[outIdx].dfa(&errView);
+    PROF_END(outActStart, PROF_ACTIVATION, outIdx);
+    for(size_t nodeIdx = 0; nodeIdx < outLen; ++nodeIdx)
+	errD[nodeIdx] *= set->out[idx * set->outSize + nodeIdx] - out->data[nodeIdx];
+    PROF_END(outStart, PROF_BACKWARD, outIdx);
+    kernel_optim_t step = optim_step(optim);
+
+    /* Walking back through the layers, each propagating its error derivatives below through its weights before correcting them,
+     * keeping the error derivatives of the current and the lower layer in the two workspace buffers */
+    for(size_t layerIdx = net->depth; layerIdx-- > 0; ) {
+	matrix_t * weights = (net->weights + layerIdx);
+	MATRIX_TYPE const * prevVals = (layerIdx > 0 ? tracker->post[layerIdx-1] : in.data);
+	MATRIX_TYPE * prevErrD = NULL;
+	if(layerIdx > 0) {
+	    /* Lower layer error derivatives, (W^T errD) times the lower layer's activation derivatives */
+	    PROF_BEGIN(backStart);
+	    prevErrD = ws->err[(layerIdx - 1) % 2];
+	    matrix_gemv(MATRIX_TRANS, weights->rows, weights->cols, 1, weights->data, weights->cols, errD, 0, prevErrD);
+	    MATRIX_TYPE * derivative = ws->act[0];
+	    memcpy(derivative, prevVals, weights->cols * sizeof(MATRIX_TYPE));
+	    errView = (matrix_t){ .data = derivative, .dataLen = weights->cols, .rows = weights->cols, .cols = 1 };
+	    PROF_BEGIN(actStart);
+	    net->activations[layerIdx-1].dfa(&errView);
+	    PROF_END(actStart, PROF_ACTIVATION, layerIdx - 1);
+	    kernel.mul(weights->cols, derivative, prevErrD);
+	    PROF_END(backStart, PROF_BACKWARD, layerIdx);
+	    PROF_COUNT(PROF_BACKWARD, layerIdx, 2 * weights->rows * weights->cols + weights->cols,
+		       (weights->rows * weights->cols + weights->rows + 3 * weights->cols) * sizeof(MATRIX_TYPE));
+	}
+
+	/* Changing the weights of every node, each row's corrections being the activated values of the layer below scaled by the node's error derivative,
+	 * and the biases */
+	PROF_BEGIN(updateStart);
+	for(size_t nodeIdx = 0; nodeIdx < weights->rows; ++nodeIdx)
+	    optim_apply(optim, &step, net, layerIdx, 0, nodeIdx * weights->cols, weights->cols, errD[nodeIdx], prevVals);
+	optim_apply(optim, &step, net, layerIdx, 1, 0, weights->rows, 1, errD);
+	PROF_END(updateStart, PROF_UPDATE, layerIdx);
+	PROF_COUNT(PROF_UPDATE, layerIdx, 2 * (weights->rows * weights->cols + weights->rows),
+		   (2 * weights->rows * weights->cols + weights->cols + 3 * weights->rows) * sizeof(MATRIX_TYPE));
+	errD = prevErrD;
+    }
+
+    return SET_OK;
+}
+
+set_err_t set_train_i(set_t * set, network_t * net, network_tracker_t * tracker, network_workspace_t * ws, matrix_t * out, optim_t * optim) {
+    /* Checking given params */
+    if(!set)
+	return SET_ERR_PARAM;
+
+    /* Executing inference and correcting weights for every data point in set */
+    set_err_t res = SET_OK;
+    for(size_t idx = 0; idx < set->size && res == SET_OK; ++idx)
+	res = set_train_sample(set, net, tracker, ws, out, idx, optim);
+    return res;
+}
+
+set_err_t set_batch_init(set_batch_t * batch, network_t * net, size_t capacity) {
+    /* Checking parameters */
+    if(!batch || !net || capacity == 0)
+	return SET_ERR_PARAM;
+
+    *batch = (set_batch_t){0};
+    batch->capacity = capacity;
+    batch->depth = net->depth;
+    batch->act = (matrix_t *)(calloc(net->depth, sizeof(matrix_t)));
+    batch->grad = (matrix_t *)(calloc(net->depth, sizeof(matrix_t)));
+    batch->biasGrad = (matrix_t *)(calloc(net->depth, sizeof(matrix_t)));
+    if(!batch->act || !batch->grad || !batch->biasGrad)
+	return SET_ERR;
+
+    /* Allocating the batch matrices, the per-layer outputs and the per-layer corrections */
+    if(matrix_init(&batch->in, net->inSize, capacity) != MATRIX_OK || matrix_init(&batch->target, net->outSize, capacity) != MATRIX_OK)
+	return SET_ERR;
+    for(size_t i = 0; i < net->depth; ++i) {
+	matrix_t * weights = (net->weights + i);
+	if(matrix_init((batch->act + i), weights->rows, capacity) != MATRIX_OK || matrix_init((batch->grad + i), weights->rows, weights->cols) != MATRIX_OK
+	   || matrix_init((batch->biasGrad + i), weights->rows, 1) != MATRIX_OK)
+	    return SET_ERR;
     }
-    for(size_t i = 0; i < set->outSize; ++i) {
-	matrix_set((set->out + idx), i, 0, outData[i]);
+    if(network_workspace_initBatch(&batch->ws, net, capacity) != NETWORK_OK)
+	return SET_ERR;
+    return SET_OK;
+}
+
+set_err_t set_batch_destroy(set_batch_t * batch) {
+    if(!batch)
+	return SET_ERR_PARAM;
+    matrix_destroy(&batch->in);
+    matrix_destroy(&batch->target);
+    for(size_t i = 0; i < batch->depth; ++i) {
+	if(batch->act)
+	    matrix_destroy(batch->act + i);
+	if(batch->grad)
+	    matrix_destroy(batch->grad + i);
+	if(batch->biasGrad)
+	    matrix_destroy(batch->biasGrad + i);
     }
+    free(batch->act);
+    free(batch->grad);
+    free(batch->biasGrad);
+    network_workspace_destroy(&batch->ws);
+    *batch = (set_batch_t){0};
     return SET_OK;
 }
 
-set_err_t set_train_i(set_t * set, network_t * net, network_tracker_t * tracker, matrix_t * out, float learnRate) {
+set_err_t set_batch_gradient(set_batch_t * batch, set_t * set, network_t * net, size_t start, size_t count) {
     /* Checking given params */
-    if(!set || !net || !tracker || !out || set->inSize != net->inSize || set->outSize != net->outSize)
+    if(!batch || !set || !net || set->inSize != net->inSize || set->outSize != net->outSize || batch->depth != net->depth)
 	return SET_ERR_PARAM;
+    if(count == 0 || count > batch->capacity || start + count > set->size)
+	return SET_ERR_IDX;
 
-    matrix_t tmpVal = {0};
-    matrix_init(&tmpVal, 1, 1);
+    /* Gathering the samples as columns, densely packed (row stride = count) */
+    MATRIX_TYPE const * in = set->in + start * set->inSize;
+    MATRIX_TYPE const * target = set->out + start * set->outSize;
+    for(size_t c = 0; c < count; ++c) {
+	for(size_t r = 0; r < set->inSize; ++r)
+	    batch->in.data[r * count + c] = in[c * set->inSize + r];
+	for(size_t r = 0; r < set->outSize; ++r)
+	    batch->target.data[r * count + c] = target[c * set->outSize + r];
+    }
 
-    /* Executing inference and correcting weights for every data point in set */
-    for(size_t idx = 0; idx < set->size; ++idx) {
+    /* Forward pass, keeping the activated output of every layer */
+    size_t last = net->depth - 1;
+    matrix_t inView = { .data = batch->in.data, .dataLen = net->inSize * count, .rows = net->inSize, .cols = count };
+    matrix_t outView = { .data = batch->act[last].data, .dataLen = net->outSize * count, .rows = net->outSize, .cols = count };
+    if(network_inference_batch(net, &batch->ws, &inView, &outView, batch->act) != NETWORK_OK)
+	return SET_ERR_TRAIN;
+    PROF_LOSS(outView.data, batch->target.data, net->outSize * count);
 
-	/* Running inference with tracking */
-	if(network_inference_track(net, (set->in + idx), out, tracker) != NETWORK_OK)
-	    return SET_ERR_TRAIN;
+    /* Output layer error derivatives, D = (expected - output) * f'(output) */
+    PROF_BEGIN(outStart);
+    MATRIX_TYPE * errD = batch->ws.err[last % 2];
+    size_t len = net->outSize * count;
+    for(size_t i = 0; i < len; ++i)
+	errD[i] = outView.data[i];
+    matrix_t errView = { .data = errD, .dataLen = len, .rows = net->outSize, .cols = count };
+    PROF_BEGIN(outActStart);
+    net->activations[last].dfa(&errView);
+    PROF_END(outActStart, PROF_ACTIVATION, last);
+    for(size_t i = 0; i < len; ++i)
+	errD[i] *= (batch->target.data[i] - outView.data[i]);
+    PROF_END(outStart, PROF_BACKWARD, last);
 
-	/* Correcting weights */
-	MATRIX_TYPE * prevErrD = (MATRIX_TYPE *)(malloc(tracker->layers[net->depth-1] * sizeof(MATRIX_TYPE)));
-	/* Output layer weights */
-	for(size_t nodeIdx = 0; nodeIdx < tracker->layers[net->depth-1]; ++nodeIdx) {
-	    /* Getting local error */
-	    MATRIX_TYPE realOut, dOut, localErr;
-	    matrix_get(out, nodeIdx, 0, &realOut);
-	    matrix_get((set->out + idx), nodeIdx, 0, &dOut);
-	    localErr = dOut - realOut;
-	    /* Getting value activated using activation derivative */
-	    matrix_set(&tmpVal, 0, 0, tracker->layerData[net->depth-1][nodeIdx][0]);
-	    net->activations[net->depth-1].df(&tmpVal);
-	    MATRIX_TYPE derivativeVal;
-	    matrix_get(&tmpVal, 0, 0, &derivativeVal);
-	    /* Getting the output node's error function derivative value */
-	    prevErrD[nodeIdx] = localErr * derivativeVal;
-
-	    /* Changing weights to current output node */
-	    for(size_t weightIdx = 0; weightIdx < tracker->layers[net->depth-2]; ++weightIdx) {
-		MATRIX_TYPE deltaWeight = learnRate * prevErrD[nodeIdx] * tracker->layerData[net->depth-2][weightIdx][1];
-		MATRIX_TYPE weight;
-		matrix_get((net->weights + net->depth - 1), nodeIdx, weightIdx, &weight);
-		matrix_set((net->weights + net->depth - 1), nodeIdx, weightIdx, (weight + deltaWeight));
-	    }
+    /* Walking back through the layers */
+    for(size_t layerIdx = last; ; --layerIdx) {
+	matrix_t * weights = (net->weights + layerIdx);
+	PROF_BEGIN(backStart);
+	MATRIX_TYPE const * prevAct = (layerIdx > 0 ? batch->act[layerIdx - 1].data : batch->in.data);
+
+	/* Weight corrections summed over the batch, G = D * prevAct^T, and bias corrections, the row sums of D */
+	matrix_gemm(MATRIX_NOTRANS, MATRIX_TRANS, weights->rows, weights->cols, count,
+		    1, errD, count, prevAct, count, 0, batch->grad[layerIdx].data, weights->cols);
+	for(size_t r = 0; r < weights->rows; ++r) {
+	    MATRIX_TYPE sum = 0;
+	    for(size_t c = 0; c < count; ++c)
+		sum += errD[r * count + c];
+	    batch->biasGrad[layerIdx].data[r] = sum;
 	}
-	/* All hidden layer weights */
-	for(int32_t layerIdx = (net->depth - 2); layerIdx >= 0; --layerIdx) {
-	    /* Getting local data for temporary current layer error function derivative values */
-	    MATRIX_TYPE * tmpErrD = (MATRIX_TYPE *)(malloc(tracker->layers[layerIdx] * sizeof(MATRIX_TYPE)));
-	    /* Going through each node in the current layer */
-	    for(size_t nodeIdx = 0; nodeIdx < tracker->layers[layerIdx]; ++nodeIdx) {
-		/* Getting value activated using activation derivative */
-		matrix_set(&tmpVal, 0, 0, tracker->layerData[layerIdx][nodeIdx][0]);
-		net->activations[layerIdx].df(&tmpVal);
-		MATRIX_TYPE derivativeVal;
-		matrix_get(&tmpVal, 0, 0, &derivativeVal);
-		/* Getting sum of weights multiplied by previous error derivative values */
-		MATRIX_TYPE prevSum = 0;
-		for(size_t k = 0; k < (layerIdx + 1); ++k) {
-		    MATRIX_TYPE weight;
-		    matrix_get((net->weights + layerIdx + 1), k, nodeIdx, &weight);
-		    prevSum += prevErrD[k] * weight;
-		}
-		/* Getting the current node's error function derivative value */
-		tmpErrD[nodeIdx] = derivativeVal * prevSum;
-
-		/* Changing weights to current node */
-		size_t weightCount = (layerIdx > 0 ? tracker->layers[layerIdx-1] : net->inSize);
-		for(size_t weightIdx = 0; weightIdx < weightCount; ++weightIdx) {
-		    MATRIX_TYPE prevVal;
-		    if(layerIdx > 0)
-			prevVal = tracker->layerData[layerIdx-1][weightIdx][1];
-		    else
-			matrix_get((set->in + idx), weightIdx, 0, &prevVal);
-		    MATRIX_TYPE deltaWeight = learnRate * tmpErrD[nodeIdx] * prevVal;
-		    MATRIX_TYPE weight;
-		    matrix_get((net->weights + layerIdx), nodeIdx, weightIdx, &weight);
-		    matrix_set((net->weights + layerIdx), nodeIdx, weightIdx, (weight + deltaWeight));
-		}
-	    }
-	    /* Changing the previous error derivative value to the current tmp one */
-	    free(prevErrD);
-	    prevErrD = tmpErrD;
+	PROF_COUNT(PROF_BACKWARD, layerIdx, (2 * weights->cols + 1) * weights->rows * count,
+		   (weights->rows * weights->cols + (weights->rows + weights->cols) * count + weights->rows) * sizeof(MATRIX_TYPE));
+	if(layerIdx == 0) {
+	    PROF_END(backStart, PROF_BACKWARD, layerIdx);
+	    break;
 	}
 
-	free(prevErrD);
+	/* Error derivatives of the layer below, D' = (W^T * D) * f'(prevAct) */
+	MATRIX_TYPE * prevErrD = batch->ws.err[(layerIdx - 1) % 2];
+	matrix_gemm(MATRIX_TRANS, MATRIX_NOTRANS, weights->cols, count, weights->rows,
+		    1, weights->data, weights->cols, errD, count, 0, prevErrD, count);
+	size_t prevLen = weights->cols * count;
+	MATRIX_TYPE * derivative = batch->ws.act[0];
+	for(size_t i = 0; i < prevLen; ++i)
+	    derivative[i] = prevAct[i];
+	errView = (matrix_t){ .data = derivative, .dataLen = prevLen, .rows = weights->cols, .cols = count };
+	PROF_BEGIN(actStart);
+	net->activations[layerIdx - 1].dfa(&errView);
+	PROF_END(actStart, PROF_ACTIVATION, layerIdx - 1);
+	kernel.mul(prevLen, derivative, prevErrD);
+	PROF_END(backStart, PROF_BACKWARD, layerIdx);
+	PROF_COUNT(PROF_BACKWARD, layerIdx, (2 * weights->rows + 1) * weights->cols * count,
+		   (weights->rows * weights->cols + (weights->rows + 3 * weights->cols) * count) * sizeof(MATRIX_TYPE));
+	errD = prevErrD;
     }
+    return SET_OK;
+}
+
+set_err_t set_train_batch(set_t * set, network_t * net, set_batch_t * batch, optim_t * optim) {
+    /* Checking given params */
+    if(!set || !net || !batch || !optim)
+	return SET_ERR_PARAM;
+
+    for(size_t start = 0; start < set->size; start += batch->capacity) {
+	size_t count = (set->size - start < batch->capacity ? set->size - start : batch->capacity);
+	set_err_t res = set_batch_gradient(batch, set, net, start, count);
+	if(res != SET_OK)
+	    return res;
+	/* Applying the batch-averaged corrections */
+	kernel_optim_t step = optim_step(optim);
+	for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+	    PROF_BEGIN(updateStart);
+	    optim_apply(optim, &step, net, layerIdx, 0, 0, net->weights[layerIdx].dataLen, (MATRIX_TYPE)(1) / count, batch->grad[layerIdx].data);
+	    optim_apply(optim, &step, net, layerIdx, 1, 0, net->biases[layerIdx].dataLen, (MATRIX_TYPE)(1) / count, batch->biasGrad[layerIdx].data);
+	    PROF_END(updateStart, PROF_UPDATE, layerIdx);
+	    PROF_COUNT(PROF_UPDATE, layerIdx, 2 * (net->weights[layerIdx].dataLen + net->biases[layerIdx].dataLen),
+		       3 * (net->weights[layerIdx].dataLen + net->biases[layerIdx].dataLen) * sizeof(MATRIX_TYPE));
+	}
+    }
+    return SET_OK;
+}
+
+/** Shared state of a data-parallel training iteration */
+typedef struct {
+    set_t * set;
+    network_t * net;
+    set_batch_t * batches;
+    /** The samples of the current step */
+    size_t start, count;
+    /** The optimizer, and its hyperparameters for the current step */
+    optim_t * optim;
+    kernel_optim_t step;
+    /** Result of each worker's part of the step */
+    set_err_t * results;
+} _set_parallel_t;
+
+/** Pool task, computes the corrections of one worker's shard of the current step */
+static void _set_parallelGradient(void * arg, size_t worker, size_t workers) {
+    _set_parallel_t * par = (_set_parallel_t *)arg;
+    set_batch_t * batch = (par->batches + worker);
+    size_t start, end;
+    pool_split(par->count, worker, workers, &start, &end);
+    if(end > start) {
+	par->results[worker] = set_batch_gradient(batch, par->set, par->net, par->start + start, end - start);
+	return;
+    }
+    /* An empty shard contributes nothing to the sum */
+    for(size_t layerIdx = 0; layerIdx < batch->depth; ++layerIdx) {
+	for(size_t i = 0; i < batch->grad[layerIdx].dataLen; ++i)
+	    batch->grad[layerIdx].data[i] = 0;
+	for(size_t i = 0; i < batch->biasGrad[layerIdx].dataLen; ++i)
+	    batch->biasGrad[layerIdx].data[i] = 0;
+    }
+    par->results[worker] = SET_OK;
+}
+
+/** Pool task, sums one worker's slice of all weight and bias corrections over the workers in worker order and applies it */
+static void _set_parallelApply(void * arg, size_t worker, size_t workers) {
+    _set_parallel_t * par = (_set_parallel_t *)arg;
+    network_t * net = par->net;
+
+    /* Finding the slice of the flattened parameters (the weights then the biases of every layer) belonging to this worker */
+    size_t total = 0;
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx)
+	total += (net->weights + layerIdx)->dataLen + (net->biases + layerIdx)->dataLen;
+    size_t start, end;
+    pool_split(total, worker, workers, &start, &end);
+
+    PROF_BEGIN(updateStart);
+    size_t offset = 0;
+    for(size_t seg = 0; seg < 2 * net->depth && offset < end; ++seg) {
+	size_t layerIdx = seg / 2;
+	int bias = (seg % 2 == 1);
+	matrix_t * param = (bias ? net->biases : net->weights) + layerIdx;
+	size_t len = param->dataLen;
+	size_t lo = (start > offset ? start - offset : 0);
+	size_t hi = (end - offset < len ? end - offset : len);
+	if(lo < hi) {
+	    MATRIX_TYPE * sum = (bias ? par->batches[0].biasGrad : par->batches[0].grad)[layerIdx].data + lo;
+	    for(size_t w = 1; w < workers; ++w)
+		kernel.add(hi - lo, (bias ? par->batches[w].biasGrad : par->batches[w].grad)[layerIdx].data + lo, sum);
+	    optim_apply(par->optim, &par->step, net, layerIdx, bias, lo, hi - lo, (MATRIX_TYPE)(1) / par->count, sum);
+	    PROF_COUNT(PROF_UPDATE, layerIdx, (workers + 1) * (hi - lo), (workers + 2) * (hi - lo) * sizeof(MATRIX_TYPE));
+	}
+	offset += len;
+    }
+    PROF_END(updateStart, PROF_UPDATE, PROF_NO_LAYER);
+}
 
-    matrix_destroy(&tmpVal);
+set_err_t set_train_parallel(set_t * set, network_t * net, pool_t * pool, set_batch_t * batches, size_t batchSize, optim_t * optim) {
+    /* Checking given params */
+    if(!set || !net || !pool || !batches || !optim || batchSize == 0)
+	return SET_ERR_PARAM;
+
+    set_err_t results [pool->size];
+    _set_parallel_t par = { .set = set, .net = net, .batches = batches, .optim = optim, .results = results };
+    for(par.start = 0; par.start < set->size; par.start += batchSize) {
+	par.count = (set->size - par.start < batchSize ? set->size - par.start : batchSize);
 
+	/* Corrections of every shard, then the reduction and update once all of them are done */
+	pool_run(pool, _set_parallelGradient, &par);
+	for(size_t w = 0; w < pool->size; ++w) {
+	    if(results[w] != SET_OK)
+		return results[w];
+	}
+	par.step = optim_step(optim);
+	pool_run(pool, _set_parallelApply, &par);
+    }
     return SET_OK;
 }
 
-set_err_t set_train(set_t * set, network_t * net, size_t * layers, float learnRate, size_t iterations) {
+/** Shared state of an asynchronous training run */
+typedef struct {
+    set_t * set;
+    network_t * net;
+    size_t * layers;
+    size_t iterations;
+    optim_t * optim;
+    /** Result of each worker's part of the run */
+    set_err_t * results;
+} _set_async_t;
+
+/** Pool task, trains all iterations on one worker's part of the set with its own scratch space */
+static void _set_asyncTrain(void * arg, size_t worker, size_t workers) {
+    _set_async_t * async = (_set_async_t *)arg;
+    network_t * net = async->net;
+    size_t start, end;
+    pool_split(async->set->size, worker, workers, &start, &end);
 
-    /* Setting up network tracker */
     network_tracker_t tracker = {0};
-    network_tracker_init(&tracker, net->depth, layers);
+    matrix_t out = {0};
+    network_workspace_t ws = {0};
+    set_err_t res = SET_OK;
+    if(network_tracker_init(&tracker, net->depth, async->layers) != NETWORK_OK || matrix_init(&out, net->outSize, 1) != MATRIX_OK
+       || network_workspace_init(&ws, net) != NETWORK_OK || !out.data)
+	res = SET_ERR_TRAIN;
+
+    /* Updates of the other workers become visible whenever they happen to, no barrier between iterations */
+    for(size_t itCount = 0; itCount < async->iterations && res == SET_OK; ++itCount) {
+	for(size_t idx = start; idx < end && res == SET_OK; ++idx)
+	    res = set_train_sample(async->set, net, &tracker, &ws, &out, idx, async->optim);
+    }
+    async->results[worker] = res;
+
+    network_tracker_destroy(&tracker);
+    network_workspace_destroy(&ws);
+    matrix_destroy(&out);
+}
+
+set_err_t set_train_async(set_t * set, network_t * net, size_t * layers, pool_t * pool, size_t iterations, optim_t * optim) {
+    /* Checking given params */
+    if(!set || !net || !layers || !pool || !optim)
+	return SET_ERR_PARAM;
+
+    set_err_t results [pool->size];
+    _set_async_t async = { .set = set, .net = net, .layers = layers, .iterations = iterations, .optim = optim, .results = results };
+    pool_run(pool, _set_asyncTrain, &async);
+    for(size_t w = 0; w < pool->size; ++w) {
+	if(results[w] != SET_OK)
+	    return results[w];
+    }
+    return SET_OK;
+}
+
+/** Adds the squared errors over every output of every sample of the set to 'sum' */
+static set_err_t _set_lossSum(set_t * set, network_t * net, network_workspace_t * ws, matrix_t * out, double * sum) {
+    for(size_t idx = 0; idx < set->size; ++idx) {
+	matrix_t in = set_inView(set, idx);
+	if(network_inference_ws(net, ws, &in, out, NULL) != NETWORK_OK)
+	    return SET_ERR_TRAIN;
+	for(size_t i = 0; i < net->outSize; ++i) {
+	    double diff = out->data[i] - set->out[idx * set->outSize + i];
+	    *sum += diff * diff;
+	}
+    }
+    return SET_OK;
+}
+
+set_err_t set_loss(set_t * set, network_t * net, MATRIX_TYPE * loss) {
+    /* Checking given params */
+    if(!set || !net || !loss || set->inSize != net->inSize || set->outSize != net->outSize)
+	return SET_ERR_PARAM;
 
-    /* Setting up output matrix */
     matrix_t out = {0};
-    matrix_init(&out, net->outSize, 1);
+    if(matrix_init(&out, net->outSize, 1) != MATRIX_OK || !out.data)
+	return SET_ERR;
+    network_workspace_t ws = {0};
+    if(network_workspace_init(&ws, net) != NETWORK_OK) {
+	matrix_destroy(&out);
+	return SET_ERR_TRAIN;
+    }
+
+    /* Summing squared errors over every output of every sample */
+    double sum = 0;
+    set_err_t res = _set_lossSum(set, net, &ws, &out, &sum);
+    *loss = (set->size > 0 ? sum / (set->size * net->outSize) : 0);
+
+    network_workspace_destroy(&ws);
+    matrix_destroy(&out);
+    return res;
+}
 
-    /* Running X iterations of training */
-    for(size_t itCount = 0; itCount < iterations; ++itCount) {
-	set_err_t res = set_train_i(set, net, &tracker, &out, learnRate);
+set_err_t set_loss_source(set_source_t * source, network_t * net, MATRIX_TYPE * loss) {
+    /* Checking given params */
+    if(!source || !net || !loss || source->inSize != net->inSize || source->outSize != net->outSize)
+	return SET_ERR_PARAM;
+
+    matrix_t out = {0};
+    if(matrix_init(&out, net->outSize, 1) != MATRIX_OK || !out.data)
+	return SET_ERR;
+    network_workspace_t ws = {0};
+    if(network_workspace_init(&ws, net) != NETWORK_OK) {
+	matrix_destroy(&out);
+	return SET_ERR_TRAIN;
+    }
+
+    /* Summing squared errors chunk by chunk over one pass */
+    double sum = 0;
+    size_t count = 0;
+    set_err_t res = SET_OK;
+    for(;;) {
+	set_t * chunk = NULL;
+	res = source->next(source->source, &chunk);
+	if(res != SET_OK || !chunk)
+	    break;
+	res = _set_lossSum(chunk, net, &ws, &out, &sum);
 	if(res != SET_OK)
-	    return res;
+	    break;
+	count += chunk->size;
     }
+    *loss = (count > 0 ? sum / (count * net->outSize) : 0);
 
-    /* Freeing allocated resources */
-    network_tracker_destroy(&tracker);
+    network_workspace_destroy(&ws);
     matrix_destroy(&out);
+    return res;
+}
+
+/** Trivial source handing out a whole in-memory set as a single chunk every pass */
+typedef struct {
+    set_t * set;
+    /** Whether the set was handed out in the current pass */
+    int given;
+} _set_memory_t;
+
+static set_err_t _set_memoryNext(void * source, set_t ** chunk) {
+    _set_memory_t * memory = (_set_memory_t *)source;
+    *chunk = (memory->given ? NULL : memory->set);
+    memory->given = !memory->given;
+    return SET_OK;
+}
+
+/** Early stopping state of a training run */
+typedef struct {
+    set_options_t const * options;
+    network_t * net;
+    /** The in-memory training data evaluated (a view of the start of the set), NULL to evaluate a pass over the source instead */
+    set_t * trainSet;
+    set_t trainView;
+    set_source_t * source;
+    /** Start of training */
+    struct timespec start;
+    /** Evaluations since the best loss last improved */
+    size_t sinceBest;
+    /** The weights and biases of every layer at the best evaluation (keepBest only) */
+    MATRIX_TYPE * best;
+    set_result_t result;
+    /** The optimizer, and the checkpoint writer if checkpointing (its buffer then being set) */
+    optim_t * optim;
+    checkpoint_t checkpoint;
+    /** Whether a checkpoint is due, the writer having been busy when it was, and the iteration of the last one taken */
+    int due;
+    size_t checkpointed;
+} _set_monitor_t;
+
+/** Returns the number of weights and biases of the network */
+static size_t _set_paramCount(network_t const * net) {
+    size_t total = 0;
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx)
+	total += net->weights[layerIdx].dataLen + net->biases[layerIdx].dataLen;
+    return total;
+}
+
+/** Copies the weights and biases of every layer into a flat buffer, or back from it if 'restore' is set (re-rounding the reduced precision copies) */
+static void _set_copyParams(network_t * net, MATRIX_TYPE * buffer, int restore) {
+    for(size_t layerIdx = 0; layerIdx < net->depth; ++layerIdx) {
+	matrix_t * params [2] = { net->weights + layerIdx, net->biases + layerIdx };
+	for(size_t p = 0; p < 2; ++p) {
+	    if(restore)
+		memcpy(params[p]->data, buffer, params[p]->dataLen * sizeof(MATRIX_TYPE));
+	    else
+		memcpy(buffer, params[p]->data, params[p]->dataLen * sizeof(MATRIX_TYPE));
+	    buffer += params[p]->dataLen;
+	}
+	if(restore)
+	    network_syncWeights(net, layerIdx, 0, net->weights[layerIdx].dataLen);
+    }
+}
+
+/** Prepares early stopping and checkpointing for training on an in-memory set, or on a chunked source if 'set' is NULL,
+ * restoring the network, the optimizer and the progress if resuming */
+static set_err_t _set_monitorInit(_set_monitor_t * monitor, network_t * net, optim_t * optim, set_options_t const * options, set_t * set,
+				  set_source_t * source) {
+    *monitor = (_set_monitor_t){ .options = options, .net = net, .source = source, .optim = optim };
+    clock_gettime(CLOCK_MONOTONIC, &monitor->start);
+    if(options->validation && (options->validation->inSize != net->inSize || options->validation->outSize != net->outSize))
+	return SET_ERR_PARAM;
+    if(set) {
+	monitor->trainView = (set_t){ .in = set->in, .out = set->out, .size = set->size, .inSize = set->inSize, .outSize = set->outSize };
+	if(options->evalSamples > 0 && options->evalSamples < set->size)
+	    monitor->trainView.size = options->evalSamples;
+	monitor->trainSet = &monitor->trainView;
+    }
+    if(options->keepBest && options->evalEvery > 0) {
+	monitor->best = (MATRIX_TYPE *)(malloc(_set_paramCount(net) * sizeof(MATRIX_TYPE)));
+	if(!monitor->best)
+	    return SET_ERR;
+    }
+    if(options->resume) {
+	checkpoint_progress_t progress;
+	if(checkpoint_load(options->resume, net, optim, monitor->best, &progress) != CHECKPOINT_OK)
+	    return SET_ERR;
+	set_result_t * result = &monitor->result;
+	result->iterations = result->resumed = monitor->checkpointed = progress.iterations;
+	result->evaluations = progress.evaluations;
+	result->loss = (MATRIX_TYPE)(progress.loss);
+	result->bestLoss = (MATRIX_TYPE)(progress.bestLoss);
+	result->bestIteration = progress.bestIteration;
+	monitor->sinceBest = progress.sinceBest;
+    }
+    if(options->checkpoint && checkpoint_open(&monitor->checkpoint, options->checkpoint, net, optim, (monitor->best != NULL)) != CHECKPOINT_OK)
+	return SET_ERR;
+    return SET_OK;
+}
+
+/** Hands a snapshot of the training state to the checkpoint writer, CHECKPOINT_BUSY if it is still writing the previous one */
+static checkpoint_err_t _set_monitorCheckpoint(_set_monitor_t * monitor) {
+    set_result_t const * result = &monitor->result;
+    checkpoint_progress_t progress = { .iterations = result->iterations, .seed = monitor->options->seed, .evaluations = result->evaluations,
+				       .sinceBest = monitor->sinceBest, .bestIteration = result->bestIteration,
+				       .loss = result->loss, .bestLoss = result->bestLoss };
+    checkpoint_err_t res = checkpoint_snapshot(&monitor->checkpoint, monitor->net, monitor->optim, monitor->best, &progress);
+    if(res == CHECKPOINT_OK)
+	monitor->checkpointed = result->iterations;
+    return res;
+}
+
+/** Ends an iteration of training, evaluating the loss if due, and sets 'stop' if training should end */
+static set_err_t _set_monitorIteration(_set_monitor_t * monitor, size_t iterations, int * stop) {
+    set_options_t const * options = monitor->options;
+    set_result_t * result = &monitor->result;
+    result->iterations = iterations;
+
+    if(options->evalEvery > 0 && (iterations % options->evalEvery == 0 || iterations == options->iterations)) {
+	/* The training loss (over a whole pass of a source only when there is no held-out loss to decide instead), and the held-out loss */
+	MATRIX_TYPE trainLoss = 0, heldLoss = 0;
+	int hasTrain = (monitor->trainSet || !options->validation);
+	set_err_t res = SET_OK;
+	if(monitor->trainSet)
+	    res = set_loss(monitor->trainSet, monitor->net, &trainLoss);
+	else if(!options->validation)
+	    res = set_loss_source((options->evalSource ? options->evalSource : monitor->source), monitor->net, &trainLoss);
+	if(res == SET_OK && options->validation)
+	    res = set_loss(options->validation, monitor->net, &heldLoss);
+	if(res != SET_OK)
+	    return res;
+	MATRIX_TYPE loss = (options->validation ? heldLoss : trainLoss);
 
+	/* Keeping track of the best loss, only improvements by more than minDelta counting */
+	int improved = (result->evaluations == 0 || loss < result->bestLoss - options->minDelta);
+	++result->evaluations;
+	result->loss = loss;
+	if(improved) {
+	    result->bestLoss = loss;
+	    result->bestIteration = iterations;
+	    monitor->sinceBest = 0;
+	    if(monitor->best)
+		_set_copyParams(monitor->net, monitor->best, 0);
+	} else {
+	    ++monitor->sinceBest;
+	}
+	if(options->log) {
+	    fprintf(options->log, "Iteration %lu:", iterations);
+	    if(hasTrain)
+		fprintf(options->log, " loss %g", trainLoss);
+	    if(options->validation)
+		fprintf(options->log, "%s held-out loss %g", (hasTrain ? "," : ""), heldLoss);
+	    fprintf(options->log, "%s\n", (improved ? " (best)" : ""));
+	}
+
+	if(options->lossTarget > 0 && loss <= options->lossTarget) {
+	    result->stop = SET_STOP_TARGET;
+	    *stop = 1;
+	} else if(options->patience > 0 && monitor->sinceBest >= options->patience) {
+	    result->stop = SET_STOP_PATIENCE;
+	    *stop = 1;
+	}
+    }
+
+    if(!*stop && options->timeBudget > 0) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if((now.tv_sec - monitor->start.tv_sec) + (now.tv_nsec - monitor->start.tv_nsec) * 1e-9 >= options->timeBudget) {
+	    result->stop = SET_STOP_TIME;
+	    *stop = 1;
+	}
+    }
+
+    /* A due checkpoint is only copied out, and tried again after the next iteration while the previous one is still being written */
+    if(monitor->checkpoint.buffer && options->checkpointEvery > 0 && iterations % options->checkpointEvery == 0)
+	monitor->due = 1;
+    if(monitor->due && !*stop && iterations < options->iterations) {
+	checkpoint_err_t res = _set_monitorCheckpoint(monitor);
+	if(res != CHECKPOINT_OK && res != CHECKPOINT_BUSY)
+	    return SET_ERR;
+	monitor->due = (res == CHECKPOINT_BUSY);
+    }
     return SET_OK;
 }
+
+/** Ends early stopping, taking the final checkpoint (of the current weights, waiting for the writer) if training got anywhere,
+ * restoring the best weights if kept and not the current ones, and reports the outcome */
+static set_err_t _set_monitorFinish(_set_monitor_t * monitor) {
+    set_err_t res = SET_OK;
+    if(monitor->checkpoint.buffer) {
+	if(monitor->checkpointed != monitor->result.iterations) {
+	    checkpoint_wait(&monitor->checkpoint);
+	    if(_set_monitorCheckpoint(monitor) != CHECKPOINT_OK)
+		res = SET_ERR;
+	}
+	if(checkpoint_close(&monitor->checkpoint) != CHECKPOINT_OK)
+	    res = SET_ERR;
+	monitor->result.checkpoints = monitor->checkpoint.written;
+    }
+    if(monitor->best && monitor->result.evaluations > 0 && monitor->result.bestIteration != monitor->result.iterations)
+	_set_copyParams(monitor->net, monitor->best, 1);
+    free(monitor->best);
+    monitor->best = NULL;
+    if(monitor->options->result)
+	*monitor->options->result = monitor->result;
+    return res;
+}
+
+/** Training state shared by the chunks of a run, set up for one of the training modes */
+typedef struct {
+    set_options_t const * options;
+    network_t * net;
+    size_t * layers;
+    size_t batchSize;
+    /** Pool of asynchronous or data-parallel training */
+    pool_t pool;
+    /** The optimizer applying the corrections */
+    optim_t optim;
+    /** Batch state, one per pool worker for data-parallel training, a single one for mini-batch training */
+    set_batch_t * batches;
+    /** Scratch space of per-sample training */
+    network_tracker_t tracker;
+    network_workspace_t ws;
+    matrix_t out;
+} _set_trainer_t;
+
+/** Trains one iteration's worth (one pass) on a chunk in the trainer's mode */
+static set_err_t _set_trainChunk(_set_trainer_t * trainer, set_t * chunk) {
+    optim_t * optim = &trainer->optim;
+    if(trainer->options->mode == SET_MODE_ASYNC)
+	return set_train_async(chunk, trainer->net, trainer->layers, &trainer->pool, 1, optim);
+    if(trainer->batchSize > 1 && trainer->pool.size > 1)
+	return set_train_parallel(chunk, trainer->net, &trainer->pool, trainer->batches, trainer->batchSize, optim);
+    if(trainer->batchSize > 1)
+	return set_train_batch(chunk, trainer->net, trainer->batches, optim);
+    return set_train_i(chunk, trainer->net, &trainer->tracker, &trainer->ws, &trainer->out, optim);
+}
+
+/** Trains on a chunked source, 'set' being the in-memory set behind it if any (evaluated directly instead of a pass over the source) */
+static set_err_t _set_trainSource(set_source_t * source, network_t * net, size_t * layers, set_options_t const * options, set_t * set);
+
+set_err_t set_train(set_t * set, network_t * net, size_t * layers, set_options_t const * options) {
+    /* Checking given params */
+    if(!set || !net || !options)
+	return SET_ERR_PARAM;
+
+    /* Lock-free asynchronous training, one part of the set per thread for all iterations without synchronising in between */
+    if(options->mode == SET_MODE_ASYNC) {
+	if(network_initMaster(net) != NETWORK_OK)
+	    return SET_ERR_TRAIN;
+	pool_t pool;
+	pool_init(&pool, (options->threads < set->size ? options->threads : set->size));
+	optim_t optim = {0};
+	_set_monitor_t monitor = {0};
+	set_err_t res = (optim_init(&optim, net, &options->optimizer, options->learnRate) == OPTIM_OK ? SET_OK : SET_ERR);
+	if(res == SET_OK)
+	    res = _set_monitorInit(&monitor, net, &optim, options, set, NULL);
+
+	/* All iterations in one go, or in rounds between the evaluations (or time checks, learning rate changes or checkpoints), the workers
+	 * only waiting for each other between rounds */
+	int scheduled = (options->optimizer.schedule != OPTIM_SCHEDULE_CONSTANT || options->optimizer.warmup > 0);
+	int single = (options->timeBudget > 0 || scheduled || options->checkpoint || options->resume);
+	size_t round = (options->evalEvery > 0 && !single ? options->evalEvery : (single ? 1 : options->iterations));
+	int stop = 0;
+	for(size_t done = monitor.result.resumed; done < options->iterations && res == SET_OK && !stop; ) {
+	    size_t count = (options->iterations - done < round ? options->iterations - done : round);
+	    optim.rate = optim_schedule(&options->optimizer, options->learnRate, done, options->iterations);
+	    res = set_train_async(set, net, layers, &pool, count, &optim);
+	    done += count;
+	    if(res == SET_OK) {
+		PROF_EPOCH(done);
+		res = _set_monitorIteration(&monitor, done, &stop);
+	    }
+	}
+	if(monitor.options) {
+	    set_err_t finishRes = _set_monitorFinish(&monitor);
+	    if(res == SET_OK)
+		res = finishRes;
+	}
+	optim_destroy(&optim);
+	pool_destroy(&pool);
+	return res;
+    }
+
+    /* Otherwise the whole set is the single chunk of every pass */
+    _set_memory_t memory = { .set = set };
+    set_source_t source = { .next = _set_memoryNext, .source = &memory, .inSize = set->inSize, .outSize = set->outSize, .chunkSize = set->size };
+    return _set_trainSource(&source, net, layers, options, set);
+}
+
+set_err_t set_train_source(set_source_t * source, network_t * net, size_t * layers, set_options_t const * options) {
+    return _set_trainSource(source, net, layers, options, NULL);
+}
+static set_err_t _set_trainSource(set_source_t * source, network_t * net, size_t * layers, set_options_t const * options, set_t * set) {
+    /* Checking given params */
+    if(!source || !net || !options || source->chunkSize == 0)
+	return SET_ERR_PARAM;
+    /* Updates go to the full precision master weights, inference uses the (re-rounded) copies of whatever dtype the network has */
+    if(network_initMaster(net) != NETWORK_OK)
+	return SET_ERR_TRAIN;
+    _set_trainer_t trainer = { .options = options, .net = net, .layers = layers };
+    trainer.batchSize = (options->batchSize < source->chunkSize ? options->batchSize : source->chunkSize);
+    set_err_t res = SET_OK;
+
+    if(options->mode == SET_MODE_ASYNC) {
+	/* Lock-free asynchronous training, one part of every chunk per thread */
+	pool_init(&trainer.pool, (options->threads < source->chunkSize ? options->threads : source->chunkSize));
+    } else if(trainer.batchSize > 1 && options->threads > 1) {
+	/* Data-parallel mini-batch training, with per-worker batch state for one shard each */
+	pool_init(&trainer.pool, (options->threads < trainer.batchSize ? options->threads : trainer.batchSize));
+	trainer.batches = (set_batch_t *)(calloc(trainer.pool.size, sizeof(set_batch_t)));
+	size_t shard = (trainer.batchSize + trainer.pool.size - 1) / trainer.pool.size;
+	for(size_t w = 0; w < trainer.pool.size && trainer.batches; ++w) {
+	    set_err_t initRes = set_batch_init((trainer.batches + w), net, shard);
+	    if(initRes != SET_OK)
+		res = initRes;
+	}
+    } else if(trainer.batchSize > 1) {
+	/* Mini-batch training, every pass is a series of matrix-matrix products */
+	trainer.batches = (set_batch_t *)(calloc(1, sizeof(set_batch_t)));
+	if(trainer.batches)
+	    res = set_batch_init(trainer.batches, net, trainer.batchSize);
+    } else {
+	/* Per-sample training, with a network tracker, an output matrix and an inference workspace */
+	if(network_tracker_init(&trainer.tracker, net->depth, layers) != NETWORK_OK || matrix_init(&trainer.out, net->outSize, 1) != MATRIX_OK
+	   || !trainer.out.data)
+	    res = SET_ERR;
+	else if(network_workspace_init(&trainer.ws, net) != NETWORK_OK)
+	    res = SET_ERR_TRAIN;
+    }
+    if(options->mode != SET_MODE_ASYNC && trainer.batchSize > 1 && !trainer.batches)
+	res = SET_ERR;
+    if(res == SET_OK && optim_init(&trainer.optim, net, &options->optimizer, options->learnRate) != OPTIM_OK)
+	res = SET_ERR;
+    _set_monitor_t monitor = {0};
+    if(res == SET_OK)
+	res = _set_monitorInit(&monitor, net, &trainer.optim, options, set, source);
+
+    /* Running X iterations of training, each a pass over every chunk, unless stopped early (resuming after the iterations already done) */
+    int stop = 0;
+    for(size_t itCount = monitor.result.resumed; itCount < options->iterations && res == SET_OK && !stop; ++itCount) {
+	trainer.optim.rate = optim_schedule(&options->optimizer, options->learnRate, itCount, options->iterations);
+	for(;;) {
+	    set_t * chunk = NULL;
+	    PROF_BEGIN(loadStart);
+	    res = source->next(source->source, &chunk);
+	    PROF_END(loadStart, PROF_LOAD, PROF_NO_LAYER);
+	    if(res != SET_OK || !chunk)
+		break;
+	    res = _set_trainChunk(&trainer, chunk);
+	    if(res != SET_OK)
+		break;
+	}
+	if(res == SET_OK) {
+	    PROF_EPOCH(itCount + 1);
+	    res = _set_monitorIteration(&monitor, itCount + 1, &stop);
+	}
+    }
+    if(monitor.options) {
+	set_err_t finishRes = _set_monitorFinish(&monitor);
+	if(res == SET_OK)
+	    res = finishRes;
+    }
+
+    /* Freeing allocated resources */
+    for(size_t w = 0; trainer.batches && w < (trainer.pool.size > 1 ? trainer.pool.size : 1); ++w)
+	set_batch_destroy(trainer.batches + w);
+    free(trainer.batches);
+    optim_destroy(&trainer.optim);
+    if(trainer.pool.size > 0)
+	pool_destroy(&trainer.pool);
+    network_tracker_destroy(&trainer.tracker);
+    network_workspace_destroy(&trainer.ws);
+    matrix_destroy(&trainer.out);
+
+    return res;
+}
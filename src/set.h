@@ -6,16 +6,22 @@
 #ifndef SET_H
 #define SET_H
 
+#include <stdio.h>
+
 #include "matrix.h"
 #include "network.h"
+#include "pool.h"
+#include "optim.h"
+#include "checkpoint.h"
 
-/** Data structure containing a training data set */
+/** Data structure containing a training data set, stored as one contiguous block of inputs and one of outputs,
+ * samples being accessed as matrix views into them (see set_inView and set_outView) */
 typedef struct {
 
-    /** The input data */
-    matrix_t * in;
-    /** The output data corresponding to the input data */
-    matrix_t * out;
+    /** The input data, 'size' consecutive inputs of inSize values each */
+    MATRIX_TYPE * in;
+    /** The output data corresponding to the input data, 'size' consecutive outputs of outSize values each */
+    MATRIX_TYPE * out;
     /** The length of the data set */
     size_t size;
 
@@ -24,8 +30,70 @@ typedef struct {
     /** The size of the output vector */
     size_t outSize;
 
+    /** The file mapping the data blocks live in, NULL if they were allocated */
+    void * mapping;
+    /** The length of the file mapping */
+    size_t mappingLen;
+
 } set_t;
 
+/** Scratch state for mini-batch training of a network: a gathered batch, the activated outputs of every layer and the weight corrections */
+typedef struct {
+    /** The maximum number of samples in a batch */
+    size_t capacity;
+    /** The number of layers of the network this state was initialized for */
+    size_t depth;
+    /** The batch inputs, one sample per column (inSize x capacity) */
+    matrix_t in;
+    /** The batch expected outputs, one sample per column (outSize x capacity) */
+    matrix_t target;
+    /** The activated outputs of every layer for the batch (layer size x capacity) */
+    matrix_t * act;
+    /** The weight corrections of every layer, summed over the batch (same shapes as the weights) */
+    matrix_t * grad;
+    /** The bias corrections of every layer, summed over the batch (same shapes as the biases) */
+    matrix_t * biasGrad;
+    /** Workspace providing the backpropagation buffers */
+    network_workspace_t ws;
+} set_batch_t;
+
+/** Training modes for set_train */
+typedef enum {
+    /** Synchronous training, every weight update sees all corrections before it */
+    SET_MODE_SYNC = 0,
+    /** Asynchronous (Hogwild) training, threads update the shared weights per sample without locks */
+    SET_MODE_ASYNC = 1
+} set_mode_t;
+
+/** Reasons for training to end */
+typedef enum {
+    /** All iterations were run */
+    SET_STOP_ITERATIONS = 0,
+    /** The evaluated loss reached the loss target */
+    SET_STOP_TARGET = 1,
+    /** The evaluated loss didn't improve for 'patience' evaluations in a row */
+    SET_STOP_PATIENCE = 2,
+    /** The time budget ran out */
+    SET_STOP_TIME = 3
+} set_stop_t;
+
+/** Outcome of a training run */
+typedef struct {
+    /** Why training ended */
+    set_stop_t stop;
+    /** The number of iterations run */
+    size_t iterations;
+    /** The number of evaluations, and the loss of the last one (held-out if there is a validation set, training otherwise) */
+    size_t evaluations;
+    MATRIX_TYPE loss;
+    /** The best evaluated loss and the iteration it was reached at (the weights of which are kept with keepBest) */
+    MATRIX_TYPE bestLoss;
+    size_t bestIteration;
+    /** The iteration training resumed after (0 for a fresh start), and the number of checkpoints written */
+    size_t resumed;
+    size_t checkpoints;
+} set_result_t;
+
 /** Set file error types */
 typedef enum {
     /** Success state, function executed ok */
@@ -40,19 +108,133 @@ typedef enum {
     SET_ERR = 4
 } set_err_t;
 
-/** Initializes a given set_t data structure */
+/** Provides the next chunk of a chunked data source as a set owned by the source and valid until the following call,
+ * or a NULL chunk once a whole pass over the data is done, the call after that starting the next pass */
+typedef set_err_t (*set_next_t) (void * source, set_t ** chunk);
+
+/** Data source handing out a data set one chunk at a time, so that it never has to be in memory as a whole */
+typedef struct {
+    /** Returns the next chunk */
+    set_next_t next;
+    /** The source state passed to next */
+    void * source;
+    /** The input and output sizes of every sample */
+    size_t inSize, outSize;
+    /** The largest number of samples in a chunk */
+    size_t chunkSize;
+} set_source_t;
+
+/** Training options for set_train */
+typedef struct {
+    /** The training mode */
+    set_mode_t mode;
+    /** The learning rate (the starting point of the schedule) */
+    float learnRate;
+    /** The optimizer applying the corrections and the learning rate schedule, a zero-initialized one being plain SGD at a constant rate */
+    optim_options_t optimizer;
+    /** The number of training iterations (passes over the whole set) */
+    size_t iterations;
+    /** The number of samples per weight update, 0 or 1 for per-sample updates */
+    size_t batchSize;
+    /** The number of threads, splitting every mini-batch between them in synchronous mode (only used with batchSize > 1),
+     * or each training on its own part of the set in asynchronous mode, 0 or 1 for single-threaded training */
+    size_t threads;
+
+    /** Evaluate the loss every this many iterations and after the last one, 0 never evaluates (disabling lossTarget, patience and keepBest) */
+    size_t evalEvery;
+    /** The number of training samples evaluated (from the start of the set), 0 for all of them,
+     * a chunked source is evaluated over a whole pass, and only if there is no validation set */
+    size_t evalSamples;
+    /** Source evaluated instead of a chunked training source, a whole pass over it per evaluation, so that evaluations don't use up passes
+     * of the training source and every iteration trains on the pass of its own number (as resuming a streamed run relies on),
+     * NULL to evaluate passes of the training source itself */
+    set_source_t * evalSource;
+    /** Held-out set evaluated alongside the training data, its loss deciding the stopping criteria if given (NULL for none) */
+    set_t * validation;
+    /** Stop once the evaluated loss is at or below this, 0 for no target */
+    MATRIX_TYPE lossTarget;
+    /** Stop after this many evaluations in a row without the best loss improving by more than minDelta, 0 to never stop on a plateau */
+    size_t patience;
+    MATRIX_TYPE minDelta;
+    /** Stop once training took this many seconds, checked at the end of every iteration, 0 for no limit */
+    double timeBudget;
+    /** Restore the weights of the best evaluation once training ends */
+    int keepBest;
+    /** Stream receiving a line for every evaluation, NULL for none */
+    FILE * log;
+
+    /** File checkpoints are written to by a background thread, replacing the previous one, NULL for none */
+    char const * checkpoint;
+    /** Take a checkpoint every this many iterations (skipped while the previous one is still being written), 0 for none but the final one,
+     * a checkpoint always being taken once training ends */
+    size_t checkpointEvery;
+    /** Checkpoint to resume training from, restoring the weights, the optimizer state and the progress, NULL to start afresh */
+    char const * resume;
+    /** Seed of the run (the weight initialization and the data shuffling), only stored in the checkpoints */
+    uint64_t seed;
+
+    /** Receives the outcome of the training run, if not NULL */
+    set_result_t * result;
+} set_options_t;
+
+/** Initializes a given set_t data structure, allocating its input and output blocks */
 set_err_t set_init(set_t * set, size_t size, size_t inSize, size_t outSize);
 
-/** Destroys a given set_t data structure */
+/** Destroys a given set_t data structure, unmapping it if it was loaded from a file mapping */
 set_err_t set_destroy(set_t * set);
 
 /** Sets the given input and output data at a given data point */
 set_err_t set_setData(set_t * set, size_t idx, MATRIX_TYPE * inData, MATRIX_TYPE * outData);
 
-/** Trains a single iteration of the given network structure on the given set */
-set_err_t set_train_i(set_t * set, network_t * net, network_tracker_t * tracker, matrix_t * out, float learnRate);
+/** Returns a column vector view of the inputs of the sample at the given index, pointing into the set (no bounds checking) */
+matrix_t set_inView(set_t const * set, size_t idx);
+
+/** Returns a column vector view of the outputs of the sample at the given index, pointing into the set (no bounds checking) */
+matrix_t set_outView(set_t const * set, size_t idx);
+
+/** Trains the given network on a single sample of the set at the given index, using the given tracker, workspace and output matrix as scratch space,
+ * the corrections of every layer being applied as one step of the optimizer */
+set_err_t set_train_sample(set_t * set, network_t * net, network_tracker_t * tracker, network_workspace_t * ws, matrix_t * out, size_t idx, optim_t * optim);
+
+/** Trains a single iteration of the given network structure on the given set, using the given tracker, workspace and output matrix as scratch space */
+set_err_t set_train_i(set_t * set, network_t * net, network_tracker_t * tracker, network_workspace_t * ws, matrix_t * out, optim_t * optim);
+
+/** Initializes mini-batch training state for the given network and batches of up to 'capacity' samples */
+set_err_t set_batch_init(set_batch_t * batch, network_t * net, size_t capacity);
+
+/** Destroys mini-batch training state */
+set_err_t set_batch_destroy(set_batch_t * batch);
+
+/** Gathers the samples [start, start + count) of the set into the batch and computes their summed weight corrections into batch->grad,
+ * running the forward pass, the error backpropagation and the correction accumulation as matrix-matrix products */
+set_err_t set_batch_gradient(set_batch_t * batch, set_t * set, network_t * net, size_t start, size_t count);
+
+/** Trains a single iteration of the given network on the given set, in mini-batches of the batch capacity, with one weight update per batch */
+set_err_t set_train_batch(set_t * set, network_t * net, set_batch_t * batch, optim_t * optim);
+
+/** Trains a single iteration data-parallel: every batch of batchSize samples is split into one shard per pool worker,
+ * each worker computes the corrections of its shard into its own batch state (an array of pool->size states, with capacity
+ * for a shard each), and the corrections are then summed in worker order and applied, so results only depend on the worker count */
+set_err_t set_train_parallel(set_t * set, network_t * net, pool_t * pool, set_batch_t * batches, size_t batchSize, optim_t * optim);
+
+/** Trains the given number of iterations asynchronously (Hogwild): each pool worker runs per-sample training on its own part of the set,
+ * writing straight into the shared weights without any locking or synchronisation between workers until all iterations are done,
+ * so the racing updates (and those of the shared optimizer state) may overwrite each other and results are not reproducible */
+set_err_t set_train_async(set_t * set, network_t * net, size_t * layers, pool_t * pool, size_t iterations, optim_t * optim);
+
+/** Computes the mean squared error of the network over the whole set into 'loss' */
+set_err_t set_loss(set_t * set, network_t * net, MATRIX_TYPE * loss);
+
+/** Computes the mean squared error of the network over one whole pass of a chunked source into 'loss' */
+set_err_t set_loss_source(set_source_t * source, network_t * net, MATRIX_TYPE * loss);
+
+/** Trains a given network on a given set with the given options, updating the weights through the optimizer after every sample if the batch size
+ * is 0 or 1, or after every batch of samples otherwise, split between threads if requested, or asynchronously if the mode is SET_MODE_ASYNC,
+ * stopping early once the loss evaluated every evalEvery iterations reaches the target or stops improving, or the time budget runs out */
+set_err_t set_train(set_t * set, network_t * net, size_t * layers, set_options_t const * options);
 
-/** Trains a given network on a given set, with the given learnRate, for the given number of iterations */
-set_err_t set_train(set_t * set, network_t * net, size_t * layers, float learnRate, size_t iterations);
+/** Trains a given network on a chunked source like set_train, every iteration being one pass over the source that trains on each chunk
+ * in turn as a set of its own (mini-batches don't straddle chunks, asynchronous threads synchronise at the end of every chunk) */
+set_err_t set_train_source(set_source_t * source, network_t * net, size_t * layers, set_options_t const * options);
 
 #endif /* TRAIN_H */
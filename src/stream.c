@@ -0,0 +1,358 @@
+#include "stream.h"
+#include "prof.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/** Reads exactly 'len' bytes at the given file offset, returning 1 on success */
+static int _stream_pread(int fd, void * buf, size_t len, uint64_t offset) {
+    unsigned char * dst = (unsigned char *)(buf);
+    while(len > 0) {
+	ssize_t got = pread(fd, dst, len, (off_t)(offset));
+	if(got < 0 && errno == EINTR)
+	    continue;
+	if(got <= 0)
+	    return 0;
+	dst += got;
+	len -= (size_t)(got);
+	offset += (uint64_t)(got);
+    }
+    return 1;
+}
+
+/** Reads up to a chunk of valid lines from the current position of the text file, skipping malformed ones, which are reported
+ * (as util_loadPoints does) if the file is being read front to back for the first time */
+static set_err_t _stream_readText(stream_t * stream, set_t * chunk, int first) {
+    chunk->size = 0;
+    while(chunk->size < stream->options.chunkSize && getline(&stream->line, &stream->lineSize, stream->text) >= 0) {
+	stream->lines += (first != 0);
+	if(util_parsePoint(stream->line, chunk->in + chunk->size * stream->inSize, stream->inSize, chunk->out + chunk->size * stream->outSize, stream->outSize)) {
+	    ++chunk->size;
+	} else if(first && stream->line[strspn(stream->line, " \t\r\n")] != '\0') {
+	    if(!stream->options.quiet && stream->malformed < UTIL_POINTS_REPORT)
+		fprintf(stderr, "Warning: skipping malformed line %lu of '%s'\n", stream->lines, stream->filename);
+	    ++stream->malformed;
+	}
+    }
+    return (ferror(stream->text) ? SET_ERR : SET_OK);
+}
+
+/** Ends the first read through a text file, which found 'chunks' chunks, failing if it found no sample at all */
+static set_err_t _stream_indexed(stream_t * stream, size_t chunks) {
+    stream->chunks = chunks;
+    if(!stream->options.quiet && stream->malformed > UTIL_POINTS_REPORT)
+	fprintf(stderr, "Warning: skipped %lu malformed lines of '%s' in total\n", stream->malformed, stream->filename);
+    if(chunks == 0) {
+	stream->error = STREAM_ERR_FORMAT;
+	return SET_ERR;
+    }
+    return SET_OK;
+}
+
+/** Reads the given chunk of the dataset file, its inputs and its outputs lying in the two blocks of the file */
+static set_err_t _stream_readSet(stream_t * stream, size_t chunkIdx, set_t * chunk) {
+    size_t start = chunkIdx * stream->options.chunkSize;
+    chunk->size = (stream->size - start < stream->options.chunkSize ? stream->size - start : stream->options.chunkSize);
+    size_t inRow = stream->inSize * sizeof(MATRIX_TYPE), outRow = stream->outSize * sizeof(MATRIX_TYPE);
+    int ok = (_stream_pread(stream->fd, chunk->in, chunk->size * inRow, stream->header.inOffset + start * inRow)
+	      && _stream_pread(stream->fd, chunk->out, chunk->size * outRow, stream->header.outOffset + start * outRow));
+    return (ok ? SET_OK : SET_ERR);
+}
+
+/** Shuffles the samples within a chunk (Fisher-Yates), moving every input together with its output */
+static void _stream_shuffleChunk(stream_t * stream, set_t * chunk) {
+    size_t inRow = stream->inSize * sizeof(MATRIX_TYPE), outRow = stream->outSize * sizeof(MATRIX_TYPE);
+    rng_fillSwaps(&stream->rng, stream->swaps, chunk->size);
+    for(size_t i = chunk->size; i-- > 1; ) {
+	size_t j = stream->swaps[i];
+	if(j == i)
+	    continue;
+	memcpy(stream->swap, chunk->in + i * stream->inSize, inRow);
+	memcpy(chunk->in + i * stream->inSize, chunk->in + j * stream->inSize, inRow);
+	memcpy(chunk->in + j * stream->inSize, stream->swap, inRow);
+	memcpy(stream->swap, chunk->out + i * stream->outSize, outRow);
+	memcpy(chunk->out + i * stream->outSize, chunk->out + j * stream->outSize, outRow);
+	memcpy(chunk->out + j * stream->outSize, stream->swap, outRow);
+    }
+}
+
+/** Sets up the chunk order of a pass over known chunks, a random permutation if shuffling */
+static set_err_t _stream_order(stream_t * stream) {
+    if(!stream->order) {
+	stream->order = (size_t *)(malloc(stream->chunks * sizeof(size_t)));
+	if(!stream->order) {
+	    stream->error = STREAM_ERR_ALLOC;
+	    return SET_ERR;
+	}
+    }
+    for(size_t k = 0; k < stream->chunks; ++k)
+	stream->order[k] = k;
+    for(size_t k = stream->chunks; stream->options.shuffle && k-- > 1; ) {
+	size_t j = (size_t)(rng_below(&stream->rng, k + 1));
+	size_t tmp = stream->order[k];
+	stream->order[k] = stream->order[j];
+	stream->order[j] = tmp;
+    }
+    return SET_OK;
+}
+
+/** Waits until the given buffer has been handed back, returning 0 if the stream is stopping instead */
+static int _stream_waitFree(stream_t * stream, stream_buffer_t * buffer) {
+    pthread_mutex_lock(&stream->lock);
+    while(buffer->filled && !stream->stop)
+	pthread_cond_wait(&stream->freeCond, &stream->lock);
+    int stop = stream->stop;
+    pthread_mutex_unlock(&stream->lock);
+    return !stop;
+}
+
+/** Hands a loaded buffer (or an end of pass marker) over to the consumer */
+static void _stream_publish(stream_t * stream, stream_buffer_t * buffer, int end, set_err_t status) {
+    pthread_mutex_lock(&stream->lock);
+    buffer->end = end;
+    buffer->status = status;
+    buffer->filled = 1;
+    pthread_cond_signal(&stream->filledCond);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/** Records the file offset and size of the text chunk 'k' read during the first pass */
+static set_err_t _stream_addChunk(stream_t * stream, size_t k, uint64_t offset, size_t size) {
+    if(k == stream->offsetsCap) {
+	size_t cap = (stream->offsetsCap ? 2 * stream->offsetsCap : 64);
+	uint64_t * grown = (uint64_t *)(realloc(stream->offsets, cap * sizeof(uint64_t)));
+	if(!grown) {
+	    stream->error = STREAM_ERR_ALLOC;
+	    return SET_ERR;
+	}
+	stream->offsets = grown;
+	stream->offsetsCap = cap;
+    }
+    stream->offsets[k] = offset;
+    /* The size is read by the consumer while the first pass is still being read */
+    pthread_mutex_lock(&stream->lock);
+    stream->size += size;
+    pthread_mutex_unlock(&stream->lock);
+    return SET_OK;
+}
+
+/** Reads a text file front to back once, before anything is handed out, only recording its chunks, so that a resumed stream
+ * can start on a later pass in that pass's chunk order */
+static set_err_t _stream_index(stream_t * stream) {
+    set_t * scratch = &stream->buffers[0].set;
+    for(size_t k = 0; ; ++k) {
+	uint64_t offset = (uint64_t)(ftello(stream->text));
+	set_err_t status = _stream_readText(stream, scratch, 1);
+	if(status != SET_OK)
+	    return status;
+	if(scratch->size == 0)
+	    return _stream_indexed(stream, k);
+	status = _stream_addChunk(stream, k, offset, scratch->size);
+	if(status != SET_OK)
+	    return status;
+    }
+}
+
+/** Prefetch thread, loads the chunks of pass after pass into the buffers in turn, each as soon as the consumer hands it back */
+static void * _stream_prefetch(void * arg) {
+    stream_t * stream = (stream_t *)(arg);
+    size_t slot = 0;
+    set_err_t status = SET_OK;
+    if(stream->format == STREAM_FORMAT_TEXT && stream->pass > 0)
+	status = _stream_index(stream);
+    for(;;) {
+	/* Every pass shuffles from a substream of its own, so that a stream resumed on a later pass shuffles like the uninterrupted one */
+	rng_t rng;
+	rng_init(&rng, stream->options.seed, STREAM_RNG_STREAM);
+	stream->rng = rng_split(&rng, stream->pass);
+	/* A text file is read front to back until its chunk offsets are known, later passes seek to the chunks in their pass order */
+	int first = (stream->format == STREAM_FORMAT_TEXT && stream->chunks == 0);
+	if(status == SET_OK && !first)
+	    status = _stream_order(stream);
+	for(size_t k = 0; status == SET_OK && (first || k < stream->chunks); ++k) {
+	    stream_buffer_t * buffer = (stream->buffers + slot);
+	    if(!_stream_waitFree(stream, buffer))
+		return NULL;
+	    PROF_BEGIN(readStart);
+	    if(first) {
+		uint64_t offset = (uint64_t)(ftello(stream->text));
+		status = _stream_readText(stream, &buffer->set, 1);
+		if(status == SET_OK && buffer->set.size == 0) {
+		    status = _stream_indexed(stream, k);
+		    break;
+		}
+		if(status == SET_OK)
+		    status = _stream_addChunk(stream, k, offset, buffer->set.size);
+	    } else if(stream->format == STREAM_FORMAT_TEXT) {
+		size_t chunkIdx = stream->order[k];
+		status = (fseeko(stream->text, (off_t)(stream->offsets[chunkIdx]), SEEK_SET) == 0 ? _stream_readText(stream, &buffer->set, 0) : SET_ERR);
+	    } else {
+		status = _stream_readSet(stream, stream->order[k], &buffer->set);
+	    }
+	    if(status == SET_OK && stream->options.shuffle)
+		_stream_shuffleChunk(stream, &buffer->set);
+	    PROF_END(readStart, PROF_PREFETCH, PROF_NO_LAYER);
+	    _stream_publish(stream, buffer, 0, status);
+	    slot ^= 1;
+	}
+	if(status != SET_OK) {
+	    /* Failures stay with the consumer, the failing buffer being published unless ordering failed before any */
+	    if(stream->error == STREAM_OK)
+		stream->error = STREAM_ERR_FILE;
+	    if(_stream_waitFree(stream, stream->buffers + slot))
+		_stream_publish(stream, stream->buffers + slot, 1, status);
+	    return NULL;
+	}
+
+	/* End of pass marker */
+	stream_buffer_t * buffer = (stream->buffers + slot);
+	if(!_stream_waitFree(stream, buffer))
+	    return NULL;
+	buffer->set.size = 0;
+	_stream_publish(stream, buffer, 1, SET_OK);
+	slot ^= 1;
+	++stream->pass;
+    }
+}
+
+/** Source callback, hands back the chunk held so far and waits for the next buffer */
+static set_err_t _stream_next(void * source, set_t ** chunk) {
+    stream_t * stream = (stream_t *)(source);
+    pthread_mutex_lock(&stream->lock);
+    if(stream->held) {
+	stream->buffers[stream->current].filled = 0;
+	stream->current ^= 1;
+	stream->held = 0;
+	pthread_cond_signal(&stream->freeCond);
+    }
+    while(!stream->buffers[stream->current].filled)
+	pthread_cond_wait(&stream->filledCond, &stream->lock);
+    stream_buffer_t * buffer = (stream->buffers + stream->current);
+    /* A failed buffer is never handed back, so the failure is reported again by every later call */
+    stream->held = (buffer->status == SET_OK);
+    pthread_mutex_unlock(&stream->lock);
+    *chunk = (buffer->end || buffer->status != SET_OK ? NULL : &buffer->set);
+    return buffer->status;
+}
+
+/** Releases everything but the prefetch thread */
+static void _stream_free(stream_t * stream) {
+    for(size_t i = 0; i < 2; ++i)
+	set_destroy(&stream->buffers[i].set);
+    if(stream->text)
+	fclose(stream->text);
+    if(stream->fd >= 0)
+	close(stream->fd);
+    free(stream->filename);
+    free(stream->line);
+    free(stream->offsets);
+    free(stream->order);
+    free(stream->swap);
+    free(stream->swaps);
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->filledCond);
+    pthread_cond_destroy(&stream->freeCond);
+    *stream = (stream_t){ .fd = -1 };
+}
+
+stream_err_t stream_open(stream_t * stream, char const * filename, size_t inSize, size_t outSize, stream_options_t const * options) {
+    if(!stream || !filename || inSize == 0 || outSize == 0 || !options || options->chunkSize == 0)
+	return STREAM_ERR_PARAM;
+    *stream = (stream_t){ .options = *options, .inSize = inSize, .outSize = outSize, .fd = -1, .pass = options->pass };
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->filledCond, NULL);
+    pthread_cond_init(&stream->freeCond, NULL);
+    stream->filename = strdup(filename);
+    if(!stream->filename) {
+	_stream_free(stream);
+	return STREAM_ERR_ALLOC;
+    }
+
+    /* Dataset files are recognised by their header, anything else is read as text */
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+	_stream_free(stream);
+	return STREAM_ERR_FILE;
+    }
+    struct stat st;
+    util_setHeader_t header;
+    if(fstat(fd, &st) == 0 && _stream_pread(fd, &header, sizeof(header), 0) && memcmp(header.magic, UTIL_SET_MAGIC, sizeof(UTIL_SET_MAGIC)) == 0) {
+	stream->format = STREAM_FORMAT_SET;
+	stream->fd = fd;
+	int swap = 0;
+	util_dtype_t hostDtype = (sizeof(MATRIX_TYPE) == sizeof(double) ? UTIL_DTYPE_F64 : UTIL_DTYPE_F32);
+	stream_err_t res = STREAM_OK;
+	if(util_checkSetHeader(&header, (uint64_t)(st.st_size), &swap) != UTIL_OK || swap || header.dtype != hostDtype)
+	    res = STREAM_ERR_FORMAT;
+	else if(header.inSize != inSize || header.outSize != outSize)
+	    res = STREAM_ERR_PARAM;
+	if(res != STREAM_OK) {
+	    _stream_free(stream);
+	    return res;
+	}
+	stream->header = header;
+	stream->size = header.size;
+	if(stream->options.chunkSize > stream->size)
+	    stream->options.chunkSize = stream->size;
+	stream->chunks = (stream->size + stream->options.chunkSize - 1) / stream->options.chunkSize;
+    } else {
+	close(fd);
+	stream->format = STREAM_FORMAT_TEXT;
+	stream->text = fopen(filename, "r");
+	if(!stream->text) {
+	    _stream_free(stream);
+	    return STREAM_ERR_FILE;
+	}
+    }
+
+    /* Both chunk buffers, then the prefetch thread starting on the first pass */
+    stream->swap = (MATRIX_TYPE *)(malloc((inSize > outSize ? inSize : outSize) * sizeof(MATRIX_TYPE)));
+    stream->swaps = (size_t *)(malloc(stream->options.chunkSize * sizeof(size_t)));
+    if(!stream->swap || !stream->swaps || set_init(&stream->buffers[0].set, stream->options.chunkSize, inSize, outSize) != SET_OK
+       || set_init(&stream->buffers[1].set, stream->options.chunkSize, inSize, outSize) != SET_OK) {
+	_stream_free(stream);
+	return STREAM_ERR_ALLOC;
+    }
+    if(pthread_create(&stream->thread, NULL, _stream_prefetch, stream) != 0) {
+	_stream_free(stream);
+	return STREAM_ERR_THREAD;
+    }
+    return STREAM_OK;
+}
+
+stream_err_t stream_close(stream_t * stream) {
+    if(!stream)
+	return STREAM_ERR_PARAM;
+    pthread_mutex_lock(&stream->lock);
+    stream->stop = 1;
+    pthread_cond_broadcast(&stream->freeCond);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->thread, NULL);
+    _stream_free(stream);
+    return STREAM_OK;
+}
+
+size_t stream_size(stream_t * stream) {
+    if(!stream)
+	return 0;
+    pthread_mutex_lock(&stream->lock);
+    size_t size = stream->size;
+    pthread_mutex_unlock(&stream->lock);
+    return size;
+}
+
+stream_err_t stream_error(stream_t * stream) {
+    if(!stream)
+	return STREAM_ERR_PARAM;
+    pthread_mutex_lock(&stream->lock);
+    stream_err_t error = (stream_err_t)(stream->error);
+    pthread_mutex_unlock(&stream->lock);
+    return error;
+}
+
+set_source_t stream_source(stream_t * stream) {
+    return (set_source_t){ .next = _stream_next, .source = stream, .inSize = stream->inSize, .outSize = stream->outSize, .chunkSize = stream->options.chunkSize };
+}
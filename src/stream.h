@@ -0,0 +1,151 @@
+/**
+ * @file stream.h
+ * @author Linux-Tech-Tips (Martin)
+ * @brief File containing out-of-core data sources, streaming points or dataset files in chunks prefetched by a background thread
+ */
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "matrix.h"
+#include "set.h"
+#include "util.h"
+#include "rng.h"
+
+/** Default number of samples per chunk */
+#define STREAM_CHUNK 65536
+/** Random number stream of the shuffling, every pass drawing from a substream of its own */
+#define STREAM_RNG_STREAM 2
+
+/** Streaming options */
+typedef struct {
+    /** The number of samples per chunk, two chunks being held in memory at a time */
+    size_t chunkSize;
+    /** Whether every pass visits the chunks in a new random order and shuffles the samples within each chunk */
+    int shuffle;
+    /** Seed of the shuffling, every pass shuffling from its own substream of it */
+    uint64_t seed;
+    /** The pass to start on, resuming an earlier run after this many passes (a text file then being read through once first to find its chunks) */
+    size_t pass;
+    /** Don't report the malformed lines of a text file (for a second stream over the same file) */
+    int quiet;
+} stream_options_t;
+
+/** Streamed file formats */
+typedef enum {
+    /** Text points file, one sample per line */
+    STREAM_FORMAT_TEXT = 0,
+    /** Binary dataset file (util_setHeader_t) */
+    STREAM_FORMAT_SET = 1
+} stream_format_t;
+
+/** Chunk buffer, filled by the prefetch thread and handed to the consumer */
+typedef struct {
+    /** The chunk, its blocks allocated for a whole chunk and its size the number of samples loaded */
+    set_t set;
+    /** Set once loaded, cleared when the consumer hands it back */
+    int filled;
+    /** Set if this buffer marks the end of a pass instead of holding a chunk */
+    int end;
+    /** The result of loading it */
+    set_err_t status;
+} stream_buffer_t;
+
+/** Data structure representing a stream over a points or dataset file */
+typedef struct {
+    /** The options */
+    stream_options_t options;
+    /** The file format */
+    stream_format_t format;
+    /** The input and output sizes of every sample */
+    size_t inSize, outSize;
+    /** The number of samples per pass, 0 until known (text files only know it after the first pass, read it through stream_size) */
+    size_t size;
+
+    /** The file name, for reporting malformed lines */
+    char * filename;
+    /** The text file being read */
+    FILE * text;
+    /** The lines of the text file read front to back so far, and the malformed ones among them, reported as the file is first read */
+    size_t lines, malformed;
+    /** Line buffer of the text file */
+    char * line;
+    size_t lineSize;
+    /** The dataset file descriptor */
+    int fd;
+    /** The dataset file header, in host byte order */
+    util_setHeader_t header;
+
+    /** The number of chunks per pass, 0 until known */
+    size_t chunks;
+    /** File offsets of the text chunks, recorded during the first pass to seek to them later */
+    uint64_t * offsets;
+    size_t offsetsCap;
+    /** The chunk order of the current pass */
+    size_t * order;
+    /** Scratch space for swapping samples, max(inSize, outSize) values, and the swaps of shuffling a chunk, chunkSize of them */
+    MATRIX_TYPE * swap;
+    size_t * swaps;
+    /** Shuffling state, and the number of passes started, only used by the prefetch thread */
+    rng_t rng;
+    size_t pass;
+
+    /** Double buffer, the consumer holding one chunk while the next is prefetched into the other */
+    stream_buffer_t buffers [2];
+    /** The buffer the consumer reads next or holds */
+    size_t current;
+    /** Whether the consumer holds the current buffer */
+    int held;
+
+    /** The prefetch thread */
+    pthread_t thread;
+    /** Lock protecting the buffer states and the stop flag */
+    pthread_mutex_t lock;
+    /** Signalled when a buffer gets filled */
+    pthread_cond_t filledCond;
+    /** Signalled when a buffer gets handed back, or the stream stops */
+    pthread_cond_t freeCond;
+    /** Set when the stream is being closed */
+    int stop;
+    /** Why the prefetch thread failed (a stream_err_t), STREAM_OK while it hasn't */
+    int error;
+} stream_t;
+
+/** Stream error types */
+typedef enum {
+    /** Success state */
+    STREAM_OK = 0,
+    /** Error with function parameters, or a dataset file of other input or output sizes */
+    STREAM_ERR_PARAM = 1,
+    /** Error opening or reading a file */
+    STREAM_ERR_FILE = 2,
+    /** Error with the contents of a dataset file, or one of another byte order or value type than the host (convert it on this host) */
+    STREAM_ERR_FORMAT = 3,
+    /** Error allocating memory */
+    STREAM_ERR_ALLOC = 4,
+    /** Error starting the prefetch thread */
+    STREAM_ERR_THREAD = 5
+} stream_err_t;
+
+/** Opens a stream over a points file (with 'inSize' input and 'outSize' output columns) or a binary dataset file (detected by its header),
+ * and starts prefetching, the stream must stay at the same address until closed */
+stream_err_t stream_open(stream_t * stream, char const * filename, size_t inSize, size_t outSize, stream_options_t const * options);
+
+/** Stops prefetching and closes a stream */
+stream_err_t stream_close(stream_t * stream);
+
+/** Returns a chunked data source reading from the stream, one pass over the file per pass of the source */
+set_source_t stream_source(stream_t * stream);
+
+/** Returns the number of samples per pass (of a text file, those of its chunks read so far until the first pass is done) */
+size_t stream_size(stream_t * stream);
+
+/** Returns why the stream failed once its source reported a failure (STREAM_ERR_FORMAT for a text file without a single valid sample,
+ * STREAM_ERR_FILE for a read error, STREAM_ERR_ALLOC for an allocation failure), STREAM_OK while it hasn't */
+stream_err_t stream_error(stream_t * stream);
+
+#endif /* STREAM_H */
@@ -1,94 +1,834 @@
 #include "util.h"
+#include "kernel.h"
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/** Returns the network file element type matching MATRIX_TYPE */
+static util_dtype_t _util_hostDtype(void) {
+    return (sizeof(MATRIX_TYPE) == sizeof(double) ? UTIL_DTYPE_F64 : UTIL_DTYPE_F32);
+}
+
+/** Returns the network file element type of the weights a network uses for inference */
+static util_dtype_t _util_netDtype(network_t const * net) {
+    switch(net->dtype) {
+	case NETWORK_DTYPE_F16: return UTIL_DTYPE_F16;
+	case NETWORK_DTYPE_BF16: return UTIL_DTYPE_BF16;
+	default: return _util_hostDtype();
+    }
+}
+
+/** Returns the size in bytes of a network file element type, 0 if unknown */
+static size_t _util_dtypeSize(uint32_t dtype) {
+    switch(dtype) {
+	case UTIL_DTYPE_F32: return 4;
+	case UTIL_DTYPE_F64: return 8;
+	case UTIL_DTYPE_F16: return 2;
+	case UTIL_DTYPE_BF16: return 2;
+	default: return 0;
+    }
+}
+
+/** Returns the network file element type of the biases, which stay in full precision */
+static util_dtype_t _util_biasDtype(uint32_t dtype) {
+    return (dtype == UTIL_DTYPE_F64 ? UTIL_DTYPE_F64 : UTIL_DTYPE_F32);
+}
+
+/** Rounds a network file offset up to the blob alignment */
+static uint64_t _util_netAlign(uint64_t offset) {
+    return (offset + UTIL_NET_ALIGN - 1) / UTIL_NET_ALIGN * UTIL_NET_ALIGN;
+}
+
+/** Byte-swapping readers for files written on a host of the other endianness */
+static uint32_t _util_read32(uint32_t val, int swap) {
+    return (swap ? __builtin_bswap32(val) : val);
+}
+static uint64_t _util_read64(uint64_t val, int swap) {
+    return (swap ? __builtin_bswap64(val) : val);
+}
+
+/** Reads a single weight of the given file element type into MATRIX_TYPE */
+static MATRIX_TYPE _util_readWeight(unsigned char const * src, uint32_t dtype, int swap) {
+    if(dtype == UTIL_DTYPE_F64) {
+	uint64_t bits;
+	double val;
+	memcpy(&bits, src, sizeof(bits));
+	bits = _util_read64(bits, swap);
+	memcpy(&val, &bits, sizeof(val));
+	return (MATRIX_TYPE)(val);
+    }
+    uint32_t bits;
+    float val;
+    memcpy(&bits, src, sizeof(bits));
+    bits = _util_read32(bits, swap);
+    memcpy(&val, &bits, sizeof(val));
+    return (MATRIX_TYPE)(val);
+}
 
 util_err_t util_saveNetwork(network_t * net, char const * filename) {
+    if(!net || !filename || net->depth == 0)
+	return UTIL_ERR_PARAM;
+
+    /* Laying out the file, header and layer table first, then the weight and bias blobs of every layer on aligned offsets */
+    util_netLayer_t table [net->depth];
+    size_t elemSize = network_dtypeSize(net);
+    util_dtype_t dtype = _util_netDtype(net);
+    size_t biasSize = _util_dtypeSize(_util_biasDtype(dtype));
+    uint64_t offset = _util_netAlign(sizeof(util_netHeader_t) + net->depth * sizeof(util_netLayer_t));
+    for(size_t idx = 0; idx < net->depth; ++idx) {
+	matrix_t * weights = (net->weights + idx);
+	table[idx] = (util_netLayer_t){ .rows = weights->rows, .cols = weights->cols, .offset = offset, .activation = net->activations[idx].type };
+	table[idx].biasOffset = _util_netAlign(offset + weights->rows * weights->cols * elemSize);
+	offset = _util_netAlign(table[idx].biasOffset + weights->rows * biasSize);
+    }
+    util_netHeader_t header = { .magic = UTIL_NET_MAGIC, .version = UTIL_NET_VERSION, .endian = UTIL_NET_ENDIAN,
+	.dtype = dtype, .depth = net->depth, .inSize = net->inSize, .fileSize = offset };
+
     /* Opening file and checking success */
-    FILE * fp = fopen(filename, "w");
+    FILE * fp = fopen(filename, "wb");
     if(!fp)
 	return UTIL_ERR_FILE;
 
-    /* Saving network struct itself */
-    fwrite((void *)net, sizeof(network_t), 1, fp);
-    /* Saving layer data - groups of (matrix, matrix data, activation) */
-    for(size_t idx = 0; idx < net->depth; ++idx) {
-	fwrite((void *)(net->weights + idx), sizeof(matrix_t), 1, fp);
-	fwrite((void *)(net->weights + idx)->data, sizeof(MATRIX_TYPE), (net->weights + idx)->dataLen, fp);
-	fwrite((void *)(&(net->activations + idx)->type), sizeof(activation_type_t), 1, fp);
+    /* Writing the header, the table and the blobs, zero-padding up to each blob */
+    static unsigned char const padding [UTIL_NET_ALIGN] = {0};
+    uint64_t written = sizeof(header) + sizeof(table);
+    int ok = (fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(table, sizeof(table), 1, fp) == 1);
+    for(size_t idx = 0; idx < net->depth && ok; ++idx) {
+	matrix_t * weights = (net->weights + idx);
+	size_t len = weights->rows * weights->cols;
+	void const * blob = (net->dtype == NETWORK_DTYPE_NATIVE ? (void const *)(weights->data) : (void const *)(net->stored[idx]));
+	ok = (fwrite(padding, 1, table[idx].offset - written, fp) == table[idx].offset - written
+	      && fwrite(blob, elemSize, len, fp) == len);
+	written = table[idx].offset + len * elemSize;
+	ok = ok && (fwrite(padding, 1, table[idx].biasOffset - written, fp) == table[idx].biasOffset - written);
+	for(size_t i = 0; i < weights->rows && ok; ++i) {
+	    /* Biases are written one by one, as their file type need not be MATRIX_TYPE */
+	    float single = (float)(net->biases[idx].data[i]);
+	    double wide = (double)(net->biases[idx].data[i]);
+	    ok = (fwrite((biasSize == sizeof(float) ? (void const *)(&single) : (void const *)(&wide)), biasSize, 1, fp) == 1);
+	}
+	written = table[idx].biasOffset + weights->rows * biasSize;
     }
+    if(ok)
+	ok = (fwrite(padding, 1, header.fileSize - written, fp) == header.fileSize - written);
+    if(fclose(fp) != 0 || !ok)
+	return UTIL_ERR_FILE;
     return UTIL_OK;
 }
 
+/** Converts a freshly loaded version 1 network, whose last input was the constant 1.0, to explicit biases:
+ * the last first layer weight column becomes the first layer bias (the other layers had none) and is dropped */
+static void _util_netFromV1(network_t * net) {
+    matrix_t * weights = net->weights;
+    size_t rows = weights->rows, cols = weights->cols;
+    for(size_t i = 0; i < rows; ++i) {
+	if(net->dtype == NETWORK_DTYPE_NATIVE) {
+	    net->biases->data[i] = weights->data[i * cols + cols - 1];
+	    memmove(weights->data + i * (cols - 1), weights->data + i * cols, (cols - 1) * sizeof(MATRIX_TYPE));
+	} else {
+	    uint16_t bits = net->stored[0][i * cols + cols - 1];
+	    net->biases->data[i] = (net->dtype == NETWORK_DTYPE_F16 ? kernel_f16ToFloat(bits) : kernel_bf16ToFloat(bits));
+	    memmove(net->stored[0] + i * (cols - 1), net->stored[0] + i * cols, (cols - 1) * sizeof(uint16_t));
+	}
+    }
+    weights->cols = cols - 1;
+    if(weights->data)
+	weights->dataLen = rows * (cols - 1);
+    net->inSize = cols - 1;
+}
+
 util_err_t util_loadNetwork(network_t * net, char const * filename) {
-    /* Opening file and checking success */
-    FILE * fp = fopen(filename, "r");
-    if(!fp)
-	return UTIL_ERR_FILE;
+    if(!net || !filename)
+	return UTIL_ERR_PARAM;
 
-    /* Loading network struct */
-    if(fread((void *)net, sizeof(network_t), 1, fp) != 1)
+    /* Mapping the whole file, privately so that training a loaded network never writes back into it */
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+	return UTIL_ERR_FILE;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)(st.st_size) < sizeof(util_netHeader_t)) {
+	close(fd);
 	return UTIL_ERR_READ;
-    /* Allocating dynamic components of network struct */
-    net->weights = (matrix_t *)(malloc(net->depth * sizeof(matrix_t)));
-    net->activations = (activation_t *)(malloc(net->depth * sizeof(activation_t)));
-    /* Loading layer data */
-    for(size_t idx = 0; idx < net->depth; ++idx) {
-	/* Reading weights matrix */
-	if(fread((void *)(net->weights + idx), sizeof(matrix_t), 1, fp) != 1)
-	    return UTIL_ERR_READ;
-	/* Allocating space for matrix data and reading matrix data from file */
-	(net->weights + idx)->data = (MATRIX_TYPE *)malloc((net->weights + idx)->dataLen * sizeof(MATRIX_TYPE));
-	if(fread((void *)(net->weights + idx)->data, sizeof(MATRIX_TYPE), (net->weights + idx)->dataLen, fp) != (net->weights + idx)->dataLen)
-	    return UTIL_ERR_READ;
-	/* Loading activation function based off file */
-	activation_type_t type;
-	if(fread((void *)(&type), sizeof(activation_type_t), 1, fp) != 1)
-	    return UTIL_ERR_READ;
-	*(net->activations + idx) = activation_get(type);
+    }
+    size_t fileLen = (size_t)(st.st_size);
+    void * mapping = mmap(NULL, fileLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+	return UTIL_ERR_READ;
+    unsigned char const * file = (unsigned char const *)(mapping);
+
+    /* Checking the header */
+    util_netHeader_t header;
+    memcpy(&header, file, sizeof(header));
+    int swap = (header.endian != UTIL_NET_ENDIAN);
+    uint32_t dtype = _util_read32(header.dtype, swap);
+    size_t depth = _util_read32(header.depth, swap);
+    size_t dtypeSize = _util_dtypeSize(dtype);
+    uint32_t version = _util_read32(header.version, swap);
+    size_t entrySize = (version == 1 ? offsetof(util_netLayer_t, biasOffset) : sizeof(util_netLayer_t));
+    if(memcmp(header.magic, UTIL_NET_MAGIC, sizeof(UTIL_NET_MAGIC)) != 0 || _util_read32(header.endian, swap) != UTIL_NET_ENDIAN
+       || version == 0 || version > UTIL_NET_VERSION || dtypeSize == 0 || depth == 0
+       || _util_read64(header.fileSize, swap) != fileLen || sizeof(header) + depth * entrySize > fileLen
+       || (version == 1 && _util_read64(header.inSize, swap) < 2)) {
+	munmap(mapping, fileLen);
+	return UTIL_ERR_FORMAT;
+    }
+
+    /* Setting up the network, the weights and biases of a file matching the host are used in place,
+     * reduced precision weights become the inference copies of a network without master weights,
+     * version 1 files always get copies as their first layer loses its last weight column */
+    int half = (dtype == UTIL_DTYPE_F16 || dtype == UTIL_DTYPE_BF16);
+    int inPlace = (!swap && version != 1 && (half || dtype == _util_hostDtype()));
+    uint32_t biasDtype = _util_biasDtype(dtype);
+    size_t biasSize = _util_dtypeSize(biasDtype);
+    int biasInPlace = (inPlace && biasDtype == _util_hostDtype());
+    *net = (network_t){0};
+    net->inSize = _util_read64(header.inSize, swap);
+    net->depth = depth;
+    net->weights = (matrix_t *)(calloc(depth, sizeof(matrix_t)));
+    net->biases = (matrix_t *)(calloc(depth, sizeof(matrix_t)));
+    net->activations = (activation_t *)(malloc(depth * sizeof(activation_t)));
+    if(half) {
+	net->dtype = (dtype == UTIL_DTYPE_F16 ? NETWORK_DTYPE_F16 : NETWORK_DTYPE_BF16);
+	net->stored = (uint16_t **)(calloc(depth, sizeof(uint16_t *)));
+    }
+    if(inPlace) {
+	net->mapping = mapping;
+	net->mappingLen = fileLen;
+    }
+    util_err_t res = (net->weights && net->biases && net->activations && (!half || net->stored) ? UTIL_OK : UTIL_ERR);
+
+    /* Checking every layer entry and hooking up its weights and biases */
+    size_t prevSize = net->inSize;
+    for(size_t idx = 0; idx < depth && res == UTIL_OK; ++idx) {
+	util_netLayer_t layer = {0};
+	memcpy(&layer, file + sizeof(header) + idx * entrySize, entrySize);
+	size_t rows = _util_read64(layer.rows, swap);
+	size_t cols = _util_read64(layer.cols, swap);
+	uint64_t offset = _util_read64(layer.offset, swap);
+	uint64_t biasOffset = _util_read64(layer.biasOffset, swap);
+	if(cols != prevSize || rows == 0 || cols == 0 || rows > fileLen || cols > fileLen
+	   || offset % UTIL_NET_ALIGN != 0 || offset > fileLen || rows * cols * dtypeSize > fileLen - offset
+	   || (version != 1 && (biasOffset % UTIL_NET_ALIGN != 0 || biasOffset > fileLen || rows * biasSize > fileLen - biasOffset))) {
+	    res = UTIL_ERR_FORMAT;
+	    break;
+	}
+	matrix_t * weights = (net->weights + idx);
+	if(half) {
+	    *weights = (matrix_t){ .rows = rows, .cols = cols };
+	    if(inPlace) {
+		net->stored[idx] = (uint16_t *)(file + offset);
+	    } else {
+		net->stored[idx] = (uint16_t *)(malloc(rows * cols * sizeof(uint16_t)));
+		if(!net->stored[idx]) {
+		    res = UTIL_ERR;
+		    break;
+		}
+		for(size_t i = 0; i < rows * cols; ++i) {
+		    uint16_t bits;
+		    memcpy(&bits, file + offset + i * sizeof(bits), sizeof(bits));
+		    net->stored[idx][i] = (swap ? __builtin_bswap16(bits) : bits);
+		}
+	    }
+	} else if(inPlace) {
+	    *weights = (matrix_t){ .data = (MATRIX_TYPE *)(file + offset), .dataLen = rows * cols, .rows = rows, .cols = cols };
+	} else {
+	    if(matrix_init(weights, rows, cols) != MATRIX_OK || !weights->data) {
+		res = UTIL_ERR;
+		break;
+	    }
+	    for(size_t i = 0; i < weights->dataLen; ++i)
+		weights->data[i] = _util_readWeight(file + offset + i * dtypeSize, dtype, swap);
+	}
+	matrix_t * biases = (net->biases + idx);
+	if(biasInPlace) {
+	    *biases = (matrix_t){ .data = (MATRIX_TYPE *)(file + biasOffset), .dataLen = rows, .rows = rows, .cols = 1 };
+	} else {
+	    if(matrix_init(biases, rows, 1) != MATRIX_OK || !biases->data) {
+		res = UTIL_ERR;
+		break;
+	    }
+	    for(size_t i = 0; i < rows; ++i)
+		biases->data[i] = (version == 1 ? 0 : _util_readWeight(file + biasOffset + i * biasSize, biasDtype, swap));
+	}
+	net->activations[idx] = activation_get((activation_type_t)(_util_read32(layer.activation, swap)));
+	if(!net->activations[idx].f) {
+	    res = UTIL_ERR_FORMAT;
+	    break;
+	}
+	prevSize = rows;
+    }
+    net->outSize = prevSize;
+    if(res == UTIL_OK && version == 1)
+	_util_netFromV1(net);
+
+    /* Copies don't need the mapping any more, failures release everything */
+    if(!inPlace)
+	munmap(mapping, fileLen);
+    if(res != UTIL_OK)
+	network_destroy(net);
+    return res;
+}
+
+struct util_inferSlot {
+    /** Column-major input and output of the worker's share of the points */
+    matrix_t in, out;
+    network_workspace_t ws;
+    /** Scratch space of quantized inference, which works on the points directly */
+    quant_workspace_t qws;
+};
+
+/** Pool task, evaluates one worker's share of the current run */
+static void _util_inferShare(void * arg, size_t worker, size_t workers) {
+    util_infer_t * infer = (util_infer_t *)arg;
+    util_inferSlot_t * slot = (infer->slots + worker);
+    size_t inSize = infer->inSize, outSize = infer->outSize;
+    size_t start, end;
+    pool_split(infer->count, worker, workers, &start, &end);
+    size_t count = end - start;
+    if(count == 0)
+	return;
+    if(infer->qnet) {
+	if(quant_inference_batch(infer->qnet, &slot->qws, infer->points + start * inSize, infer->results + start * outSize, count) != QUANT_OK)
+	    infer->failed = 1;
+	return;
+    }
+
+    /* Transposing the share of points into densely packed input columns */
+    slot->in.cols = slot->out.cols = count;
+    slot->in.dataLen = inSize * count;
+    slot->out.dataLen = outSize * count;
+    for(size_t i = 0; i < count; ++i) {
+	for(size_t j = 0; j < inSize; ++j)
+	    slot->in.data[j * count + i] = infer->points[(start + i) * inSize + j];
+    }
+    if(network_inference_batch(infer->net, &slot->ws, &slot->in, &slot->out, NULL) != NETWORK_OK) {
+	infer->failed = 1;
+	return;
+    }
+    for(size_t i = 0; i < count; ++i) {
+	for(size_t j = 0; j < outSize; ++j)
+	    infer->results[(start + i) * outSize + j] = slot->out.data[j * count + i];
+    }
+}
+
+/** Sets up the pool and the slot table of an inference engine */
+static util_err_t _util_infer_setup(util_infer_t * infer, size_t capacity, size_t threads) {
+    infer->capacity = capacity;
+    pool_init(&infer->pool, (threads < capacity ? threads : capacity));
+    infer->slots = (util_inferSlot_t *)(calloc(infer->pool.size, sizeof(util_inferSlot_t)));
+    if(!infer->slots) {
+	pool_destroy(&infer->pool);
+	return UTIL_ERR;
     }
     return UTIL_OK;
 }
 
-util_err_t util_loadPoints(set_t * set, char const * filename) {
-    /* Opening file and checking success */
-    FILE * fp = fopen(filename, "r");
-    if(!fp)
-	return UTIL_ERR_FILE;
+util_err_t util_infer_initQuant(util_infer_t * infer, quant_network_t * qnet, size_t capacity, size_t threads) {
+    if(!infer || !qnet || capacity == 0)
+	return UTIL_ERR_PARAM;
+
+    *infer = (util_infer_t){ .qnet = qnet, .inSize = qnet->inSize, .outSize = qnet->outSize };
+    if(_util_infer_setup(infer, capacity, threads) != UTIL_OK)
+	return UTIL_ERR;
+    size_t share = (capacity + infer->pool.size - 1) / infer->pool.size;
+    for(size_t w = 0; w < infer->pool.size; ++w) {
+	if(quant_workspace_init(&infer->slots[w].qws, qnet, share) != QUANT_OK) {
+	    util_infer_destroy(infer);
+	    return UTIL_ERR;
+	}
+    }
+    return UTIL_OK;
+}
+
+util_err_t util_infer_init(util_infer_t * infer, network_t * net, size_t capacity, size_t threads) {
+    if(!infer || !net || capacity == 0)
+	return UTIL_ERR_PARAM;
 
-    /* Loading data line by line */
+    *infer = (util_infer_t){ .net = net, .inSize = net->inSize, .outSize = net->outSize };
+    if(_util_infer_setup(infer, capacity, threads) != UTIL_OK)
+	return UTIL_ERR;
+
+    /* Every worker gets room for an even share of a full run */
+    size_t share = (capacity + infer->pool.size - 1) / infer->pool.size;
+    util_err_t res = UTIL_OK;
+    for(size_t w = 0; w < infer->pool.size; ++w) {
+	util_inferSlot_t * slot = (infer->slots + w);
+	if(matrix_init(&slot->in, net->inSize, share) != MATRIX_OK || matrix_init(&slot->out, net->outSize, share) != MATRIX_OK
+	   || network_workspace_initBatch(&slot->ws, net, share) != NETWORK_OK || !slot->in.data || !slot->out.data)
+	    res = UTIL_ERR;
+    }
+    if(res != UTIL_OK)
+	util_infer_destroy(infer);
+    return res;
+}
+
+util_err_t util_infer_run(util_infer_t * infer, MATRIX_TYPE const * points, MATRIX_TYPE * results, size_t count) {
+    if(!infer || !points || !results || count > infer->capacity)
+	return UTIL_ERR_PARAM;
+    if(count == 0)
+	return UTIL_OK;
+
+    infer->points = points;
+    infer->results = results;
+    infer->count = count;
+    infer->failed = 0;
+    pool_run(&infer->pool, _util_inferShare, infer);
+    return (infer->failed ? UTIL_ERR : UTIL_OK);
+}
+
+util_err_t util_infer_destroy(util_infer_t * infer) {
+    if(!infer)
+	return UTIL_ERR_PARAM;
+    if(infer->slots) {
+	for(size_t w = 0; w < infer->pool.size; ++w) {
+	    matrix_destroy(&infer->slots[w].in);
+	    matrix_destroy(&infer->slots[w].out);
+	    network_workspace_destroy(&infer->slots[w].ws);
+	    quant_workspace_destroy(&infer->slots[w].qws);
+	}
+    }
+    free(infer->slots);
+    pool_destroy(&infer->pool);
+    *infer = (util_infer_t){0};
+    return UTIL_OK;
+}
+
+/** Exact powers of ten, any integer below 2^53 times or divided by one of them being correctly rounded in double precision */
+static double const _util_pow10 [] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+/** Parses a decimal number from [text, end), returning the position after it, or 'text' if there is none:
+ * plain decimals of up to 19 significant digits with a small exponent are converted exactly from their integer digits,
+ * anything else (long mantissas, large exponents, inf, nan) goes through strtod, so the result always matches strtod */
+static char const * _util_parseFloat(char const * text, char const * end, MATRIX_TYPE * value) {
+    char const * p = text;
+    int negative = (p < end && *p == '-');
+    if(p < end && (*p == '-' || *p == '+'))
+	++p;
+
+    /* Significant digits into an integer, counting the decimal exponent */
+    uint64_t mantissa = 0;
+    int digits = 0, exp10 = 0, any = 0, exact = 1;
+    for(; p < end && *p >= '0' && *p <= '9'; ++p, any = 1) {
+	if(digits < 19) {
+	    mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+	    digits += (mantissa != 0);
+	} else {
+	    ++exp10;
+	    exact = 0;
+	}
+    }
+    if(p < end && *p == '.') {
+	for(++p; p < end && *p >= '0' && *p <= '9'; ++p, any = 1) {
+	    if(digits < 19) {
+		mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+		digits += (mantissa != 0);
+		--exp10;
+	    } else {
+		exact = 0;
+	    }
+	}
+    }
+    if(any && p < end && (*p == 'e' || *p == 'E')) {
+	char const * q = p + 1;
+	int expNegative = (q < end && *q == '-');
+	if(q < end && (*q == '-' || *q == '+'))
+	    ++q;
+	if(q < end && *q >= '0' && *q <= '9') {
+	    int exponent = 0;
+	    for(; q < end && *q >= '0' && *q <= '9'; ++q)
+		exponent = (exponent < 100000 ? exponent * 10 + (*q - '0') : exponent);
+	    exp10 += (expNegative ? -exponent : exponent);
+	    p = q;
+	}
+    }
+    if(any && exact && mantissa <= ((uint64_t)(1) << 53) && exp10 >= -22 && exp10 <= 22) {
+	double val = (exp10 < 0 ? (double)(mantissa) / _util_pow10[-exp10] : (double)(mantissa) * _util_pow10[exp10]);
+	*value = (MATRIX_TYPE)(negative ? -val : val);
+	return p;
+    }
+
+    /* Slow path on a terminated copy of the token, as the text may be a file mapping */
+    char token [64];
+    size_t len = (size_t)(end - text) < sizeof(token) - 1 ? (size_t)(end - text) : sizeof(token) - 1;
+    memcpy(token, text, len);
+    token[len] = '\0';
+    char * stop = NULL;
+    double val = strtod(token, &stop);
+    if(stop == token)
+	return text;
+    *value = (MATRIX_TYPE)(val);
+    return text + (stop - token);
+}
+
+/** Parses up to 'count' comma or space separated values from [*text, end), advancing *text past them and returning the number parsed,
+ * a value running into anything but a separator or the end of the line (as in "0.5.3" or "1-2") not counting */
+static size_t _util_parseFields(char const ** text, char const * end, MATRIX_TYPE * values, size_t count) {
+    char const * p = *text;
+    size_t parsed = 0;
+    while(parsed < count) {
+	while(p < end && (*p == ',' || *p == ' ' || *p == '\t'))
+	    ++p;
+	char const * next = _util_parseFloat(p, end, values + parsed);
+	if(next == p || (next < end && *next != ',' && *next != ' ' && *next != '\t' && *next != '\r' && *next != '\n'))
+	    break;
+	++parsed;
+	p = next;
+    }
+    *text = p;
+    return parsed;
+}
+
+/** Returns whether [text, end) holds nothing but whitespace */
+static int _util_blank(char const * text, char const * end) {
+    for(; text < end; ++text) {
+	if(*text != ' ' && *text != '\t' && *text != '\r' && *text != '\n')
+	    return 0;
+    }
+    return 1;
+}
+
+/** Writes the points and results of a batch as lines of comma separated values */
+static void _util_batchWrite(FILE * out, MATRIX_TYPE const * points, size_t inSize, MATRIX_TYPE const * results, size_t outSize, size_t count) {
+    for(size_t i = 0; i < count; ++i) {
+	for(size_t j = 0; j < inSize; ++j)
+	    fprintf(out, "%g,", points[i * inSize + j]);
+	for(size_t j = 0; j < outSize; ++j)
+	    fprintf(out, (j + 1 < outSize ? "%g," : "%g\n"), results[i * outSize + j]);
+    }
+}
+
+util_err_t util_batch(util_infer_t * infer, FILE * in, FILE * out) {
+    if(!infer || !in || !out || infer->inSize == 0)
+	return UTIL_ERR_PARAM;
+
+    size_t inSize = infer->inSize, outSize = infer->outSize, batchSize = infer->capacity;
+    MATRIX_TYPE * points = (MATRIX_TYPE *)(malloc(batchSize * inSize * sizeof(MATRIX_TYPE)));
+    MATRIX_TYPE * results = (MATRIX_TYPE *)(malloc(batchSize * outSize * sizeof(MATRIX_TYPE)));
+    util_err_t res = (points && results ? UTIL_OK : UTIL_ERR);
+
+    /* Reading a batch worth of lines at a time, evaluating it and writing it out before reading further */
     char * line = NULL;
-    size_t lineSize = 0;
-    size_t maxPointsLen = UTIL_POINTS_LOAD_BUFF;
-    MATRIX_TYPE ** points = (MATRIX_TYPE **)malloc(sizeof(MATRIX_TYPE *) * maxPointsLen);
-    size_t pointsLen = 0;
-    while(getline(&line, &lineSize, fp) >= 0) {
-	if(lineSize > 0) {
-	    MATRIX_TYPE in1 = 0, in2 = 0, out = 0;
-	    if(sscanf(line, MATRIX_TYPE_SCANF "," MATRIX_TYPE_SCANF "," MATRIX_TYPE_SCANF, &in1, &in2, &out) == 3) {
-		/* Reallocate points array if end of available space reached */
-		if(pointsLen == maxPointsLen) {
-		    maxPointsLen *= 2;
-		    points = (MATRIX_TYPE **)realloc(points, sizeof(MATRIX_TYPE *) * maxPointsLen);
-		}
-		/* Write processed numbers from file into points array */
-		points[pointsLen] = (MATRIX_TYPE *)malloc(sizeof(MATRIX_TYPE) * 4);
-		points[pointsLen][0] = in1;
-		points[pointsLen][1] = in2;
-		points[pointsLen][2] = 1.0f;
-		points[pointsLen][3] = out;
-		++pointsLen;
+    size_t lineLen = 0, lineNum = 0, count = 0;
+    while(res == UTIL_OK) {
+	ssize_t len = getline(&line, &lineLen, in);
+	int more = (len >= 0);
+	if(more) {
+	    ++lineNum;
+	    MATRIX_TYPE * point = (points + count * inSize);
+	    char const * cursor = line;
+	    if(_util_parseFields(&cursor, line + len, point, inSize) == inSize) {
+		++count;
+	    } else if(!_util_blank(line, line + len)) {
+		fprintf(stderr, "Warning: skipping malformed line %lu\n", lineNum);
 	    }
 	}
+	if(count == batchSize || (!more && count > 0)) {
+	    res = util_infer_run(infer, points, results, count);
+	    if(res == UTIL_OK)
+		_util_batchWrite(out, points, inSize, results, outSize, count);
+	    count = 0;
+	}
+	if(!more)
+	    break;
     }
+    if(res == UTIL_OK && (ferror(in) || fflush(out) != 0))
+	res = UTIL_ERR_READ;
+
     free(line);
-    /* Initialising set_t structure and populating with the read values */
-    set_init(set, pointsLen, 3, 1);
-    for(size_t idx = 0; idx < pointsLen; ++idx) {
-	set_setData(set, idx, points[idx], (points[idx] + 3));
-	free(points[idx]);
-    }
     free(points);
+    free(results);
+    return res;
+}
+
+/** Parses the inputs and outputs of one point from the line [text, end), returning 1 if it holds all of them */
+static int _util_parsePoint(char const * text, char const * end, MATRIX_TYPE * in, size_t inputs, MATRIX_TYPE * out, size_t outputs) {
+    return (_util_parseFields(&text, end, in, inputs) == inputs && _util_parseFields(&text, end, out, outputs) == outputs);
+}
+
+int util_parsePoint(char const * line, MATRIX_TYPE * in, size_t inputs, MATRIX_TYPE * out, size_t outputs) {
+    return _util_parsePoint(line, line + strlen(line), in, inputs, out, outputs);
+}
+
+/** Line-aligned part of a points file parsed by one worker */
+typedef struct {
+    /** The part of the mapping, starting at a line start and ending after a newline or at the end of the file */
+    char const * start, * end;
+    /** The number of lines in the part, and the number of lines before it */
+    size_t lines, lineBase;
+    /** Index of the first point slot of the part in the set blocks (one slot per line), and the number of valid points parsed into them */
+    size_t slotBase, valid;
+    /** The number of malformed lines, and the first line numbers of them */
+    size_t malformed;
+    size_t report [UTIL_POINTS_REPORT];
+} _util_pointsPart_t;
+
+/** Shared state of a parallel points file load */
+typedef struct {
+    _util_pointsPart_t * parts;
+    set_t * set;
+} _util_pointsLoad_t;
+
+/** Pool task, counts the lines of one worker's part */
+static void _util_pointsCount(void * arg, size_t worker, size_t workers) {
+    (void)(workers);
+    _util_pointsPart_t * part = ((_util_pointsLoad_t *)(arg))->parts + worker;
+    size_t lines = 0;
+    for(char const * p = part->start; p < part->end; ++lines) {
+	char const * newline = (char const *)(memchr(p, '\n', part->end - p));
+	p = (newline ? newline + 1 : part->end);
+    }
+    part->lines = lines;
+}
+
+/** Pool task, parses one worker's part into its consecutive point slots, noting malformed lines */
+static void _util_pointsParse(void * arg, size_t worker, size_t workers) {
+    (void)(workers);
+    _util_pointsLoad_t * load = (_util_pointsLoad_t *)(arg);
+    _util_pointsPart_t * part = load->parts + worker;
+    set_t * set = load->set;
+    size_t slot = part->slotBase, lineNum = part->lineBase;
+    for(char const * p = part->start; p < part->end; ) {
+	char const * newline = (char const *)(memchr(p, '\n', part->end - p));
+	char const * lineEnd = (newline ? newline : part->end);
+	++lineNum;
+	if(_util_parsePoint(p, lineEnd, set->in + slot * set->inSize, set->inSize, set->out + slot * set->outSize, set->outSize)) {
+	    ++slot;
+	} else if(!_util_blank(p, lineEnd)) {
+	    if(part->malformed < UTIL_POINTS_REPORT)
+		part->report[part->malformed] = lineNum;
+	    ++part->malformed;
+	}
+	p = (newline ? newline + 1 : part->end);
+    }
+    part->valid = slot - part->slotBase;
+}
+
+util_err_t util_loadPoints(set_t * set, char const * filename, size_t inputs, size_t outputs) {
+    if(!set || !filename || inputs == 0 || outputs == 0)
+	return UTIL_ERR_PARAM;
+
+    /* Mapping the whole file read-only, it is only ever read front to back */
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+	return UTIL_ERR_FILE;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+	close(fd);
+	return UTIL_ERR_READ;
+    }
+    size_t fileLen = (size_t)(st.st_size);
+    if(fileLen == 0) {
+	close(fd);
+	return UTIL_ERR;
+    }
+    void * mapping = mmap(NULL, fileLen, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+	return UTIL_ERR_READ;
+    madvise(mapping, fileLen, MADV_SEQUENTIAL);
+    char const * file = (char const *)(mapping);
+
+    /* Splitting the file into one part per worker, each boundary moved up to the next line start */
+    size_t workers = fileLen / UTIL_POINTS_PART_MIN + 1;
+    size_t cpus = pool_cpuCount();
+    pool_t pool;
+    pool_init(&pool, (workers < cpus ? workers : cpus));
+    _util_pointsPart_t * parts = (_util_pointsPart_t *)(calloc(pool.size, sizeof(_util_pointsPart_t)));
+    _util_pointsLoad_t load = { .parts = parts, .set = set };
+    if(!parts) {
+	pool_destroy(&pool);
+	munmap(mapping, fileLen);
+	return UTIL_ERR;
+    }
+    char const * prev = file;
+    for(size_t w = 0; w < pool.size; ++w) {
+	size_t start, end;
+	pool_split(fileLen, w, pool.size, &start, &end);
+	char const * partEnd = file + end;
+	if(partEnd < prev)
+	    partEnd = prev;
+	if(partEnd > file && partEnd < file + fileLen && partEnd[-1] != '\n') {
+	    char const * newline = (char const *)(memchr(partEnd, '\n', file + fileLen - partEnd));
+	    partEnd = (newline ? newline + 1 : file + fileLen);
+	}
+	parts[w].start = prev;
+	parts[w].end = partEnd;
+	prev = partEnd;
+    }
+
+    /* Counting lines first, so that every part gets as many consecutive point slots in the preallocated blocks as it has lines */
+    pool_run(&pool, _util_pointsCount, &load);
+    size_t lines = 0;
+    for(size_t w = 0; w < pool.size; ++w) {
+	parts[w].lineBase = parts[w].slotBase = lines;
+	lines += parts[w].lines;
+    }
+    util_err_t res = (set_init(set, lines, inputs, outputs) == SET_OK ? UTIL_OK : UTIL_ERR);
+
+    /* Parsing every part straight into its slots, then closing the gaps left by malformed and blank lines */
+    size_t points = 0, malformed = 0;
+    if(res == UTIL_OK) {
+	pool_run(&pool, _util_pointsParse, &load);
+	for(size_t w = 0; w < pool.size; ++w) {
+	    memmove(set->in + points * inputs, set->in + parts[w].slotBase * inputs, parts[w].valid * inputs * sizeof(MATRIX_TYPE));
+	    memmove(set->out + points * outputs, set->out + parts[w].slotBase * outputs, parts[w].valid * outputs * sizeof(MATRIX_TYPE));
+	    points += parts[w].valid;
+	    for(size_t i = 0; i < parts[w].malformed && i < UTIL_POINTS_REPORT && malformed + i < UTIL_POINTS_REPORT; ++i)
+		fprintf(stderr, "Warning: skipping malformed line %lu of '%s'\n", parts[w].report[i], filename);
+	    malformed += parts[w].malformed;
+	}
+	if(malformed > UTIL_POINTS_REPORT)
+	    fprintf(stderr, "Warning: skipped %lu malformed lines of '%s' in total\n", malformed, filename);
+	/* The slots of skipped lines stay allocated past the end (at most one per malformed or blank line), keeping the blocks as set_init made them */
+	set->size = points;
+	if(points == 0) {
+	    set_destroy(set);
+	    res = UTIL_ERR;
+	}
+    }
+
+    free(parts);
+    pool_destroy(&pool);
+    munmap(mapping, fileLen);
+    return res;
+}
+
+util_err_t util_saveSet(set_t * set, char const * filename) {
+    if(!set || !filename || set->size == 0)
+	return UTIL_ERR_PARAM;
+
+    /* Laying out the file, the header and then both blocks on aligned offsets */
+    uint64_t inLen = set->size * set->inSize * sizeof(MATRIX_TYPE), outLen = set->size * set->outSize * sizeof(MATRIX_TYPE);
+    util_setHeader_t header = { .magic = UTIL_SET_MAGIC, .version = UTIL_SET_VERSION, .endian = UTIL_NET_ENDIAN, .dtype = _util_hostDtype(),
+	.size = set->size, .inSize = set->inSize, .outSize = set->outSize };
+    header.inOffset = _util_netAlign(sizeof(header));
+    header.outOffset = _util_netAlign(header.inOffset + inLen);
+    header.fileSize = header.outOffset + outLen;
+
+    /* Opening file and checking success */
+    FILE * fp = fopen(filename, "wb");
+    if(!fp)
+	return UTIL_ERR_FILE;
+
+    /* Writing the header and the blocks, zero-padding up to each block */
+    static unsigned char const padding [UTIL_NET_ALIGN] = {0};
+    int ok = (fwrite(&header, sizeof(header), 1, fp) == 1
+	      && fwrite(padding, 1, header.inOffset - sizeof(header), fp) == header.inOffset - sizeof(header)
+	      && fwrite(set->in, 1, inLen, fp) == inLen
+	      && fwrite(padding, 1, header.outOffset - header.inOffset - inLen, fp) == header.outOffset - header.inOffset - inLen
+	      && fwrite(set->out, 1, outLen, fp) == outLen);
+    if(fclose(fp) != 0 || !ok)
+	return UTIL_ERR_FILE;
+    return UTIL_OK;
+}
+
+util_err_t util_checkSetHeader(util_setHeader_t * header, uint64_t fileLen, int * swap) {
+    if(!header || !swap)
+	return UTIL_ERR_PARAM;
+
+    /* Converting the fields to host byte order */
+    *swap = (header->endian != UTIL_NET_ENDIAN);
+    header->version = _util_read32(header->version, *swap);
+    header->endian = _util_read32(header->endian, *swap);
+    header->dtype = _util_read32(header->dtype, *swap);
+    header->size = _util_read64(header->size, *swap);
+    header->inSize = _util_read64(header->inSize, *swap);
+    header->outSize = _util_read64(header->outSize, *swap);
+    header->inOffset = _util_read64(header->inOffset, *swap);
+    header->outOffset = _util_read64(header->outOffset, *swap);
+    header->fileSize = _util_read64(header->fileSize, *swap);
+
+    /* Checking the identification and that both blocks lie within the file */
+    size_t dtypeSize = _util_dtypeSize(header->dtype);
+    uint64_t size = header->size, inSize = header->inSize, outSize = header->outSize;
+    if(memcmp(header->magic, UTIL_SET_MAGIC, sizeof(UTIL_SET_MAGIC)) != 0 || header->endian != UTIL_NET_ENDIAN
+       || header->version != UTIL_SET_VERSION || (header->dtype != UTIL_DTYPE_F32 && header->dtype != UTIL_DTYPE_F64)
+       || header->fileSize != fileLen || size == 0 || inSize == 0 || outSize == 0
+       || size > fileLen || inSize > fileLen || outSize > fileLen
+       || header->inOffset % UTIL_NET_ALIGN != 0 || header->inOffset > fileLen || size * inSize * dtypeSize > fileLen - header->inOffset
+       || header->outOffset % UTIL_NET_ALIGN != 0 || header->outOffset > fileLen || size * outSize * dtypeSize > fileLen - header->outOffset)
+	return UTIL_ERR_FORMAT;
     return UTIL_OK;
 }
 
+util_err_t util_loadSet(set_t * set, char const * filename) {
+    if(!set || !filename)
+	return UTIL_ERR_PARAM;
+
+    /* Mapping the whole file, privately like a network file */
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+	return UTIL_ERR_FILE;
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+	close(fd);
+	return UTIL_ERR_READ;
+    }
+    if((size_t)(st.st_size) < sizeof(util_setHeader_t)) {
+	close(fd);
+	return UTIL_ERR_FORMAT;
+    }
+    size_t fileLen = (size_t)(st.st_size);
+    void * mapping = mmap(NULL, fileLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+	return UTIL_ERR_READ;
+    unsigned char const * file = (unsigned char const *)(mapping);
+
+    /* Checking the header */
+    util_setHeader_t header;
+    memcpy(&header, file, sizeof(header));
+    int swap = 0;
+    if(util_checkSetHeader(&header, fileLen, &swap) != UTIL_OK) {
+	munmap(mapping, fileLen);
+	return UTIL_ERR_FORMAT;
+    }
+    uint32_t dtype = header.dtype;
+    size_t dtypeSize = _util_dtypeSize(dtype);
+    size_t size = header.size, inSize = header.inSize, outSize = header.outSize;
+    uint64_t inOffset = header.inOffset, outOffset = header.outOffset;
+
+    /* Pointing the set straight into the mapping when the file matches the host, otherwise converting copies */
+    *set = (set_t){ .size = size, .inSize = inSize, .outSize = outSize };
+    if(!swap && dtype == _util_hostDtype()) {
+	set->in = (MATRIX_TYPE *)(file + inOffset);
+	set->out = (MATRIX_TYPE *)(file + outOffset);
+	set->mapping = mapping;
+	set->mappingLen = fileLen;
+	return UTIL_OK;
+    }
+    set->in = (MATRIX_TYPE *)(malloc(size * inSize * sizeof(MATRIX_TYPE)));
+    set->out = (MATRIX_TYPE *)(malloc(size * outSize * sizeof(MATRIX_TYPE)));
+    util_err_t res = (set->in && set->out ? UTIL_OK : UTIL_ERR);
+    for(size_t i = 0; i < size * inSize && res == UTIL_OK; ++i)
+	set->in[i] = _util_readWeight(file + inOffset + i * dtypeSize, dtype, swap);
+    for(size_t i = 0; i < size * outSize && res == UTIL_OK; ++i)
+	set->out[i] = _util_readWeight(file + outOffset + i * dtypeSize, dtype, swap);
+    munmap(mapping, fileLen);
+    if(res != UTIL_OK)
+	set_destroy(set);
+    return res;
+}
+
+/** Parses up to 'count' space separated unsigned integers, returning the number parsed */
+static size_t _util_parseList(char const * text, size_t * values, size_t count) {
+    size_t parsed = 0;
+    char * end = NULL;
+    while(parsed < count) {
+	unsigned long val = strtoul(text, &end, 10);
+	if(end == text)
+	    break;
+	values[parsed++] = val;
+	text = end;
+    }
+    return parsed;
+}
+
 util_err_t util_loadConfig(util_config_t * config, char const * filename) {
     if(!config || !filename)
 	return UTIL_ERR_PARAM;
@@ -98,9 +838,16 @@ util_err_t util_loadConfig(util_config_t * config, char const * filename) {
     if(!fp)
 	return UTIL_ERR_FILE;
 
-    /* Loading config file */
+    /* Loading config file, the older single hidden layer keys only being defaults */
     char * line = NULL;
     size_t lineLen = 0;
+    size_t hiddenSize = 0, activationCount = 0;
+    activation_type_t hiddenActivation = 0, outputActivation = 0;
+    config->inSize = UTIL_CONFIG_INPUTS;
+    config->weightRandMin = UTIL_CONFIG_RAND_MIN;
+    config->weightRandMax = UTIL_CONFIG_RAND_MAX;
+    config->weightRandDiv = UTIL_CONFIG_RAND_DIV;
+    config->optimizer = (optim_options_t){ .momentum = OPTIM_DEFAULT_MOMENTUM, .beta1 = OPTIM_DEFAULT_BETA1, .beta2 = OPTIM_DEFAULT_BETA2, .epsilon = OPTIM_DEFAULT_EPSILON, .gamma = 1 };
     while(getline(&line, &lineLen, fp) >= 0) {
 	/* Skipping commented lines */
 	if(line[0] == '#')
@@ -110,62 +857,210 @@ util_err_t util_loadConfig(util_config_t * config, char const * filename) {
 	    sscanf(line, "learning_rate %f", &config->learningRate);
 	} else if(strstr(line, "iteration_count")) {
 	    sscanf(line, "iteration_count %lu", &config->itCount);
+	} else if(strstr(line, "batch_size")) {
+	    sscanf(line, "batch_size %lu", &config->batchSize);
+	} else if(strstr(line, "train_mode")) {
+	    sscanf(line, "train_mode %d", (int *)(&config->trainMode));
+	} else if(strstr(line, "weight_dtype")) {
+	    sscanf(line, "weight_dtype %d", (int *)(&config->weightDtype));
+	} else if(strstr(line, "stream_chunk")) {
+	    sscanf(line, "stream_chunk %lu", &config->streamChunk);
+	} else if(strstr(line, "shuffle")) {
+	    sscanf(line, "shuffle %d", &config->shuffle);
+	} else if(strstr(line, "eval_every")) {
+	    sscanf(line, "eval_every %lu", &config->evalEvery);
+	} else if(strstr(line, "eval_samples")) {
+	    sscanf(line, "eval_samples %lu", &config->evalSamples);
+	} else if(strstr(line, "validation_split")) {
+	    sscanf(line, "validation_split %f", &config->validationSplit);
+	} else if(strstr(line, "loss_target")) {
+	    sscanf(line, "loss_target " MATRIX_TYPE_SCANF, &config->lossTarget);
+	} else if(strstr(line, "patience")) {
+	    sscanf(line, "patience %lu", &config->patience);
+	} else if(strstr(line, "min_delta")) {
+	    sscanf(line, "min_delta " MATRIX_TYPE_SCANF, &config->minDelta);
+	} else if(strstr(line, "time_budget")) {
+	    sscanf(line, "time_budget %lf", &config->timeBudget);
+	} else if(strstr(line, "keep_best")) {
+	    sscanf(line, "keep_best %d", &config->keepBest);
+	} else if(strstr(line, "checkpoint_every")) {
+	    sscanf(line, "checkpoint_every %lu", &config->checkpointEvery);
+	} else if(strstr(line, "optimizer")) {
+	    sscanf(line, "optimizer %d", (int *)(&config->optimizer.type));
+	} else if(strstr(line, "momentum")) {
+	    sscanf(line, "momentum %f", &config->optimizer.momentum);
+	} else if(strstr(line, "beta1")) {
+	    sscanf(line, "beta1 %f", &config->optimizer.beta1);
+	} else if(strstr(line, "beta2")) {
+	    sscanf(line, "beta2 %f", &config->optimizer.beta2);
+	} else if(strstr(line, "epsilon")) {
+	    sscanf(line, "epsilon %f", &config->optimizer.epsilon);
+	} else if(strstr(line, "weight_decay")) {
+	    sscanf(line, "weight_decay %f", &config->optimizer.weightDecay);
+	} else if(strstr(line, "lr_schedule")) {
+	    sscanf(line, "lr_schedule %d", (int *)(&config->optimizer.schedule));
+	} else if(strstr(line, "lr_step")) {
+	    sscanf(line, "lr_step %lu", &config->optimizer.stepSize);
+	} else if(strstr(line, "lr_gamma")) {
+	    sscanf(line, "lr_gamma %f", &config->optimizer.gamma);
+	} else if(strstr(line, "lr_min")) {
+	    sscanf(line, "lr_min %f", &config->optimizer.minRate);
+	} else if(strstr(line, "lr_warmup")) {
+	    sscanf(line, "lr_warmup %lu", &config->optimizer.warmup);
+	} else if(strstr(line, "threads")) {
+	    sscanf(line, "threads %lu", &config->threads);
+	} else if(strstr(line, "input_size")) {
+	    sscanf(line, "input_size %lu", &config->inSize);
+	} else if(strstr(line, "layers")) {
+	    config->depth = _util_parseList(line + strlen("layers"), config->layers, UTIL_CONFIG_MAX_DEPTH);
+	} else if(strstr(line, "activations")) {
+	    size_t types [UTIL_CONFIG_MAX_DEPTH];
+	    activationCount = _util_parseList(line + strlen("activations"), types, UTIL_CONFIG_MAX_DEPTH);
+	    for(size_t i = 0; i < activationCount; ++i)
+		config->activations[i] = (activation_type_t)(types[i]);
 	} else if(strstr(line, "hidden_size")) {
-	    sscanf(line, "hidden_size %lu", &config->hiddenSize);
+	    sscanf(line, "hidden_size %lu", &hiddenSize);
 	} else if(strstr(line, "hidden_activation")) {
-	    sscanf(line, "hidden_activation %d", (int *)(&config->hiddenActivation));
+	    sscanf(line, "hidden_activation %d", (int *)(&hiddenActivation));
 	} else if(strstr(line, "output_activation")) {
-	    sscanf(line, "output_activation %d", (int *)(&config->outputActivation));
+	    sscanf(line, "output_activation %d", (int *)(&outputActivation));
 	} else if(strstr(line, "random_int_min")) {
 	    sscanf(line, "random_int_min %d", &config->weightRandMin);
 	} else if(strstr(line, "random_int_max")) {
 	    sscanf(line, "random_int_max %d", &config->weightRandMax);
 	} else if(strstr(line, "div_const")) {
 	    sscanf(line, "div_const " MATRIX_TYPE_SCANF, &config->weightRandDiv);
+	} else if(strstr(line, "weight_init")) {
+	    sscanf(line, "weight_init %d", (int *)(&config->weightInit));
+	} else if(strstr(line, "seed")) {
+	    sscanf(line, "seed %" SCNu64, &config->seed);
 	}
     }
     free(line);
+    fclose(fp);
+
+    /* Filling in the topology from the defaults */
+    if(config->depth == 0 && hiddenSize > 0) {
+	config->depth = 2;
+	config->layers[0] = hiddenSize;
+	config->layers[1] = 1;
+    }
+    for(size_t i = activationCount; i < config->depth; ++i)
+	config->activations[i] = (i + 1 < config->depth ? hiddenActivation : outputActivation);
+
+    /* Checking the topology */
+    if(config->depth == 0 || config->inSize == 0)
+	return UTIL_ERR_FORMAT;
+    for(size_t i = 0; i < config->depth; ++i) {
+	if(config->layers[i] == 0 || !activation_get(config->activations[i]).f)
+	    return UTIL_ERR_FORMAT;
+    }
     return UTIL_OK;
 }
 
-util_err_t util_heatmap(network_t * net, float startPointX, float startPointY, float sizeX, float sizeY, float step, char * charset, size_t charsetLength) {
-    if(!net || !charset)
+/** Shared state of a heatmap evaluation */
+typedef struct {
+    network_t * net;
+    float startPointX, startPointY, step;
+    size_t xLength, yLength;
+    /** The heatmap values, row by row */
+    MATRIX_TYPE * map;
+    /** The next tile to be evaluated, taken by workers as they become free */
+    size_t nextTile;
+    /** Result of each worker */
+    util_err_t * results;
+} _util_heatmap_t;
+
+/** Pool task, evaluates tiles of the heatmap grid with batched inference until none are left */
+static void _util_heatmapTiles(void * arg, size_t worker, size_t workers) {
+    (void)(workers);
+    _util_heatmap_t * heat = (_util_heatmap_t *)arg;
+    network_t * net = heat->net;
+    size_t total = heat->xLength * heat->yLength;
+
+    /* Per-worker tile input, output and workspace */
+    matrix_t in = {0}, out = {0};
+    network_workspace_t ws = {0};
+    util_err_t res = UTIL_OK;
+    if(matrix_init(&in, net->inSize, UTIL_HEATMAP_TILE) != MATRIX_OK || matrix_init(&out, net->outSize, UTIL_HEATMAP_TILE) != MATRIX_OK
+       || network_workspace_initBatch(&ws, net, UTIL_HEATMAP_TILE) != NETWORK_OK || !in.data || !out.data)
+	res = UTIL_ERR;
+
+    for(;;) {
+	size_t start = __atomic_fetch_add(&heat->nextTile, 1, __ATOMIC_RELAXED) * UTIL_HEATMAP_TILE;
+	if(res != UTIL_OK || start >= total)
+	    break;
+	size_t count = (total - start < UTIL_HEATMAP_TILE ? total - start : UTIL_HEATMAP_TILE);
+
+	/* Input columns (x, y) of the tile's points, densely packed */
+	in.cols = out.cols = count;
+	in.dataLen = net->inSize * count;
+	out.dataLen = net->outSize * count;
+	for(size_t i = 0; i < count; ++i) {
+	    size_t point = start + i;
+	    in.data[i] = heat->startPointX + (point % heat->xLength) * heat->step;
+	    in.data[count + i] = heat->startPointY + (point / heat->xLength) * heat->step;
+	}
+	if(network_inference_batch(net, &ws, &in, &out, NULL) != NETWORK_OK) {
+	    res = UTIL_ERR;
+	    break;
+	}
+
+	/* Saving the first output of each point */
+	memcpy(heat->map + start, out.data, count * sizeof(MATRIX_TYPE));
+    }
+    heat->results[worker] = res;
+
+    in.cols = out.cols = UTIL_HEATMAP_TILE;
+    matrix_destroy(&in);
+    matrix_destroy(&out);
+    network_workspace_destroy(&ws);
+}
+
+util_err_t util_heatmap(network_t * net, float startPointX, float startPointY, float sizeX, float sizeY, float step, char * charset, size_t charsetLength, size_t threads) {
+    if(!net || !charset || charsetLength == 0 || step <= 0 || net->inSize != 2)
 	return UTIL_ERR_PARAM;
 
-    /* Running network inference to generate heatmap values, keeping track of max and min */
-    MATRIX_TYPE min, max;
+    /* Evaluating the grid on the heap */
     size_t xLength = (size_t)(sizeX / step);
     size_t yLength = (size_t)(sizeY / step);
-    MATRIX_TYPE map [yLength][xLength];
-    matrix_t out = {0}, in = {0};
-    matrix_init(&out, 1, 1);
-    matrix_init(&in, 3, 1);
-    for(size_t y = 0; y < yLength; ++y) {
-	for(size_t x = 0; x < xLength; ++x) {
-	    /* Setting up and performing inference for the current data point */
-	    matrix_set(&in, 0, 0, (startPointX + x * step));
-	    matrix_set(&in, 1, 0, (startPointY + y * step));
-	    matrix_set(&in, 2, 0, 1.0f);
-	    network_inference(net, &in, &out);
-	    MATRIX_TYPE outVal;
-	    matrix_get(&out, 0, 0, &outVal);
-	    /* Saving obtained value, updating min, max */
-	    map[y][x] = outVal;
-	    if(x == 0 && y == 0) {
-		min = outVal;
-		max = outVal;
-	    }
-	    if(outVal < min)
-		min = outVal;
-	    if(outVal > max)
-		max = outVal;
+    if(xLength == 0 || yLength == 0)
+	return UTIL_ERR_PARAM;
+    MATRIX_TYPE * map = (MATRIX_TYPE *)(malloc(xLength * yLength * sizeof(MATRIX_TYPE)));
+    char * line = (char *)(malloc(2 * xLength + 2));
+    if(!map || !line) {
+	free(map);
+	free(line);
+	return UTIL_ERR;
+    }
+    size_t tiles = (xLength * yLength + UTIL_HEATMAP_TILE - 1) / UTIL_HEATMAP_TILE;
+    pool_t pool;
+    pool_init(&pool, (threads < tiles ? threads : tiles));
+    util_err_t results [pool.size];
+    _util_heatmap_t heat = { .net = net, .startPointX = startPointX, .startPointY = startPointY, .step = step,
+	.xLength = xLength, .yLength = yLength, .map = map, .nextTile = 0, .results = results };
+    pool_run(&pool, _util_heatmapTiles, &heat);
+    size_t workers = pool.size;
+    pool_destroy(&pool);
+    for(size_t w = 0; w < workers; ++w) {
+	if(results[w] != UTIL_OK) {
+	    free(map);
+	    free(line);
+	    return results[w];
 	}
     }
-    matrix_destroy(&in);
-    matrix_destroy(&out);
 
-    /* Printing heatmap based on charset */
-    float charStep = (max - min) / (float)(charsetLength - 1);
+    /* Keeping track of max and min */
+    MATRIX_TYPE min = map[0], max = map[0];
+    for(size_t i = 1; i < xLength * yLength; ++i) {
+	if(map[i] < min)
+	    min = map[i];
+	if(map[i] > max)
+	    max = map[i];
+    }
+
+    /* Printing heatmap based on charset, a whole row at a time */
+    float charStep = (max - min) / (float)(charsetLength > 1 ? charsetLength - 1 : 1);
     for(int32_t y = (yLength - 1); y >= 0; --y) {
 	/* Printing left border with numbers */
 	if(y == (yLength - 1)) {
@@ -177,12 +1072,15 @@ util_err_t util_heatmap(network_t * net, float startPointX, float startPointY, f
 		putchar(' ');
 	    fputs("     | ", stdout);
 	}
-	/* Printing line of numbers */
+	/* Printing line of characters */
+	MATRIX_TYPE const * row = map + y * xLength;
 	for(size_t x = 0; x < xLength; ++x) {
-	    size_t charIdx = (size_t)((map[y][x] - min) / charStep);
-	    printf("%c ", charset[charIdx]);
+	    size_t charIdx = (charStep > 0 ? (size_t)((row[x] - min) / charStep) : 0);
+	    line[2 * x] = charset[charIdx < charsetLength ? charIdx : charsetLength - 1];
+	    line[2 * x + 1] = ' ';
 	}
-	putchar('\n');
+	line[2 * xLength] = '\n';
+	fwrite(line, 1, 2 * xLength + 1, stdout);
     }
     /* Printing bottom lines with bar and numbers */
     printf("%.2f \\", startPointY);
@@ -191,9 +1089,11 @@ util_err_t util_heatmap(network_t * net, float startPointX, float startPointY, f
     if(startPointY < 0)
 	putchar(' ');
     printf("\n      %.2f", startPointX);
-    for(size_t x = 0; x < (xLength - 4); ++x)
+    for(size_t x = 4; x < xLength; ++x)
 	fputs("  ", stdout);
     printf("%.2f\n", (startPointX + sizeX));
 
+    free(map);
+    free(line);
     return UTIL_OK;
 }
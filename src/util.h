@@ -7,13 +7,43 @@
 #define UTIL_H
 
 #include <string.h>
+#include <stdint.h>
 
 #include "matrix.h"
 #include "network.h"
 #include "activation.h"
 #include "set.h"
+#include "quant.h"
 
-#define UTIL_POINTS_LOAD_BUFF 1024
+#ifndef UTIL_POINTS_PART_MIN
+/** Smallest share of a points file (in bytes) worth parsing on a thread of its own */
+#define UTIL_POINTS_PART_MIN (1 << 20)
+#endif /* UTIL_POINTS_PART_MIN */
+/** Number of malformed points file lines reported individually */
+#define UTIL_POINTS_REPORT 10
+/** Maximum number of network layers described by a configuration file */
+#define UTIL_CONFIG_MAX_DEPTH 64
+/** Number of network inputs when a configuration file doesn't set input_size */
+#define UTIL_CONFIG_INPUTS 2
+/** Uniform weight initialization range when a configuration file doesn't set it, [min, max) / div */
+#define UTIL_CONFIG_RAND_MIN -50
+#define UTIL_CONFIG_RAND_MAX 50
+#define UTIL_CONFIG_RAND_DIV 1000
+/** Number of heatmap points evaluated together as one batched inference */
+#define UTIL_HEATMAP_TILE 256
+
+/** Network file magic bytes */
+#define UTIL_NET_MAGIC "FUNCNET"
+/** Network file format version, bumped on any incompatible layout change */
+#define UTIL_NET_VERSION 2
+/** Value of the endianness field as written, reads back byte-swapped on a host of the other endianness */
+#define UTIL_NET_ENDIAN 0x01020304u
+/** Alignment of the weight blobs within the network file (and so within a mapping of it), and of the blocks of a dataset file */
+#define UTIL_NET_ALIGN 64
+/** Dataset file magic bytes */
+#define UTIL_SET_MAGIC "FUNCSET"
+/** Dataset file format version, bumped on any incompatible layout change */
+#define UTIL_SET_VERSION 1
 
 /** Error type for utility functions */
 typedef enum {
@@ -26,47 +56,224 @@ typedef enum {
     /** Error with passed function parameters */
     UTIL_ERR_PARAM = 3,
     /** General util error */
-    UTIL_ERR = 4
+    UTIL_ERR = 4,
+    /** Error with the contents of a file (wrong magic, version, type or inconsistent layout) */
+    UTIL_ERR_FORMAT = 5
 } util_err_t;
 
-/** Network training configuration options for a single hidden layer network */
+/** Per-worker state of a batched inference engine */
+typedef struct util_inferSlot util_inferSlot_t;
+
+/** Batched, threaded inference engine, evaluating batches of points with one GEMM per layer split between pool workers */
+typedef struct {
+    /** The network being evaluated, or NULL if evaluating a quantized network */
+    network_t * net;
+    /** The quantized network being evaluated, or NULL */
+    quant_network_t * qnet;
+    /** The network input and output sizes */
+    size_t inSize, outSize;
+    /** The maximum number of points per run */
+    size_t capacity;
+    /** The pool running the workers */
+    pool_t pool;
+    /** Per-worker inputs, outputs and workspace */
+    util_inferSlot_t * slots;
+
+    /** The points of the current run, net->inSize values per point */
+    MATRIX_TYPE const * points;
+    /** The results of the current run, net->outSize values per point */
+    MATRIX_TYPE * results;
+    /** The number of points in the current run */
+    size_t count;
+    /** Non-zero if any worker failed in the current run */
+    int failed;
+} util_infer_t;
+
+/** Element types of the network file weight blobs */
+typedef enum {
+    /** 32-bit IEEE 754 floats */
+    UTIL_DTYPE_F32 = 1,
+    /** 64-bit IEEE 754 floats */
+    UTIL_DTYPE_F64 = 2,
+    /** 16-bit IEEE 754 floats, loaded as a NETWORK_DTYPE_F16 network */
+    UTIL_DTYPE_F16 = 3,
+    /** bfloat16, loaded as a NETWORK_DTYPE_BF16 network */
+    UTIL_DTYPE_BF16 = 4
+} util_dtype_t;
+
+/** Network file header, at the start of the file, followed by 'depth' layer entries and then the weight and bias blobs */
+typedef struct {
+    /** UTIL_NET_MAGIC, zero-padded */
+    char magic [8];
+    /** UTIL_NET_VERSION */
+    uint32_t version;
+    /** UTIL_NET_ENDIAN in the byte order of the writing host, all following fields and weights use that byte order */
+    uint32_t endian;
+    /** The element type of the weights (util_dtype_t) */
+    uint32_t dtype;
+    /** The number of layers */
+    uint32_t depth;
+    /** The network input size */
+    uint64_t inSize;
+    /** The total file size, to detect truncated files */
+    uint64_t fileSize;
+    /** Reserved, zero */
+    uint8_t reserved [24];
+} util_netHeader_t;
+
+/** Network file layer entry */
+typedef struct {
+    /** The weight matrix shape */
+    uint64_t rows, cols;
+    /** Offset of the row-major weight blob from the start of the file, a multiple of UTIL_NET_ALIGN */
+    uint64_t offset;
+    /** The layer activation function (activation_type_t) */
+    uint32_t activation;
+    /** Reserved, zero */
+    uint32_t reserved;
+    /** Offset of the 'rows' biases, aligned like the weights, stored as UTIL_DTYPE_F64 in a UTIL_DTYPE_F64 file and UTIL_DTYPE_F32 otherwise
+     * (version 2 onwards, version 1 entries end before this field and fold the bias into an extra first layer input) */
+    uint64_t biasOffset;
+} util_netLayer_t;
+
+/** Dataset file header, at the start of the file, followed by the input block and the output block,
+ * each row-major (one sample after another) and starting at a multiple of UTIL_NET_ALIGN */
+typedef struct {
+    /** UTIL_SET_MAGIC, zero-padded */
+    char magic [8];
+    /** UTIL_SET_VERSION */
+    uint32_t version;
+    /** UTIL_NET_ENDIAN in the byte order of the writing host, all following fields and values use that byte order */
+    uint32_t endian;
+    /** The element type of the values (util_dtype_t, UTIL_DTYPE_F32 or UTIL_DTYPE_F64) */
+    uint32_t dtype;
+    /** Reserved, zero */
+    uint32_t reserved;
+    /** The number of samples */
+    uint64_t size;
+    /** The input and output sizes of every sample */
+    uint64_t inSize, outSize;
+    /** Offsets of the input and output blocks from the start of the file */
+    uint64_t inOffset, outOffset;
+    /** The total file size, to detect truncated files */
+    uint64_t fileSize;
+} util_setHeader_t;
+
+/** Network training configuration options */
 typedef struct {
 
-    /** Hidden layer size */
-    size_t hiddenSize;
-    /** Hidden layer activation function type */
-    activation_type_t hiddenActivation;
-    /** Output layer activation function type */
-    activation_type_t outputActivation;
+    /** The number of network inputs (input columns of a points file) */
+    size_t inSize;
+    /** The number of layers, including the output layer */
+    size_t depth;
+    /** The width of every layer, the last being the number of outputs */
+    size_t layers [UTIL_CONFIG_MAX_DEPTH];
+    /** The activation function type of every layer */
+    activation_type_t activations [UTIL_CONFIG_MAX_DEPTH];
 
-    /** network weightRandMin weight init constant */
+    /** The weight initialization scheme */
+    network_init_t weightInit;
+    /** Range of the uniform weight initialization, [weightRandMin, weightRandMax) / weightRandDiv */
     int32_t weightRandMin;
-    /** network weightRandMax weight init constant */
     int32_t weightRandMax;
-    /** network weightRandDiv weight init constant */
     MATRIX_TYPE weightRandDiv;
+    /** Seed of the weight initialization and the shuffling, 0 for one picked at the start of training */
+    uint64_t seed;
 
     /** Network training learning rate */
     float learningRate;
     /** Network training iteration count */
     size_t itCount;
+    /** Network training mini-batch size (0 or 1 for per-sample updates) */
+    size_t batchSize;
+    /** Network training thread count (0 or 1 for single-threaded training) */
+    size_t threads;
+    /** Network training mode */
+    set_mode_t trainMode;
+    /** Storage type of the weights used for inference and saved to the network file (master weights stay full precision) */
+    network_dtype_t weightDtype;
+    /** Samples per chunk when streaming the training points from disk, 0 to load them into memory as a whole */
+    size_t streamChunk;
+    /** Whether streamed training visits the chunks and the samples within them in a new random order every pass */
+    int shuffle;
+
+    /** Iterations between loss evaluations (0 never evaluates, disabling the options below but the time budget) */
+    size_t evalEvery;
+    /** Training samples evaluated, 0 for all */
+    size_t evalSamples;
+    /** Fraction of the points (from the end of the file) held out of training and evaluated instead, 0 for none */
+    float validationSplit;
+    /** Loss to stop training at, 0 for none */
+    MATRIX_TYPE lossTarget;
+    /** Evaluations without improving the best loss by more than minDelta to stop training after, 0 to never stop on a plateau */
+    size_t patience;
+    MATRIX_TYPE minDelta;
+    /** Training time limit in seconds, 0 for none */
+    double timeBudget;
+    /** Whether the weights of the best evaluation are kept instead of the last ones */
+    int keepBest;
+    /** Iterations between training checkpoints, 0 for no checkpoints */
+    size_t checkpointEvery;
+
+    /** The optimizer and learning rate schedule */
+    optim_options_t optimizer;
 
 } util_config_t;
 
-/** Saves an existing network_t data structure to the given file */
+/** Initializes an inference engine for runs of up to 'capacity' points on the given network, split between the given number of threads */
+util_err_t util_infer_init(util_infer_t * infer, network_t * net, size_t capacity, size_t threads);
+
+/** Initializes an inference engine running a quantized network */
+util_err_t util_infer_initQuant(util_infer_t * infer, quant_network_t * qnet, size_t capacity, size_t threads);
+
+/** Evaluates 'count' points (each inSize consecutive values) into 'results' (each outSize consecutive values) */
+util_err_t util_infer_run(util_infer_t * infer, MATRIX_TYPE const * points, MATRIX_TYPE * results, size_t count);
+
+/** Destroys an inference engine */
+util_err_t util_infer_destroy(util_infer_t * infer);
+
+/** Streams points (x,y per line, comma separated, extra columns ignored) from 'in' and writes lines of x,y,result to 'out',
+ * evaluating them a full engine capacity of points at a time, malformed lines are reported to stderr and skipped */
+util_err_t util_batch(util_infer_t * infer, FILE * in, FILE * out);
+
+/** Saves an existing network_t data structure to the given file, in the versioned network file format (util_netHeader_t),
+ * with the weights in the storage type used for inference (the reduced precision copies if the network has any) and the biases in full precision */
 util_err_t util_saveNetwork(network_t * net, char const * filename);
 
-/** Loads a saved network from a file into an empty (zero-initialized) network_t structure (don't use network_init) */
+/** Loads a saved network from a file into an empty (zero-initialized) network_t structure (don't use network_init),
+ * mapping the file into memory (copy-on-write) and pointing the weight matrices straight into the mapping when the file
+ * byte order and type match the host, otherwise reading converted copies of the weights, a reduced precision file giving a network
+ * of that dtype without master weights (see network_initMaster), version 1 files are converted by turning their constant 1.0 input into biases */
 util_err_t util_loadNetwork(network_t * net, char const * filename);
 
 /** Loads a dataset of points from a given file into an empty (zero-initialized) set_t structure,
- * in the following format: each line 3 comma-separated floats, representing (xInput,yInput,expectedOutput) */
-util_err_t util_loadPoints(set_t * set, char const * filename);
+ * in the following format: each line 'inputs' inputs followed by 'outputs' expected outputs, all comma-separated floats (extra columns ignored),
+ * the file being mapped and parsed on all CPUs straight into the set, malformed lines being reported to stderr and skipped */
+util_err_t util_loadPoints(set_t * set, char const * filename, size_t inputs, size_t outputs);
+
+/** Parses one line of a points file into its 'inputs' inputs and 'outputs' outputs, returning 1 if the line holds all of them */
+int util_parsePoint(char const * line, MATRIX_TYPE * in, size_t inputs, MATRIX_TYPE * out, size_t outputs);
+
+/** Saves a set to the given file in the binary dataset file format (util_setHeader_t), the values in MATRIX_TYPE */
+util_err_t util_saveSet(set_t * set, char const * filename);
+
+/** Converts the fields of a dataset file header read from a file of the given length to host byte order, telling whether they were swapped,
+ * and checks it, UTIL_ERR_FORMAT if it isn't a valid dataset file header */
+util_err_t util_checkSetHeader(util_setHeader_t * header, uint64_t fileLen, int * swap);
+
+/** Loads a binary dataset file into an empty (zero-initialized) set_t structure (don't use set_init), mapping the file into memory
+ * (copy-on-write) and pointing the set straight into the mapping when the file byte order and type match the host, otherwise
+ * reading converted copies, UTIL_ERR_FORMAT if the file isn't a dataset file */
+util_err_t util_loadSet(set_t * set, char const * filename);
 
-/** Loads a dataset/network configuration file */
+/** Loads a dataset/network configuration file into a zero-initialized configuration, the network being described either by
+ * 'layers' (widths of every layer, the last being the outputs) and 'activations' (per layer, missing ones taking
+ * hidden_activation or output_activation), or by the older single hidden layer 'hidden_size' with one output,
+ * UTIL_ERR_FORMAT if it describes no valid network */
 util_err_t util_loadConfig(util_config_t * config, char const * filename);
 
-/** Prints a heatmap to standard output of inference of a given network (x,y,1.0)->(z) over the area of the given size from the given start point, using the given charset */
-util_err_t util_heatmap(network_t * net, float startPointX, float startPointY, float sizeX, float sizeY, float step, char * charset, size_t charsetLength);
+/** Prints a heatmap to standard output of inference of a given network (x,y,1.0)->(z) over the area of the given size from the given start point, using the given charset,
+ * evaluating the grid in batched tiles of UTIL_HEATMAP_TILE points split between the given number of threads (0 or 1 for the calling thread only) */
+util_err_t util_heatmap(network_t * net, float startPointX, float startPointY, float sizeX, float sizeY, float step, char * charset, size_t charsetLength, size_t threads);
 
 #endif /* UTIL_H */